@@ -0,0 +1,87 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "calibration.h"
+
+#include <QSettings>
+
+#include <math.h>
+
+using namespace QThermCam;
+
+#define KELVIN 273.15
+
+Calibration::Calibration(float emissivity, float reflected, float offset) : emissivity_(emissivity),
+		reflected_(reflected), offset_(offset)
+{
+	if (emissivity_ < 0.01f || emissivity_ > 1.0f)
+		emissivity_ = 1.0f;
+	rebuild();
+}
+
+/* Sensor measures total radiation: e * T^4 + (1 - e) * Tr^4 (Stefan-Boltzmann,
+ * temperatures in K) and reports it as temperature of a black body. */
+void Calibration::rebuild()
+{
+	lut.resize(RAW_COUNT);
+	float *t = lut.data();
+
+	double e = emissivity_;
+	double tr = reflected_ + KELVIN;
+	double reflectedPart = (1.0 - e) * tr * tr * tr * tr;
+
+	for (int raw = 0; raw < RAW_COUNT; ++raw)
+	{
+		double tm = raw * 0.02;
+		double v = (tm * tm * tm * tm - reflectedPart) / e;
+		if (v <= 0)
+			t[raw] = -1000;
+		else
+			t[raw] = sqrt(sqrt(v)) - KELVIN + offset_;
+	}
+}
+
+float Calibration::correct(float celsius) const
+{
+	if (celsius == -1000 || isIdentity())
+		return celsius;
+	return toCelsius(toRaw(celsius));
+}
+
+uint Calibration::toRaw(float celsius)
+{
+	int raw = (int)floor((celsius + KELVIN) / 0.02 + 0.5);
+	if (raw < 0)
+		return 0;
+	if (raw >= RAW_COUNT)
+		return RAW_COUNT - 1;
+	return raw;
+}
+
+Calibration Calibration::fromSettings()
+{
+	QSettings settings;
+	return Calibration(settings.value("emissivity", 1.0).toFloat(), settings.value("reflectedTemp", 20.0).toFloat(),
+			settings.value("calibrationOffset", 0.0).toFloat());
+}
+
+void Calibration::saveSettings() const
+{
+	QSettings settings;
+	settings.setValue("emissivity", emissivity_);
+	settings.setValue("reflectedTemp", reflected_);
+	settings.setValue("calibrationOffset", offset_);
+}
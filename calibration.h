@@ -0,0 +1,49 @@
+#ifndef CALIBRATION_H_
+#define CALIBRATION_H_
+
+#include <QVector>
+
+namespace QThermCam
+{
+
+/* Converts raw MLX90614 readings (0.02 K per unit) to temperatures. The
+ * sensor assumes emissivity 1, so radiation of the object is separated from
+ * radiation reflected from the surroundings and per-device offset is added.
+ * All of it is precomputed into a table covering every possible reading.
+ */
+class Calibration
+{
+	float emissivity_, reflected_, offset_;
+	QVector<float> lut;
+
+	void rebuild();
+
+public:
+	enum { RAW_COUNT = 0x8000 };
+
+	Calibration(float emissivity = 1.0f, float reflected = 20.0f, float offset = 0.0f);
+
+	float emissivity() const { return emissivity_; }
+	float reflected() const { return reflected_; }
+	float offset() const { return offset_; }
+
+	/* conversion without any correction */
+	bool isIdentity() const { return emissivity_ == 1.0f && offset_ == 0.0f; }
+
+	/* -1000 for readings with error bit set or physically impossible */
+	float toCelsius(uint raw) const { return raw < RAW_COUNT ? lut[raw] : -1000; }
+
+	/* corrects temperature already converted by the device */
+	float correct(float celsius) const;
+
+	static uint toRaw(float celsius);
+
+	static float rawToCelsius(uint raw) { return raw * 0.02f - 273.15f; }
+
+	static Calibration fromSettings();
+	void saveSettings() const;
+};
+
+}
+
+#endif /* CALIBRATION_H_ */
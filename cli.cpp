@@ -0,0 +1,402 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* qthermcam-cli - converts data files without GUI, in parallel */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include "calibration.h"
+#include "frameexport.h"
+#include "framefile.h"
+#include "histogram.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace QThermCam;
+
+namespace
+{
+
+enum { FormatPng = 1, FormatCsv = 2, FormatNpy = 4, FormatStats = 8 };
+
+enum RangeType { RangeMinMax, RangePercentile, RangeFixed };
+
+struct Options
+{
+	uint formats;
+	QString outputDir;
+	int scale;
+	PaletteType palette;
+	RangeType range;
+	float rangeMin, rangeMax;
+	/* for raw readings in .qtc files */
+	Calibration calibration;
+};
+
+struct Result
+{
+	QString file;
+	bool ok;
+	QString err, warning;
+	FrameStats stats;
+};
+
+bool writeFile(const QString &file, const ThermFrame &frame, bool (*writer)(QIODevice &, const ThermFrame &),
+		QString &err)
+{
+	QSaveFile f(file);
+	if (!f.open(QIODevice::WriteOnly) || !writer(f, frame) || !f.commit())
+	{
+		err = QCoreApplication::translate("cli", "Cannot write to file %1: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+	return true;
+}
+
+struct Convert
+{
+	typedef Result result_type;
+
+	const Options &opts;
+
+	Convert(const Options &o) : opts(o)
+	{
+	}
+
+	Result operator()(const QString &file)
+	{
+		Result r;
+		r.file = file;
+		r.ok = false;
+
+		ThermFrame frame;
+		if (!FrameFile::load(file, frame, opts.calibration, r.err, r.warning))
+			return r;
+
+		QFileInfo info(file);
+		QString dir = opts.outputDir.isEmpty() ? info.path() : opts.outputDir;
+		QString base = dir + "/" + info.completeBaseName();
+
+		r.stats = FrameExport::stats(frame);
+
+		if (opts.formats & FormatPng)
+		{
+			float tmin = r.stats.min, tmax = r.stats.max;
+			if (opts.range == RangePercentile)
+			{
+				tmin = r.stats.p1;
+				tmax = r.stats.p99;
+			}
+			else if (opts.range == RangeFixed)
+			{
+				tmin = opts.rangeMin;
+				tmax = opts.rangeMax;
+			}
+
+			QImage img = FrameExport::toImage(frame, tmin, tmax, opts.scale, opts.palette);
+			if (!img.save(base + ".png", "PNG"))
+			{
+				r.err = QCoreApplication::translate("cli", "Cannot write to file %1").arg(base + ".png");
+				return r;
+			}
+		}
+
+		if ((opts.formats & FormatCsv) && !writeFile(base + ".csv", frame, FrameExport::writeCsv, r.err))
+			return r;
+
+		if ((opts.formats & FormatNpy) && !writeFile(base + ".npy", frame, FrameExport::writeNpy, r.err))
+			return r;
+
+		r.ok = true;
+		return r;
+	}
+};
+
+enum { BENCHMARK_SIDE = 1000, BENCHMARK_RUNS = 5 };
+
+/* median of BENCHMARK_RUNS runs, ms; -1 if an earlier operation failed */
+template<typename F> qint64 measure(F f, bool &ok)
+{
+	QVector<qint64> times;
+	for (int i = 0; i < BENCHMARK_RUNS && ok; ++i)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		ok = f();
+		times.append(timer.elapsed());
+	}
+	if (times.isEmpty())
+		return -1;
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+struct SaveOp
+{
+	const QString &file;
+	const ThermFrame &frame;
+	QString &err;
+	bool operator()() { return FrameFile::save(file, frame, err); }
+};
+
+struct LoadOp
+{
+	const QString &file;
+	QString &err;
+	bool operator()() { ThermFrame f; QString warning; return FrameFile::load(file, f, Calibration(), err, warning); }
+};
+
+struct StatsOp
+{
+	const ThermFrame &frame;
+	bool operator()() { FrameExport::stats(frame); return true; }
+};
+
+struct CsvOp
+{
+	const QString &file;
+	const ThermFrame &frame;
+	QString &err;
+	bool operator()() { return writeFile(file, frame, FrameExport::writeCsv, err); }
+};
+
+/* Times file operations on a synthetic BENCHMARK_SIDE^2 frame with smooth
+ * gradients, noise and a few missing points, like a real scan.
+ */
+int runBenchmark(QTextStream &out, QTextStream &err)
+{
+	QTemporaryDir dir;
+	if (!dir.isValid())
+	{
+		err << QCoreApplication::translate("cli", "Cannot create temporary directory") << endl;
+		return 1;
+	}
+
+	ThermFrame frame;
+	frame.reset(0, BENCHMARK_SIDE - 1, 0, BENCHMARK_SIDE - 1);
+	// fixed seed, so every run measures the same data
+	QRandomGenerator random(1);
+	for (int y = 0; y < BENCHMARK_SIDE; ++y)
+		for (int x = 0; x < BENCHMARK_SIDE; ++x)
+		{
+			float t = 20 + 10 * sinf(x / 50.0f) * cosf(y / 70.0f) + random.bounded(100) / 100.0f;
+			if (random.bounded(1000) == 0)
+				t = -1000;
+			frame.data[y * BENCHMARK_SIDE + x] = t == -1000 ? t : qRound(t * 100) / 100.0f;
+		}
+
+	QString xml = dir.path() + "/bench.qtcd", bin = dir.path() + "/bench.qtcb", csv = dir.path() + "/bench.csv";
+	QString msg;
+	bool ok = true;
+	SaveOp saveXml = { xml, frame, msg };
+	LoadOp loadXml = { xml, msg };
+	SaveOp saveBin = { bin, frame, msg };
+	LoadOp loadBin = { bin, msg };
+	StatsOp stats = { frame };
+	CsvOp exportCsv = { csv, frame, msg };
+
+	out << QString("%1x%1 frame, median of %2 runs").arg(BENCHMARK_SIDE).arg(BENCHMARK_RUNS) << endl;
+	out << "operation	ms" << endl;
+	out << "save qtcd\t" << measure(saveXml, ok) << endl;
+	out << "load qtcd\t" << measure(loadXml, ok) << endl;
+	out << "save qtcb\t" << measure(saveBin, ok) << endl;
+	out << "load qtcb\t" << measure(loadBin, ok) << endl;
+	out << "stats\t" << measure(stats, ok) << endl;
+	out << "export csv\t" << measure(exportCsv, ok) << endl;
+	out << "size qtcd\t" << QFileInfo(xml).size() << " B" << endl;
+	out << "size qtcb\t" << QFileInfo(bin).size() << " B" << endl;
+
+	if (!ok)
+	{
+		err << msg << endl;
+		return 2;
+	}
+	return 0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setOrganizationDomain("github.com/mslusarz/qthermcam");
+	// same settings as the GUI, for calibration
+	QCoreApplication::setApplicationName("QThermCam");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QCoreApplication::translate("cli",
+			"Converts QThermCam data files (.qtcd, .qtc, .qtcb) to other formats."));
+	parser.addHelpOption();
+	parser.addPositionalArgument("files", QCoreApplication::translate("cli", "Data files to convert."), "files...");
+
+	QCommandLineOption formatOpt(QStringList() << "f" << "format",
+			QCoreApplication::translate("cli", "Comma separated list of outputs: png, csv, npy, stats."),
+			"formats", "png");
+	QCommandLineOption outputOpt(QStringList() << "o" << "output-dir",
+			QCoreApplication::translate("cli", "Directory for output files (default: next to input)."), "dir");
+	QCommandLineOption scaleOpt(QStringList() << "s" << "scale",
+			QCoreApplication::translate("cli", "Size of one sample in PNG, in pixels."), "n", "4");
+	QCommandLineOption paletteOpt(QStringList() << "p" << "palette",
+			QCoreApplication::translate("cli", "PNG palette: default, iron, gray."), "name", "default");
+	QCommandLineOption rangeOpt(QStringList() << "r" << "range",
+			QCoreApplication::translate("cli", "PNG temperature range: minmax, percentile (1% - 99%) or MIN:MAX."),
+			"range", "minmax");
+	QCommandLineOption jobsOpt(QStringList() << "j" << "jobs",
+			QCoreApplication::translate("cli", "Number of files processed at once (default: number of cores)."), "n");
+	parser.addOption(formatOpt);
+	parser.addOption(outputOpt);
+	parser.addOption(scaleOpt);
+	parser.addOption(paletteOpt);
+	parser.addOption(rangeOpt);
+	QCommandLineOption benchmarkOpt("benchmark",
+			QCoreApplication::translate("cli", "Time loading, saving and export of a synthetic frame."));
+	parser.addOption(jobsOpt);
+	parser.addOption(benchmarkOpt);
+	parser.process(app);
+
+	QTextStream err(stderr);
+	QTextStream out(stdout);
+
+	Options opts;
+	opts.formats = 0;
+	QStringList formats = parser.value(formatOpt).split(',', QString::SkipEmptyParts);
+	for (int i = 0; i < formats.size(); ++i)
+	{
+		QString f = formats[i].trimmed();
+		if (f == "png")
+			opts.formats |= FormatPng;
+		else if (f == "csv")
+			opts.formats |= FormatCsv;
+		else if (f == "npy")
+			opts.formats |= FormatNpy;
+		else if (f == "stats")
+			opts.formats |= FormatStats;
+		else
+		{
+			err << QCoreApplication::translate("cli", "Unknown format: %1").arg(f) << endl;
+			return 1;
+		}
+	}
+
+	opts.calibration = Calibration::fromSettings();
+	opts.outputDir = parser.value(outputOpt);
+	if (!opts.outputDir.isEmpty() && !QDir().mkpath(opts.outputDir))
+	{
+		err << QCoreApplication::translate("cli", "Cannot create directory %1").arg(opts.outputDir) << endl;
+		return 1;
+	}
+
+	bool ok;
+	opts.scale = parser.value(scaleOpt).toInt(&ok);
+	if (!ok || opts.scale < 1 || opts.scale > 64)
+	{
+		err << QCoreApplication::translate("cli", "Invalid scale: %1").arg(parser.value(scaleOpt)) << endl;
+		return 1;
+	}
+
+	opts.palette = paletteByName(parser.value(paletteOpt));
+	if (opts.palette == PaletteCount)
+	{
+		err << QCoreApplication::translate("cli", "Unknown palette: %1").arg(parser.value(paletteOpt)) << endl;
+		return 1;
+	}
+
+	QString range = parser.value(rangeOpt);
+	opts.rangeMin = opts.rangeMax = 0;
+	if (range == "minmax")
+		opts.range = RangeMinMax;
+	else if (range == "percentile")
+		opts.range = RangePercentile;
+	else
+	{
+		QStringList r = range.split(':');
+		bool ok1 = false, ok2 = false;
+		if (r.size() == 2)
+		{
+			opts.rangeMin = r[0].toFloat(&ok1);
+			opts.rangeMax = r[1].toFloat(&ok2);
+		}
+		if (!ok1 || !ok2 || opts.rangeMax <= opts.rangeMin)
+		{
+			err << QCoreApplication::translate("cli", "Invalid range: %1").arg(range) << endl;
+			return 1;
+		}
+		opts.range = RangeFixed;
+	}
+
+	if (parser.isSet(jobsOpt))
+	{
+		int jobs = parser.value(jobsOpt).toInt(&ok);
+		if (!ok || jobs < 1)
+		{
+			err << QCoreApplication::translate("cli", "Invalid number of jobs: %1").arg(parser.value(jobsOpt)) << endl;
+			return 1;
+		}
+		QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+	}
+
+	if (parser.isSet(benchmarkOpt))
+		return runBenchmark(out, err);
+
+	QStringList files = parser.positionalArguments();
+	if (files.isEmpty())
+		parser.showHelp(1);
+
+	// results come back in the same order as files
+	QList<Result> results = QtConcurrent::blockingMapped<QList<Result> >(files, Convert(opts));
+
+	if (opts.formats & FormatStats)
+		out << "file\tsamples\tmissing\tmin\tmax\tmean\tstddev\tp1\tmedian\tp99" << endl;
+
+	int failed = 0;
+	for (int i = 0; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		if (!r.warning.isEmpty())
+			err << r.warning << endl;
+		if (!r.ok)
+		{
+			err << r.err << endl;
+			failed++;
+			continue;
+		}
+
+		if (opts.formats & FormatStats)
+		{
+			const FrameStats &s = r.stats;
+			out << r.file << '\t' << s.samples << '\t' << s.missing << '\t'
+					<< QString::number(s.min, 'f', 2) << '\t' << QString::number(s.max, 'f', 2) << '\t'
+					<< QString::number(s.mean, 'f', 2) << '\t' << QString::number(s.stddev, 'f', 2) << '\t'
+					<< QString::number(s.p1, 'f', 2) << '\t' << QString::number(s.median, 'f', 2) << '\t'
+					<< QString::number(s.p99, 'f', 2) << endl;
+		}
+	}
+
+	return failed ? 2 : 0;
+}
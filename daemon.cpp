@@ -0,0 +1,192 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* qthermcamd - runs scans without GUI, controlled through a local socket */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+
+#include "logging.h"
+#include "scanserver.h"
+
+using namespace QThermCam;
+
+namespace
+{
+
+QString tr(const char *s)
+{
+	return QCoreApplication::translate("daemon", s);
+}
+
+/* daemon answers right away, only scans take long */
+enum { REPLY_TIMEOUT = 10000 };
+
+/* Sends requests to running daemon and prints its replies. With wait and a
+ * scan request, stays subscribed until the scan finishes. Exit code: 0 - ok,
+ * 1 - no daemon, 2 - request failed, timed out or scan was not complete.
+ */
+int runClient(const QString &name, const QStringList &requests, bool wait)
+{
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	QLocalSocket socket;
+	socket.connectToServer(name);
+	if (!socket.waitForConnected(3000))
+	{
+		err << tr("Cannot connect to %1: %2").arg(name).arg(socket.errorString()) << endl;
+		return 1;
+	}
+
+	// there would be nothing to wait for
+	bool scan = false;
+	for (int i = 0; i < requests.size(); ++i)
+		if (QJsonDocument::fromJson(requests[i].toUtf8()).object().value("cmd").toString() == "scan")
+			scan = true;
+	wait = wait && scan;
+
+	QStringList all = requests;
+	if (wait)
+		all.prepend("{\"cmd\": \"subscribe\"}");
+	for (int i = 0; i < all.size(); ++i)
+		socket.write(all[i].toUtf8().trimmed() + '\n');
+
+	int replies = 0, failed = 0;
+	while (replies < all.size() || wait)
+	{
+		int timeout = replies < all.size() ? REPLY_TIMEOUT : -1;
+		if (!socket.canReadLine() && !socket.waitForReadyRead(timeout))
+		{
+			err << tr("No reply: %1").arg(socket.errorString()) << endl;
+			return 2;
+		}
+
+		while (socket.canReadLine())
+		{
+			QByteArray line = socket.readLine();
+			QJsonObject obj = QJsonDocument::fromJson(line).object();
+			if (obj.contains("event"))
+			{
+				if (obj.value("event").toString() == "scanFinished")
+				{
+					out << line << flush;
+					return obj.value("complete").toBool() && !obj.contains("saveError") ? 0 : 2;
+				}
+				// samples would flood the terminal, rows show progress
+				if (obj.value("event").toString() == "samples")
+					continue;
+			}
+			else
+			{
+				replies++;
+				if (!obj.value("ok").toBool())
+					failed++;
+			}
+			out << line << flush;
+		}
+
+		// nothing to wait for if the scan could not start
+		if (wait && replies == all.size() && failed)
+			return 2;
+	}
+
+	return failed ? 2 : 0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	// settings are shared with the GUI
+	QCoreApplication::setOrganizationDomain("github.com/mslusarz/qthermcam");
+	QCoreApplication::setApplicationName("QThermCam");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(tr("Scans without GUI. Without --send runs the daemon, which keeps "
+			"the device connected and accepts JSON requests, one per line, on a local socket."));
+	parser.addHelpOption();
+	parser.addPositionalArgument("requests", tr("With --send: requests, e.g. '{\"cmd\": \"status\"}'."),
+			"[requests...]");
+
+	QCommandLineOption socketOpt(QStringList() << "s" << "socket", tr("Local socket name."), "name", "qthermcamd");
+	QCommandLineOption deviceOpt(QStringList() << "d" << "device",
+			tr("Device to connect to at start, \"auto\" to look for it."), "path");
+	QCommandLineOption sendOpt("send", tr("Send requests to running daemon and print replies."));
+	QCommandLineOption waitOpt(QStringList() << "w" << "wait", tr("With --send: wait until the scan finishes."));
+	QCommandLineOption shmOpt("shm", tr("POSIX shared memory object with live frames, empty - none."),
+			"name", "/qthermcamd");
+	QCommandLineOption queueOpt(QStringList() << "q" << "queue", tr("File with queued scan jobs."), "file",
+			QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/queue.json");
+	QCommandLineOption outputOpt(QStringList() << "o" << "output-dir",
+			tr("Directory for files saved on request of clients."), "dir",
+			QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/scans");
+	QCommandLineOption verboseOpt(QStringList() << "v" << "verbose", tr("Log debug messages too."));
+	parser.addOption(socketOpt);
+	parser.addOption(deviceOpt);
+	parser.addOption(sendOpt);
+	parser.addOption(waitOpt);
+	parser.addOption(shmOpt);
+	parser.addOption(queueOpt);
+	parser.addOption(outputOpt);
+	parser.addOption(verboseOpt);
+	parser.process(app);
+
+	if (parser.isSet(sendOpt))
+		return runClient(parser.value(socketOpt), parser.positionalArguments(), parser.isSet(waitOpt));
+
+	// every line read from the device is a debug message
+	uint levels = (1 << LevelInfo) | (1 << LevelWarning) | (1 << LevelError);
+	if (parser.isSet(verboseOpt))
+		levels |= 1 << LevelDebug;
+	setLogMask((1 << CategoryCount) - 1, levels);
+
+	QTextStream err(stderr);
+	QString msg;
+	ScanServer server(NULL);
+	if (!server.setOutputDir(parser.value(outputOpt), msg) || !server.listen(parser.value(socketOpt), msg))
+	{
+		err << msg << endl;
+		return 1;
+	}
+
+	// readers can still poll saved files
+	if (!parser.value(shmOpt).isEmpty() && !server.publish(parser.value(shmOpt), msg))
+		err << msg << endl;
+
+	if (!server.loadQueue(parser.value(queueOpt), msg))
+	{
+		err << msg << endl;
+		return 1;
+	}
+
+	if (parser.isSet(deviceOpt))
+	{
+		QString device = parser.value(deviceOpt);
+		// not fatal, device can be connected later by a client
+		if (!server.connectDevice(device == "auto" ? QString() : device, msg))
+			err << msg << endl;
+	}
+
+	return app.exec();
+}
@@ -0,0 +1,283 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "daemonclient.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+using namespace QThermCam;
+
+DaemonClient::DaemonClient(QObject *parent) : QObject(parent), active(false), nextId(1), scanConfigureId(-1),
+		scanning(false), rowsDone(0)
+{
+	socket = new QLocalSocket(this);
+	connect(socket, SIGNAL(connected()), this, SLOT(socketConnected()));
+	connect(socket, SIGNAL(disconnected()), this, SLOT(socketDisconnected()));
+	connect(socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(socketError(QLocalSocket::LocalSocketError)));
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readable()));
+}
+
+void DaemonClient::connectToDaemon(const QString &name)
+{
+	if (active)
+		return;
+	active = true;
+	socket->connectToServer(name);
+}
+
+void DaemonClient::disconnectFromDaemon()
+{
+	socket->abort();
+	closed();
+}
+
+/* emits disconnected once per connectToDaemon, whichever way it ended */
+void DaemonClient::closed()
+{
+	if (!active)
+		return;
+	active = false;
+	pending.clear();
+	scanConfigureId = -1;
+	scanning = false;
+	devicePath.clear();
+	emit disconnected();
+}
+
+int DaemonClient::request(QJsonObject req)
+{
+	int id = nextId++;
+	req["id"] = id;
+	pending[id] = req.value("cmd").toString();
+	socket->write(QJsonDocument(req).toJson(QJsonDocument::Compact) + '\n');
+	return id;
+}
+
+void DaemonClient::scan(const QJsonObject &config)
+{
+	QJsonObject req = config;
+	req["cmd"] = QString("configure");
+	scanConfigureId = request(req);
+}
+
+void DaemonClient::stop()
+{
+	QJsonObject req;
+	req["cmd"] = QString("stop");
+	request(req);
+}
+
+void DaemonClient::socketConnected()
+{
+	emit info(tr("%1: connected to qthermcamd").arg(socket->serverName()));
+	emit connected();
+
+	// events first, so nothing happening between the replies is missed
+	QJsonObject req;
+	req["cmd"] = QString("subscribe");
+	request(req);
+	req["cmd"] = QString("status");
+	request(req);
+}
+
+void DaemonClient::socketDisconnected()
+{
+	emit info(tr("%1: disconnected from qthermcamd").arg(socket->serverName()));
+	closed();
+}
+
+void DaemonClient::socketError(QLocalSocket::LocalSocketError)
+{
+	emit error(tr("%1: %2").arg(socket->serverName()).arg(socket->errorString()));
+	// connection which was up ends with disconnected
+	if (socket->state() == QLocalSocket::UnconnectedState)
+		closed();
+}
+
+void DaemonClient::readable()
+{
+	while (socket->canReadLine())
+	{
+		QByteArray line = socket->readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+
+		QJsonParseError parseError;
+		QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+		if (!doc.isObject())
+		{
+			emit warning(tr("qthermcamd sent invalid line: %1").arg(parseError.errorString()));
+			continue;
+		}
+
+		QJsonObject obj = doc.object();
+		if (obj.contains("event"))
+			handleEvent(obj);
+		else
+			handleReply(obj);
+	}
+}
+
+void DaemonClient::handleReply(const QJsonObject &r)
+{
+	int id = r.value("id").toInt(-1);
+	if (!pending.contains(id))
+		return;
+	QString cmd = pending.take(id);
+
+	if (!r.value("ok").toBool())
+	{
+		emit error(tr("qthermcamd: %1 failed: %2").arg(cmd).arg(r.value("error").toString()));
+		if (id == scanConfigureId || cmd == "scan")
+		{
+			scanConfigureId = -1;
+			// scan of other client may be running, it's not over
+			if (!scanning)
+				emit scanFinished(false);
+		}
+		return;
+	}
+
+	if (cmd == "status")
+		statusReceived(r);
+	else if (cmd == "frame")
+	{
+		ThermFrame frame = frameFromJson(r);
+		if (frame.isEmpty())
+			return;
+		scanning = true;
+		emit scanJoined(frame, rowsDone);
+	}
+	else if (id == scanConfigureId)
+	{
+		scanConfigureId = -1;
+		QJsonObject req;
+		req["cmd"] = QString("scan");
+		request(req);
+	}
+}
+
+void DaemonClient::statusReceived(const QJsonObject &s)
+{
+	devicePath = s.value("path").toString();
+	if (s.contains("device"))
+	{
+		QJsonObject dims = s.value("device").toObject();
+		emit deviceReady(dims.value("xmin").toInt(), dims.value("xmax").toInt(),
+				dims.value("ymin").toInt(), dims.value("ymax").toInt());
+	}
+
+	// frame scanned so far is sent in one reply, later samples come as events
+	if (s.value("scanning").toBool() && !scanning)
+	{
+		rowsDone = s.value("rowsDone").toInt();
+		QJsonObject req;
+		req["cmd"] = QString("frame");
+		request(req);
+	}
+}
+
+void DaemonClient::handleEvent(const QJsonObject &e)
+{
+	QString event = e.value("event").toString();
+
+	if (event == "samples")
+	{
+		if (!scanning)
+			return;
+		QJsonArray values = e.value("temps").toArray();
+		QVector<float> temps(values.size());
+		for (int i = 0; i < values.size(); ++i)
+			temps[i] = values[i].toDouble(-1000);
+		emit samplesRead(e.value("x").toInt(), e.value("y").toInt(), temps);
+	}
+	else if (event == "row")
+	{
+		if (scanning)
+			emit rowScanned(e.value("rowsDone").toInt(), e.value("rowsTotal").toInt());
+	}
+	else if (event == "scanStarted")
+	{
+		scanning = true;
+		emit scanStarted(e.value("xmin").toInt(), e.value("xmax").toInt(),
+				e.value("ymin").toInt(), e.value("ymax").toInt());
+	}
+	else if (event == "scanFinished")
+	{
+		scanning = false;
+		if (e.contains("saved"))
+			emit info(tr("qthermcamd: file %1 saved").arg(e.value("saved").toString()));
+		if (e.contains("saveError"))
+			emit error(tr("qthermcamd: %1").arg(e.value("saveError").toString()));
+		emit scanFinished(e.value("complete").toBool());
+	}
+	else if (event == "ready")
+		statusReceived(e.value("status").toObject());
+	else if (event == "connected")
+	{
+		devicePath = e.value("path").toString();
+		emit info(tr("qthermcamd: %1: connected").arg(devicePath));
+	}
+	else if (event == "connectionLost")
+		emit warning(tr("qthermcamd: connection to device lost, waiting for it"));
+	else if (event == "reconnected")
+		emit info(tr("qthermcamd: device reconnected"));
+	else if (event == "log")
+	{
+		QString level = e.value("level").toString();
+		QString msg = tr("qthermcamd: %1").arg(e.value("message").toString());
+		if (level == "error")
+			emit error(msg);
+		else if (level == "warning")
+			emit warning(msg);
+		else
+			emit info(msg);
+	}
+}
+
+/* inverse of ScanServer::frameJson */
+ThermFrame DaemonClient::frameFromJson(const QJsonObject &f)
+{
+	ThermFrame frame;
+	int xmin = f.value("xmin").toInt(), xmax = f.value("xmax").toInt();
+	int ymin = f.value("ymin").toInt(), ymax = f.value("ymax").toInt();
+	// nothing was scanned yet
+	if (xmin > xmax || ymin > ymax)
+		return frame;
+	frame.reset(xmin, xmax, ymin, ymax);
+
+	QJsonArray data = f.value("data").toArray();
+	if (data.size() != frame.data.size())
+		return ThermFrame();
+	for (int i = 0; i < data.size(); ++i)
+		frame.data[i] = data[i].toDouble(-1000);
+
+	QJsonArray variance = f.value("variance").toArray();
+	if (variance.size() == frame.data.size())
+	{
+		frame.variance.resize(variance.size());
+		for (int i = 0; i < variance.size(); ++i)
+			frame.variance[i] = variance[i].toDouble(-1);
+	}
+
+	QJsonObject metadata = f.value("metadata").toObject();
+	for (QJsonObject::const_iterator it = metadata.constBegin(); it != metadata.constEnd(); ++it)
+		frame.metadata[it.key()] = it.value().toString();
+	return frame;
+}
@@ -0,0 +1,79 @@
+#ifndef DAEMONCLIENT_H_
+#define DAEMONCLIENT_H_
+
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QMap>
+#include <QObject>
+#include <QVector>
+
+#include "thermframe.h"
+
+namespace QThermCam
+{
+
+/* GUI side of the qthermcamd protocol (see ScanServer). Subscribes to events
+ * as soon as it's connected, so scans started by other clients or by the
+ * queue are seen too. */
+class DaemonClient : public QObject
+{
+	Q_OBJECT
+	QLocalSocket *socket;
+	/* connectToDaemon was called and disconnected was not emitted yet */
+	bool active;
+	int nextId;
+	/* commands of requests waiting for reply, by id */
+	QMap<int, QString> pending;
+	/* id of configure request after which scan is sent, -1 if none */
+	int scanConfigureId;
+	/* samples are ignored until dimensions of the scanned frame are known */
+	bool scanning;
+	int rowsDone;
+	QString devicePath;
+
+	int request(QJsonObject req);
+	void closed();
+	void handleReply(const QJsonObject &r);
+	void handleEvent(const QJsonObject &e);
+	void statusReceived(const QJsonObject &s);
+	static ThermFrame frameFromJson(const QJsonObject &f);
+
+public:
+	DaemonClient(QObject *parent);
+
+	void connectToDaemon(const QString &name);
+	void disconnectFromDaemon();
+	bool isConnected() const { return socket->state() == QLocalSocket::ConnectedState; }
+	/* device the daemon is connected to, empty if none */
+	QString path() const { return devicePath; }
+
+	/* configures the daemon with config (see "configure" request) and starts
+	 * a scan if it was accepted */
+	void scan(const QJsonObject &config);
+	void stop();
+
+signals:
+	void connected();
+	void disconnected();
+	void deviceReady(int xmin, int xmax, int ymin, int ymax);
+	void scanStarted(int xmin, int xmax, int ymin, int ymax);
+	/* scan was already running when this client connected */
+	void scanJoined(const ThermFrame &frame, int rowsDone);
+	void samplesRead(int x, int y, const QVector<float> &temps);
+	void rowScanned(int rowsDone, int rowsTotal);
+	void scanFinished(bool complete);
+
+	void info(const QString &msg);
+	void warning(const QString &msg);
+	void error(const QString &msg);
+
+private slots:
+	void socketConnected();
+	void socketDisconnected();
+	void socketError(QLocalSocket::LocalSocketError err);
+	void readable();
+};
+
+}
+
+#endif /* DAEMONCLIENT_H_ */
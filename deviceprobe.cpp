@@ -0,0 +1,268 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "deviceprobe.h"
+#include "logging.h"
+#include "thermcam.h"
+
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+
+using namespace QThermCam;
+
+PortProbe::PortProbe(const QString &path, QObject *parent) : QObject(parent), path_(path), fd(-1), notifier(NULL),
+		haveDims(false), xmin(-1), xmax(-1), ymin(-1), ymax(-1)
+{
+	timer = new QTimer(this);
+	timer->setSingleShot(true);
+	connect(timer, SIGNAL(timeout()), this, SLOT(timeout()));
+}
+
+PortProbe::~PortProbe()
+{
+	if (fd == -1)
+		return;
+
+	delete notifier;
+	::close(fd);
+	QString err;
+	ThermCam::unlockDevice(path_, err);
+}
+
+bool PortProbe::start(int timeoutMs)
+{
+	QString err;
+	// lock is held by ThermCam even while it waits for the device to come back
+	if (!ThermCam::lockDevice(path_, err))
+		return false;
+
+	QByteArray pathLocal = path_.toLocal8Bit();
+	fd = open(pathLocal.constData(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd == -1)
+	{
+		ThermCam::unlockDevice(path_, err);
+		return false;
+	}
+
+	// same settings as ThermCam::openDevice, in particular without HUPCL,
+	// so closing the port does not reset the board before ThermCam opens it
+	struct termios argp;
+	memset(&argp, 0, sizeof(argp));
+	argp.c_iflag = INPCK;
+	argp.c_cflag = CS8 | CREAD | CLOCAL;
+	cfsetspeed(&argp, B115200);
+	if (tcsetattr(fd, TCSANOW, &argp))
+	{
+		::close(fd);
+		fd = -1;
+		ThermCam::unlockDevice(path_, err);
+		return false;
+	}
+
+	// board which was not reset by opening the port has to be asked; if it
+	// was reset, bootloader drops this and setup reports the same anyway
+	if (write(fd, "i!", 2) != 2)
+	{
+		::close(fd);
+		fd = -1;
+		ThermCam::unlockDevice(path_, err);
+		return false;
+	}
+
+	notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+	connect(notifier, SIGNAL(activated(int)), this, SLOT(readable()));
+	timer->start(timeoutMs);
+	return true;
+}
+
+void PortProbe::readable()
+{
+	char buf[256];
+	int r = read(fd, buf, sizeof(buf));
+	if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR))
+	{
+		finish(false);
+		return;
+	}
+
+	for (int i = 0; i < r; ++i)
+	{
+		if (buf[i] == '\r')
+			continue;
+		if (buf[i] != '\n')
+		{
+			// line noise of a device talking at other baud rate
+			if (buffer.size() > 256)
+			{
+				finish(false);
+				return;
+			}
+			buffer.append(buf[i]);
+			continue;
+		}
+
+		processLine(buffer);
+		buffer.truncate(0);
+		if (fd == -1)
+			return;
+	}
+}
+
+void PortProbe::processLine(const QByteArray &line)
+{
+	if (line.startsWith("Idims:"))
+	{
+		QList<QByteArray> dims = line.mid(6).split(',');
+		if (dims.size() != 4)
+			return;
+		xmin = dims[0].toInt();
+		xmax = dims[1].toInt();
+		ymin = dims[2].toInt();
+		ymax = dims[3].toInt();
+		haveDims = true;
+	}
+	else if (line.startsWith("Isf") && haveDims)
+		finish(true);
+}
+
+void PortProbe::timeout()
+{
+	finish(false);
+}
+
+void PortProbe::finish(bool found)
+{
+	timer->stop();
+	// may be called from the notifier's own signal
+	notifier->setEnabled(false);
+	notifier->deleteLater();
+	notifier = NULL;
+	::close(fd);
+	fd = -1;
+
+	QString err;
+	ThermCam::unlockDevice(path_, err);
+
+	emit finished(path_, found, xmin, xmax, ymin, ymax);
+}
+
+DeviceProbe::DeviceProbe(QObject *parent) : QObject(parent), watcher(NULL)
+{
+	hotplugTimer = new QTimer(this);
+	hotplugTimer->setSingleShot(true);
+	hotplugTimer->setInterval(HOTPLUG_DELAY);
+	connect(hotplugTimer, SIGNAL(timeout()), this, SLOT(checkHotplug()));
+}
+
+QStringList DeviceProbe::candidates()
+{
+	QDir dev("/dev");
+	QStringList names = dev.entryList(QStringList() << "ttyACM*" << "ttyUSB*", QDir::System, QDir::Name);
+	QStringList paths;
+	for (int i = 0; i < names.size(); ++i)
+		paths.append(dev.absoluteFilePath(names[i]));
+	return paths;
+}
+
+void DeviceProbe::probeAll()
+{
+	known = candidates();
+	for (int i = 0; i < known.size(); ++i)
+		probe(known[i]);
+
+	if (probes.isEmpty())
+		emit finished();
+}
+
+void DeviceProbe::probe(const QString &path)
+{
+	if (probes.contains(path))
+		return;
+
+	PortProbe *p = new PortProbe(path, this);
+	connect(p, SIGNAL(finished(const QString &, bool, int, int, int, int)),
+			this, SLOT(probeFinished(const QString &, bool, int, int, int, int)));
+	if (!p->start(PROBE_TIMEOUT))
+	{
+		TC_LOG(CategorySerial, LevelDebug, emit debug(tr("%1: in use or not accessible, not probed").arg(path)));
+		delete p;
+		return;
+	}
+	probes[path] = p;
+}
+
+void DeviceProbe::probeFinished(const QString &path, bool found, int xmin, int xmax, int ymin, int ymax)
+{
+	PortProbe *p = probes.take(path);
+	if (p)
+		p->deleteLater();
+
+	if (found)
+		emit deviceFound(path, xmin, xmax, ymin, ymax);
+	else
+		TC_LOG(CategorySerial, LevelDebug, emit debug(tr("%1: not a QThermCam").arg(path)));
+
+	if (probes.isEmpty())
+		emit finished();
+}
+
+void DeviceProbe::setWatching(bool watch)
+{
+	if (watch && !watcher)
+	{
+		known = candidates();
+		watcher = new QFileSystemWatcher(this);
+		watcher->addPath("/dev");
+		connect(watcher, SIGNAL(directoryChanged(const QString &)), this, SLOT(devChanged()));
+	}
+	else if (!watch && watcher)
+	{
+		delete watcher;
+		watcher = NULL;
+		hotplugTimer->stop();
+	}
+}
+
+void DeviceProbe::devChanged()
+{
+	// udev creates many nodes and links for one device, look once they settle
+	hotplugTimer->start();
+}
+
+void DeviceProbe::checkHotplug()
+{
+	QStringList current = candidates();
+
+	for (int i = 0; i < known.size(); ++i)
+		if (!current.contains(known[i]))
+			emit deviceRemoved(known[i]);
+
+	for (int i = 0; i < current.size(); ++i)
+		if (!known.contains(current[i]))
+			probe(current[i]);
+
+	known = current;
+}
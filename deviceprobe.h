@@ -0,0 +1,98 @@
+#ifndef DEVICEPROBE_H_
+#define DEVICEPROBE_H_
+
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QSocketNotifier;
+class QTimer;
+
+namespace QThermCam
+{
+
+/* One candidate tty being asked whether QThermCam firmware is on the other
+ * end. It has to answer with Idims: and Isf in time.
+ */
+class PortProbe : public QObject
+{
+	Q_OBJECT
+	QString path_;
+	int fd;
+	QSocketNotifier *notifier;
+	QTimer *timer;
+	QByteArray buffer;
+	bool haveDims;
+	int xmin, xmax, ymin, ymax;
+
+	void processLine(const QByteArray &line);
+	void finish(bool found);
+
+public:
+	PortProbe(const QString &path, QObject *parent);
+	~PortProbe();
+
+	/* false if device can't be opened or is used by someone else */
+	bool start(int timeoutMs);
+
+	const QString &path() { return path_; }
+
+private slots:
+	void readable();
+	void timeout();
+
+signals:
+	void finished(const QString &path, bool found, int xmin, int xmax, int ymin, int ymax);
+};
+
+/* Finds QThermCam devices. All candidate ttys are probed at the same time,
+ * so discovery takes as long as the slowest device, not the sum of them.
+ * /dev is watched (inotify) and devices plugged in later are probed too.
+ */
+class DeviceProbe : public QObject
+{
+	Q_OBJECT
+	/* reset device goes through bootloader (~1s) and setup before Isf */
+	enum { PROBE_TIMEOUT = 3000 };
+	/* udev sets permissions of new nodes a moment after they appear */
+	enum { HOTPLUG_DELAY = 200 };
+
+	QFileSystemWatcher *watcher;
+	QTimer *hotplugTimer;
+	/* candidates present at the last look into /dev */
+	QStringList known;
+	QMap<QString, PortProbe *> probes;
+
+	void probe(const QString &path);
+
+public:
+	DeviceProbe(QObject *parent);
+
+	/* /dev/ttyACM* and /dev/ttyUSB* */
+	static QStringList candidates();
+
+	/* probes all candidates, except those in use */
+	void probeAll();
+
+	void setWatching(bool watch);
+
+	bool probing() { return !probes.isEmpty(); }
+
+private slots:
+	void probeFinished(const QString &path, bool found, int xmin, int xmax, int ymin, int ymax);
+	void devChanged();
+	void checkHotplug();
+
+signals:
+	void deviceFound(const QString &path, int xmin, int xmax, int ymin, int ymax);
+	void deviceRemoved(const QString &path);
+	/* no probes left */
+	void finished();
+
+	void debug(const QString &msg);
+};
+
+}
+
+#endif /* DEVICEPROBE_H_ */
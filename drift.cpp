@@ -0,0 +1,92 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "drift.h"
+
+#include <QStringList>
+
+using namespace QThermCam;
+
+#define ROW_AMBIENT_KEY "rowAmbient"
+#define CORRECTED_KEY "driftCorrection"
+
+QMap<int, float> Drift::rowAmbient(const ThermFrame &frame)
+{
+	QMap<int, float> ret;
+	QStringList pairs = frame.metadata.value(ROW_AMBIENT_KEY).split(" ", QString::SkipEmptyParts);
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		QStringList yt = pairs[i].split(":");
+		bool oky, okt;
+		if (yt.size() != 2)
+			continue;
+		int y = yt[0].toInt(&oky);
+		float t = yt[1].toFloat(&okt);
+		// later sample of the same row (resumed scan) wins
+		if (oky && okt)
+			ret[y] = t;
+	}
+	return ret;
+}
+
+void Drift::addRowAmbient(QMap<QString, QString> &metadata, int y, float temp)
+{
+	QString &s = metadata[ROW_AMBIENT_KEY];
+	if (!s.isEmpty())
+		s += " ";
+	s += QString("%1:%2").arg(y).arg(temp, 0, 'f', 2);
+}
+
+bool Drift::isCorrected(const ThermFrame &frame)
+{
+	return frame.metadata.contains(CORRECTED_KEY);
+}
+
+bool Drift::correct(ThermFrame &frame, float k)
+{
+	QMap<int, float> ambient = rowAmbient(frame);
+	if (ambient.size() < 2)
+		return false;
+
+	// rows are scanned from ymin, so the first sample is the reference
+	float ref = ambient.begin().value();
+	int width = frame.width();
+	float *data = frame.data.data();
+
+	for (int y = frame.ymin; y <= frame.ymax; ++y)
+	{
+		float a;
+		QMap<int, float>::const_iterator next = ambient.lowerBound(y);
+		if (next == ambient.constEnd())
+			a = (next - 1).value();
+		else if (next.key() == y || next == ambient.constBegin())
+			a = next.value();
+		else
+		{
+			QMap<int, float>::const_iterator prev = next - 1;
+			a = prev.value() + (next.value() - prev.value()) * (y - prev.key()) / (next.key() - prev.key());
+		}
+
+		float delta = k * (a - ref);
+		float *row = data + (y - frame.ymin) * width;
+		for (int x = 0; x < width; ++x)
+			if (row[x] != -1000)
+				row[x] -= delta;
+	}
+
+	frame.metadata[CORRECTED_KEY] = QString::number(k);
+	return true;
+}
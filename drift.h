@@ -0,0 +1,33 @@
+#ifndef DRIFT_H_
+#define DRIFT_H_
+
+#include <QMap>
+#include <QString>
+
+#include "thermframe.h"
+
+namespace QThermCam
+{
+
+/* Sensor body warms up during long scans and its readings drift with it.
+ * Ambient (sensor body) temperature sampled during scan is kept in frame
+ * metadata as "y:temp" pairs and used to bring all rows to the conditions
+ * of the first one.
+ */
+namespace Drift
+{
+	QMap<int, float> rowAmbient(const ThermFrame &frame);
+
+	void addRowAmbient(QMap<QString, QString> &metadata, int y, float temp);
+
+	bool isCorrected(const ThermFrame &frame);
+
+	/* subtracts k * (ambient(y) - ambient(first sampled row)) from row y,
+	 * ambient of rows in between samples is interpolated; fails if there
+	 * are less than 2 samples */
+	bool correct(ThermFrame &frame, float k);
+}
+
+}
+
+#endif /* DRIFT_H_ */
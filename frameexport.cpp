@@ -0,0 +1,157 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "frameexport.h"
+#include "histogram.h"
+
+#include <QIODevice>
+#include <QtEndian>
+
+#include <math.h>
+#include <string.h>
+
+using namespace QThermCam;
+
+QImage FrameExport::toImage(const ThermFrame &frame, float tmin, float tmax, int scale, PaletteType palette)
+{
+	int width = frame.width(), height = frame.height();
+	const QRgb *colors = paletteTable(palette);
+	const float *temps = frame.data.constData();
+	scale = qMax(scale, 1);
+
+	QImage img(width * scale, height * scale, QImage::Format_RGB32);
+	for (int y = 0; y < height; ++y)
+	{
+		QRgb *line = (QRgb *)img.scanLine((height - y - 1) * scale);
+		for (int x = 0; x < width; ++x)
+		{
+			float t = temps[y * width + x];
+			QRgb c;
+			if (t == -1000)
+				c = qRgb(0, 0, 0);
+			else if (tmax <= tmin)
+				c = colors[0];
+			else
+				c = colors[qBound(0, (int)((t - tmin) * (PALETTE_LEVELS - 1) / (tmax - tmin)), PALETTE_LEVELS - 1)];
+			for (int i = 0; i < scale; ++i)
+				line[x * scale + i] = c;
+		}
+
+		for (int i = 1; i < scale; ++i)
+			memcpy(img.scanLine((height - y - 1) * scale + i), line, img.bytesPerLine());
+	}
+
+	return img;
+}
+
+bool FrameExport::writeCsv(QIODevice &f, const ThermFrame &frame)
+{
+	int width = frame.width(), height = frame.height();
+	const float *temps = frame.data.constData();
+
+	for (int y = 0; y < height; ++y)
+	{
+		QByteArray line;
+		line.reserve(width * 7);
+		for (int x = 0; x < width; ++x)
+		{
+			if (x > 0)
+				line += ',';
+			float t = temps[y * width + x];
+			if (t != -1000)
+				line += QByteArray::number(t, 'f', 2);
+		}
+		line += '\n';
+
+		if (f.write(line) != line.size())
+			return false;
+	}
+
+	return true;
+}
+
+bool FrameExport::writeNpy(QIODevice &f, const ThermFrame &frame)
+{
+	int width = frame.width(), height = frame.height();
+	const float *temps = frame.data.constData();
+
+	// format version 1.0, header padded so data starts at multiple of 64
+	QByteArray dict = "{'descr': '<f4', 'fortran_order': False, 'shape': (" +
+			QByteArray::number(height) + ", " + QByteArray::number(width) + "), }";
+	int headerLen = 10 + dict.size() + 1;
+	dict += QByteArray((64 - headerLen % 64) % 64, ' ');
+	dict += '\n';
+
+	QByteArray out("\x93NUMPY\x01\x00", 8);
+	uchar len[2];
+	qToLittleEndian<quint16>(dict.size(), len);
+	out.append((const char *)len, 2);
+	out += dict;
+
+	int start = out.size();
+	out.resize(start + width * height * 4);
+	uchar *d = (uchar *)out.data() + start;
+	for (int i = 0; i < width * height; ++i)
+	{
+		float t = temps[i] == -1000 ? NAN : temps[i];
+		quint32 u;
+		memcpy(&u, &t, 4);
+		qToLittleEndian<quint32>(u, d + i * 4);
+	}
+
+	return f.write(out) == out.size();
+}
+
+FrameStats FrameExport::stats(const ThermFrame &frame)
+{
+	FrameStats s;
+	Histogram histogram;
+	double sum = 0, sum2 = 0;
+	const float *temps = frame.data.constData();
+
+	s.samples = s.missing = 0;
+	s.min = 999;
+	s.max = -999;
+	for (int i = 0; i < frame.data.size(); ++i)
+	{
+		float t = temps[i];
+		if (t == -1000)
+		{
+			s.missing++;
+			continue;
+		}
+		s.samples++;
+		s.min = qMin(s.min, t);
+		s.max = qMax(s.max, t);
+		sum += t;
+		sum2 += (double)t * t;
+		histogram.add(t);
+	}
+
+	if (s.samples == 0)
+	{
+		s.min = s.max = s.mean = s.stddev = s.p1 = s.median = s.p99 = 0;
+		return s;
+	}
+
+	s.mean = sum / s.samples;
+	s.stddev = sqrt(qMax(0.0, sum2 / s.samples - (sum / s.samples) * (sum / s.samples)));
+	s.p1 = histogram.percentile(0.01f);
+	s.median = histogram.percentile(0.5f);
+	s.p99 = histogram.percentile(0.99f);
+
+	return s;
+}
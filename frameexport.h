@@ -0,0 +1,45 @@
+#ifndef FRAMEEXPORT_H_
+#define FRAMEEXPORT_H_
+
+#include <QImage>
+
+#include "palette.h"
+#include "thermframe.h"
+
+class QIODevice;
+
+namespace QThermCam
+{
+
+struct FrameStats
+{
+	int samples, missing;
+	float min, max, mean, stddev;
+	float p1, median, p99;
+};
+
+/* Conversions of ThermFrame to other formats. Don't need widgets and can be
+ * called from any thread.
+ */
+namespace FrameExport
+{
+	/* tmin..tmax is mapped to the whole palette, top row is ymax (as in the
+	 * GUI), not measured points are black; each sample becomes scale x scale
+	 * pixels */
+	QImage toImage(const ThermFrame &frame, float tmin, float tmax, int scale = 1,
+			PaletteType palette = PaletteDefault);
+
+	/* one line per row, first line is ymin, empty fields for not measured
+	 * points */
+	bool writeCsv(QIODevice &f, const ThermFrame &frame);
+
+	/* NumPy .npy, float32 array of shape (height, width), row 0 is ymin, NaN
+	 * for not measured points */
+	bool writeNpy(QIODevice &f, const ThermFrame &frame);
+
+	FrameStats stats(const ThermFrame &frame);
+}
+
+}
+
+#endif /* FRAMEEXPORT_H_ */
@@ -0,0 +1,433 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "framefile.h"
+#include "calibration.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+using namespace QThermCam;
+
+FileProgress::FileProgress(QObject *parent) : QObject(parent), cancelled_(0), percent(-1)
+{
+}
+
+void FileProgress::reset()
+{
+	cancelled_.store(0);
+	percent.store(-1);
+}
+
+void FileProgress::report(qint64 done, qint64 total)
+{
+	int p = total > 0 ? done * 100 / total : 0;
+	int old = percent.load();
+	if (p != old && percent.testAndSetRelaxed(old, p))
+		emit progress(p);
+}
+
+bool FrameFile::load(const QString &file, ThermFrame &frame, const Calibration &calibration, QString &err,
+		QString &warning, FileProgress *progress)
+{
+	QFile f(file);
+
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		err = tr("Cannot open file %1 for reading: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	if (f.peek(4) == "QTCB")
+		return loadBinary(f, frame, err, progress);
+	return loadXml(f, frame, calibration, err, warning, progress);
+}
+
+bool FrameFile::save(const QString &file, const ThermFrame &frame, QString &err, FileProgress *progress)
+{
+	// old file stays untouched if anything goes wrong
+	QSaveFile f(file);
+	if (!f.open(QIODevice::WriteOnly))
+	{
+		err = tr("Cannot open file %1 for writing: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	bool ok;
+	if (file.endsWith(".qtcb"))
+		ok = saveBinary(f, frame, progress);
+	else
+		ok = saveXml(f, frame, progress);
+
+	if (!ok)
+	{
+		f.cancelWriting();
+		if (progress && progress->cancelled())
+			err = tr("Saving to file %1 cancelled").arg(file);
+		else
+			err = tr("Cannot write to file %1: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	if (!f.commit())
+	{
+		err = tr("Cannot write to file %1: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	return true;
+}
+
+/* shortest text which reads back as the same float */
+static QString floatToString(float f)
+{
+	QString s = QString::number(f);
+	if (s.toFloat() != f)
+		s = QString::number(f, 'g', 9);
+	return s;
+}
+
+bool FrameFile::saveXml(QIODevice &f, const ThermFrame &frame, FileProgress *progress)
+{
+	int dataWidth = frame.width();
+	int dataHeight = frame.height();
+	const float *buffer = frame.data.constData();
+
+	// same layout QDomDocument::toString used to produce
+	QXmlStreamWriter xml(&f);
+	xml.setAutoFormatting(true);
+	xml.setAutoFormattingIndent(1);
+
+	xml.writeDTD("<!DOCTYPE qtdc>");
+	xml.writeStartElement("qtdc");
+
+	xml.writeStartElement("fov");
+	xml.writeAttribute("xmin", QString::number(frame.xmin));
+	xml.writeAttribute("xmax", QString::number(frame.xmax));
+	xml.writeAttribute("ymin", QString::number(frame.ymin));
+	xml.writeAttribute("ymax", QString::number(frame.ymax));
+	xml.writeEndElement();
+
+	xml.writeStartElement("highlight");
+	xml.writeAttribute("x", QString::number(frame.xhighlight));
+	xml.writeAttribute("y", QString::number(frame.yhighlight));
+	xml.writeEndElement();
+
+	// make it easy to parse, also by external tools
+	xml.writeStartElement("data");
+	for(int y = 0; y < dataHeight; ++y)
+	{
+		if (progress)
+		{
+			if (progress->cancelled())
+				return false;
+			progress->report(y, dataHeight);
+		}
+
+		xml.writeStartElement("row");
+		xml.writeAttribute("y", QString::number(y + frame.ymin));
+
+		for (int x = 0; x < dataWidth; ++x)
+		{
+			xml.writeStartElement("col");
+			xml.writeAttribute("x", QString::number(x + frame.xmin));
+			float f = buffer[y * dataWidth + x];
+			if (f == -1000)
+				xml.writeAttribute("val", "");
+			else
+				xml.writeAttribute("val", floatToString(f));
+			if (!frame.variance.isEmpty() && frame.variance[y * dataWidth + x] >= 0)
+				xml.writeAttribute("var", floatToString(frame.variance[y * dataWidth + x]));
+			xml.writeEndElement();
+		}
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement("show");
+	for (int i = 0; i < frame.labels.size(); ++i)
+	{
+		xml.writeStartElement("point");
+		xml.writeAttribute("x", QString::number(frame.labels[i].x()));
+		xml.writeAttribute("y", QString::number(frame.labels[i].y()));
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	if (!frame.rescanned.isEmpty())
+	{
+		xml.writeStartElement("rescanned");
+		for (int i = 0; i < frame.rescanned.size(); ++i)
+		{
+			xml.writeStartElement("point");
+			xml.writeAttribute("x", QString::number(frame.rescanned[i].x()));
+			xml.writeAttribute("y", QString::number(frame.rescanned[i].y()));
+			xml.writeEndElement();
+		}
+		xml.writeEndElement();
+	}
+
+	if (!frame.metadata.isEmpty())
+	{
+		xml.writeStartElement("metadata");
+		for (QMap<QString, QString>::const_iterator it = frame.metadata.begin(); it != frame.metadata.end(); ++it)
+		{
+			xml.writeStartElement("item");
+			xml.writeAttribute("key", it.key());
+			xml.writeAttribute("value", it.value());
+			xml.writeEndElement();
+		}
+		xml.writeEndElement();
+	}
+
+	xml.writeEndDocument();
+
+	if (progress)
+		progress->report(1, 1);
+
+	return !xml.hasError();
+}
+
+static uint qHash(const QPoint &p)
+{
+	return (p.x() << 16) + p.y();
+}
+
+static int intAttribute(const QXmlStreamAttributes &attrs, const char *name, int def, bool *ok = NULL)
+{
+	QStringRef v = attrs.value(QLatin1String(name));
+	if (v.isEmpty())
+	{
+		if (ok)
+			*ok = true;
+		return def;
+	}
+	return v.toInt(ok);
+}
+
+bool FrameFile::loadXml(QFile &f, ThermFrame &frame, const Calibration &calibration, QString &err,
+		QString &warning, FileProgress *progress)
+{
+	QString file = f.fileName();
+	QXmlStreamReader xml(&f);
+	bool haveFov = false;
+	qint64 size = f.size();
+	// rows may mark the same points as the rescanned list
+	QSet<QPoint> rescanned;
+
+	frame = ThermFrame();
+
+	// root element, "qtdc" or "qtcd"
+	xml.readNextStartElement();
+
+	while (xml.readNextStartElement())
+	{
+		QXmlStreamAttributes attrs = xml.attributes();
+
+		if (xml.name() == "data" && !haveFov)
+		{
+			frame.reset(0, 180, 0, 180);
+			haveFov = true;
+		}
+
+		if (xml.name() == "fov")
+		{
+			int xmin = intAttribute(attrs, "xmin", 0);
+			int xmax = intAttribute(attrs, "xmax", 180);
+			int ymin = intAttribute(attrs, "ymin", 0);
+			int ymax = intAttribute(attrs, "ymax", 180);
+			if (xmax < xmin || ymax < ymin || xmax - xmin > 1000 || ymax - ymin > 1000)
+			{
+				err = tr("Invalid field of view in file %1").arg(file);
+				return false;
+			}
+
+			int xhl = frame.xhighlight, yhl = frame.yhighlight;
+			frame.reset(xmin, xmax, ymin, ymax);
+			frame.xhighlight = xhl;
+			frame.yhighlight = yhl;
+			haveFov = true;
+			xml.skipCurrentElement();
+		}
+		else if (xml.name() == "highlight")
+		{
+			frame.xhighlight = intAttribute(attrs, "x", -1);
+			frame.yhighlight = intAttribute(attrs, "y", -1);
+			xml.skipCurrentElement();
+		}
+		else if (xml.name() == "data")
+		{
+			float *buffer = frame.data.data();
+			int dataWidth = frame.width();
+
+			// device can store raw sensor readings, they are converted with current calibration
+			bool raw = attrs.value(QLatin1String("units")) == QLatin1String("raw");
+
+			while (xml.readNextStartElement())
+			{
+				if (xml.name() != "row")
+				{
+					xml.skipCurrentElement();
+					continue;
+				}
+
+				if (progress)
+				{
+					if (progress->cancelled())
+					{
+						err = tr("Loading of file %1 cancelled").arg(file);
+						return false;
+					}
+					progress->report(f.pos(), size);
+				}
+
+				int y = intAttribute(xml.attributes(), "y", -1);
+				if (y < frame.ymin || y > frame.ymax)
+				{
+					err = tr("Invalid row number: %1").arg(y);
+					return false;
+				}
+
+				while (xml.readNextStartElement())
+				{
+					if (xml.name() != "col")
+					{
+						xml.skipCurrentElement();
+						continue;
+					}
+
+					QXmlStreamAttributes cattrs = xml.attributes();
+					QStringRef tstr = cattrs.value(QLatin1String("val"));
+
+					// written by the device for points it had to read again
+					if (cattrs.hasAttribute(QLatin1String("rescan")))
+					{
+						QPoint p(intAttribute(cattrs, "x", -1), y);
+						if (p.x() >= frame.xmin && p.x() <= frame.xmax && !rescanned.contains(p))
+						{
+							rescanned.insert(p);
+							frame.rescanned.append(p);
+						}
+					}
+
+					if (!tstr.isEmpty())
+					{
+						bool okt, okx;
+						float t = raw ? calibration.toCelsius(tstr.toUInt(&okt)) : tstr.toFloat(&okt);
+						int x = intAttribute(cattrs, "x", -1, &okx);
+						if (okt && okx)
+						{
+							if (x < frame.xmin || x > frame.xmax)
+							{
+								err = tr("Invalid column number: %1 in row %2").arg(x).arg(y);
+								return false;
+							}
+							buffer[(y - frame.ymin) * dataWidth + x - frame.xmin] = t;
+
+							QStringRef vstr = cattrs.value(QLatin1String("var"));
+							bool okv;
+							float v = vstr.toFloat(&okv);
+							if (okv)
+							{
+								if (frame.variance.isEmpty())
+									frame.variance.fill(-1, frame.data.size());
+								frame.variance[(y - frame.ymin) * dataWidth + x - frame.xmin] = v;
+							}
+						}
+						else
+						{
+							err = tr("Unable to parse x or temperature in row: %1").arg(y);
+							return false;
+						}
+					}
+
+					xml.skipCurrentElement();
+				}
+			}
+		}
+		else if (xml.name() == "show")
+		{
+			while (xml.readNextStartElement())
+			{
+				if (xml.name() == "point")
+				{
+					int x = intAttribute(xml.attributes(), "x", -1);
+					int y = intAttribute(xml.attributes(), "y", -1);
+					if (x < frame.xmin || x > frame.xmax || y < frame.ymin || y > frame.ymax)
+					{
+						err = tr("Invalid selection: %1 / %2").arg(x).arg(y);
+						return false;
+					}
+
+					frame.labels.append(QPoint(x, y));
+				}
+				xml.skipCurrentElement();
+			}
+		}
+		else if (xml.name() == "rescanned")
+		{
+			while (xml.readNextStartElement())
+			{
+				if (xml.name() == "point")
+				{
+					QPoint p(intAttribute(xml.attributes(), "x", -1), intAttribute(xml.attributes(), "y", -1));
+					if (p.x() >= frame.xmin && p.x() <= frame.xmax && p.y() >= frame.ymin && p.y() <= frame.ymax &&
+							!rescanned.contains(p))
+					{
+						rescanned.insert(p);
+						frame.rescanned.append(p);
+					}
+				}
+				xml.skipCurrentElement();
+			}
+		}
+		else if (xml.name() == "metadata")
+		{
+			while (xml.readNextStartElement())
+			{
+				if (xml.name() == "item")
+					frame.metadata[xml.attributes().value("key").toString()] =
+							xml.attributes().value("value").toString();
+				xml.skipCurrentElement();
+			}
+		}
+		else
+			xml.skipCurrentElement();
+	}
+
+	if (xml.hasError())
+	{
+		// files written by the device are not closed properly if scan was interrupted
+		if (xml.error() != QXmlStreamReader::PrematureEndOfDocumentError || !haveFov)
+		{
+			err = tr("Cannot parse file %1, error: %2, line: %3, col: %4").arg(file).arg(xml.errorString())
+					.arg(xml.lineNumber()).arg(xml.columnNumber());
+			return false;
+		}
+		warning = tr("File %1 is incomplete, loaded data available up to line %2").arg(file).arg(xml.lineNumber());
+	}
+
+	if (!haveFov)
+		frame.reset(0, 180, 0, 180);
+
+	if (progress)
+		progress->report(1, 1);
+
+	return true;
+}
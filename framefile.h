@@ -0,0 +1,73 @@
+#ifndef FRAMEFILE_H_
+#define FRAMEFILE_H_
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QObject>
+
+#include "thermframe.h"
+
+class QFile;
+class QIODevice;
+
+namespace QThermCam
+{
+
+class Calibration;
+
+/* Lets file operations running in other threads report progress and notice
+ * cancellation requests.
+ */
+class FileProgress : public QObject
+{
+	Q_OBJECT
+	QAtomicInt cancelled_;
+	QAtomicInt percent;
+
+public:
+	FileProgress(QObject *parent = 0);
+
+	void reset();
+
+	void cancel() { cancelled_.store(1); }
+
+	bool cancelled() { return cancelled_.load() != 0; }
+
+	/* thread safe */
+	void report(qint64 done, qint64 total);
+
+signals:
+	void progress(int percent);
+};
+
+/* Reading and writing of data files:
+ *  - .qtcd - XML, written by this program
+ *  - .qtc  - XML, written by the device to SD card, possibly with raw
+ *            readings, which are converted with given calibration
+ *  - .qtcb - binary, see framefile_binary.cpp
+ * All functions can be called from any thread, they don't read settings.
+ */
+class FrameFile
+{
+	Q_DECLARE_TR_FUNCTIONS(FrameFile)
+
+	static bool loadXml(QFile &f, ThermFrame &frame, const Calibration &calibration, QString &err,
+			QString &warning, FileProgress *progress);
+	static bool loadBinary(QFile &f, ThermFrame &frame, QString &err, FileProgress *progress);
+
+public:
+	/* recognizes format by contents */
+	static bool load(const QString &file, ThermFrame &frame, const Calibration &calibration, QString &err,
+			QString &warning, FileProgress *progress = NULL);
+
+	/* chooses format by suffix */
+	static bool save(const QString &file, const ThermFrame &frame, QString &err, FileProgress *progress = NULL);
+
+	static bool saveXml(QIODevice &f, const ThermFrame &frame, FileProgress *progress = NULL);
+
+	static bool saveBinary(QIODevice &f, const ThermFrame &frame, FileProgress *progress = NULL);
+};
+
+}
+
+#endif /* FRAMEFILE_H_ */
@@ -0,0 +1,350 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* .qtcb - binary QThermCam data file. All numbers are little endian.
+ *
+ * header, 32 bytes:
+ *   char    magic[4]       "QTCB"
+ *   uint16  version        QTCB_VERSION, readers reject newer versions
+ *   uint16  sampleFormat   0 - int16 hundredths of degree, 1 - float32 degrees
+ *   int16   xmin, xmax, ymin, ymax
+ *   int16   xhighlight, yhighlight
+ *   uint32  chunkCount
+ *   uint32  reserved[2]
+ *
+ * followed by chunkCount chunks:
+ *   char    tag[4]
+ *   uint32  size           of payload, without padding
+ *   payload, padded with zeroes to a multiple of 8 bytes
+ *
+ * chunks:
+ *   "DATA"  width * height samples, row-major, first row is ymin
+ *   "VALD"  validity bitmap, bit (i % 8) of byte (i / 8) is set if sample i
+ *           was measured
+ *   "LABL"  static labels, pairs of int16 (x, y)
+ *   "RSCN"  points which were read again during scan, pairs of int16 (x, y)
+ *   "VARI"  optional, width * height float32 variances of readings, layout
+ *           as DATA, negative where unknown
+ *   "META"  UTF-8 "key=value\n" lines
+ * Unknown chunks are skipped. Because header and chunk headers are multiples
+ * of 8 bytes, DATA payload is aligned and can be used directly from mapped
+ * file.
+ */
+
+#include "framefile.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <string.h>
+
+using namespace QThermCam;
+
+#define QTCB_VERSION 1
+
+enum { SAMPLES_INT16 = 0, SAMPLES_FLOAT32 = 1 };
+
+struct QtcbHeader
+{
+	char magic[4];
+	quint16 version;
+	quint16 sampleFormat;
+	qint16 xmin, xmax, ymin, ymax;
+	qint16 xhighlight, yhighlight;
+	quint32 chunkCount;
+	quint32 reserved[2];
+};
+
+struct QtcbChunkHeader
+{
+	char tag[4];
+	quint32 size;
+};
+
+static bool writeChunk(QIODevice &f, const char *tag, const QByteArray &payload)
+{
+	static const char zeroes[8] = { 0 };
+	QtcbChunkHeader ch;
+	memcpy(ch.tag, tag, 4);
+	ch.size = qToLittleEndian<quint32>(payload.size());
+	int padding = (8 - payload.size() % 8) % 8;
+
+	return f.write((const char *)&ch, sizeof(ch)) == sizeof(ch) &&
+			f.write(payload) == payload.size() &&
+			f.write(zeroes, padding) == padding;
+}
+
+static QByteArray pointsToBytes(const QList<QPoint> &points)
+{
+	QByteArray out;
+	for (int i = 0; i < points.size(); ++i)
+	{
+		uchar xy[4];
+		qToLittleEndian<qint16>(points[i].x(), xy);
+		qToLittleEndian<qint16>(points[i].y(), xy + 2);
+		out.append((const char *)xy, 4);
+	}
+	return out;
+}
+
+/* points outside of frame are skipped */
+static void bytesToPoints(const uchar *payload, qint64 size, const ThermFrame &frame, QList<QPoint> &points)
+{
+	for (qint64 j = 0; j + 4 <= size; j += 4)
+	{
+		QPoint p(qFromLittleEndian<qint16>(payload + j), qFromLittleEndian<qint16>(payload + j + 2));
+		if (p.x() >= frame.xmin && p.x() <= frame.xmax && p.y() >= frame.ymin && p.y() <= frame.ymax)
+			points.append(p);
+	}
+}
+
+bool FrameFile::saveBinary(QIODevice &f, const ThermFrame &frame, FileProgress *progress)
+{
+	int count = frame.width() * frame.height();
+	const float *buffer = frame.data.constData();
+
+	// int16 is enough for sensor data (0.01 C resolution, up to 327 C), but
+	// don't lose anything that does not fit
+	bool useInt16 = true;
+	for (int i = 0; i < count && useInt16; ++i)
+	{
+		float t = buffer[i];
+		if (t == -1000)
+			continue;
+		if (t <= -327 || t >= 327 || qRound(t * 100) / 100.0f != t)
+			useInt16 = false;
+	}
+
+	QByteArray data(count * (useInt16 ? 2 : 4), '\0');
+	QByteArray validity((count + 7) / 8, '\0');
+	uchar *d = (uchar *)data.data();
+	uchar *v = (uchar *)validity.data();
+	int width = frame.width();
+	for (int i = 0; i < count; ++i)
+	{
+		if (progress && i % width == 0)
+		{
+			if (progress->cancelled())
+				return false;
+			progress->report(i, count);
+		}
+
+		float t = buffer[i];
+		if (t == -1000)
+			t = 0;
+		else
+			v[i / 8] |= 1 << (i % 8);
+
+		if (useInt16)
+			qToLittleEndian<qint16>(qRound(t * 100), d + i * 2);
+		else
+		{
+			quint32 u;
+			memcpy(&u, &t, 4);
+			qToLittleEndian<quint32>(u, d + i * 4);
+		}
+	}
+
+	QByteArray labels = pointsToBytes(frame.labels);
+	QByteArray rescanned = pointsToBytes(frame.rescanned);
+
+	QByteArray variance;
+	if (!frame.variance.isEmpty())
+	{
+		variance.resize(count * 4);
+		uchar *vd = (uchar *)variance.data();
+		for (int i = 0; i < count; ++i)
+		{
+			quint32 u;
+			memcpy(&u, &frame.variance.at(i), 4);
+			qToLittleEndian<quint32>(u, vd + i * 4);
+		}
+	}
+
+	QByteArray meta;
+	for (QMap<QString, QString>::const_iterator it = frame.metadata.begin(); it != frame.metadata.end(); ++it)
+		meta += it.key().toUtf8() + "=" + it.value().toUtf8() + "\n";
+
+	QtcbHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "QTCB", 4);
+	h.version = qToLittleEndian<quint16>(QTCB_VERSION);
+	h.sampleFormat = qToLittleEndian<quint16>(useInt16 ? SAMPLES_INT16 : SAMPLES_FLOAT32);
+	h.xmin = qToLittleEndian<qint16>(frame.xmin);
+	h.xmax = qToLittleEndian<qint16>(frame.xmax);
+	h.ymin = qToLittleEndian<qint16>(frame.ymin);
+	h.ymax = qToLittleEndian<qint16>(frame.ymax);
+	h.xhighlight = qToLittleEndian<qint16>(frame.xhighlight);
+	h.yhighlight = qToLittleEndian<qint16>(frame.yhighlight);
+	h.chunkCount = qToLittleEndian<quint32>(variance.isEmpty() ? 5 : 6);
+
+	bool ok = f.write((const char *)&h, sizeof(h)) == sizeof(h) &&
+			writeChunk(f, "DATA", data) &&
+			writeChunk(f, "VALD", validity) &&
+			writeChunk(f, "LABL", labels) &&
+			writeChunk(f, "RSCN", rescanned) &&
+			writeChunk(f, "META", meta) &&
+			(variance.isEmpty() || writeChunk(f, "VARI", variance));
+
+	if (ok && progress)
+		progress->report(1, 1);
+
+	return ok;
+}
+
+bool FrameFile::loadBinary(QFile &f, ThermFrame &frame, QString &err, FileProgress *progress)
+{
+	qint64 size = f.size();
+	QByteArray contents;
+	const uchar *base = f.map(0, size);
+	if (!base)
+	{
+		contents = f.readAll();
+		base = (const uchar *)contents.constData();
+		size = contents.size();
+	}
+
+	if (size < (qint64)sizeof(QtcbHeader))
+	{
+		err = tr("File %1 is too short").arg(f.fileName());
+		return false;
+	}
+
+	QtcbHeader h;
+	memcpy(&h, base, sizeof(h));
+	int version = qFromLittleEndian<quint16>(h.version);
+	int sampleFormat = qFromLittleEndian<quint16>(h.sampleFormat);
+	int xmin = qFromLittleEndian<qint16>(h.xmin);
+	int xmax = qFromLittleEndian<qint16>(h.xmax);
+	int ymin = qFromLittleEndian<qint16>(h.ymin);
+	int ymax = qFromLittleEndian<qint16>(h.ymax);
+
+	if (version > QTCB_VERSION)
+	{
+		err = tr("File %1 has unsupported version %2").arg(f.fileName()).arg(version);
+		return false;
+	}
+	if ((sampleFormat != SAMPLES_INT16 && sampleFormat != SAMPLES_FLOAT32) ||
+			xmax < xmin || ymax < ymin || xmax - xmin > 1000 || ymax - ymin > 1000)
+	{
+		err = tr("File %1 has invalid header").arg(f.fileName());
+		return false;
+	}
+
+	frame.reset(xmin, xmax, ymin, ymax);
+	frame.xhighlight = qFromLittleEndian<qint16>(h.xhighlight);
+	frame.yhighlight = qFromLittleEndian<qint16>(h.yhighlight);
+
+	int width = frame.width();
+	int count = width * frame.height();
+	int sampleSize = sampleFormat == SAMPLES_INT16 ? 2 : 4;
+	const uchar *data = NULL, *validity = NULL;
+	qint64 pos = sizeof(QtcbHeader);
+	quint32 chunks = qFromLittleEndian<quint32>(h.chunkCount);
+
+	for (quint32 i = 0; i < chunks; ++i)
+	{
+		QtcbChunkHeader ch;
+		if (pos + (qint64)sizeof(ch) > size)
+			break;
+		memcpy(&ch, base + pos, sizeof(ch));
+		pos += sizeof(ch);
+		qint64 chunkSize = qFromLittleEndian<quint32>(ch.size);
+		if (pos + chunkSize > size)
+		{
+			err = tr("File %1 is truncated").arg(f.fileName());
+			return false;
+		}
+		const uchar *payload = base + pos;
+
+		if (memcmp(ch.tag, "DATA", 4) == 0 && chunkSize >= (qint64)count * sampleSize)
+			data = payload;
+		else if (memcmp(ch.tag, "VALD", 4) == 0 && chunkSize >= (count + 7) / 8)
+			validity = payload;
+		else if (memcmp(ch.tag, "LABL", 4) == 0)
+			bytesToPoints(payload, chunkSize, frame, frame.labels);
+		else if (memcmp(ch.tag, "RSCN", 4) == 0)
+			bytesToPoints(payload, chunkSize, frame, frame.rescanned);
+		else if (memcmp(ch.tag, "VARI", 4) == 0 && chunkSize >= (qint64)count * 4)
+		{
+			frame.variance.resize(count);
+			for (int j = 0; j < count; ++j)
+			{
+				quint32 u = qFromLittleEndian<quint32>(payload + j * 4);
+				memcpy(&frame.variance[j], &u, 4);
+			}
+		}
+		else if (memcmp(ch.tag, "META", 4) == 0)
+		{
+			QList<QByteArray> lines = QByteArray((const char *)payload, chunkSize).split('\n');
+			for (int j = 0; j < lines.size(); ++j)
+			{
+				int eq = lines[j].indexOf('=');
+				if (eq > 0)
+					frame.metadata[QString::fromUtf8(lines[j].left(eq))] = QString::fromUtf8(lines[j].mid(eq + 1));
+			}
+		}
+
+		pos += (chunkSize + 7) & ~7;
+	}
+
+	if (!data || !validity)
+	{
+		err = tr("File %1 has no data").arg(f.fileName());
+		return false;
+	}
+
+	float *buffer = frame.data.data();
+	for (int first = 0; first < count; first += width)
+	{
+		if (progress)
+		{
+			if (progress->cancelled())
+			{
+				err = tr("Loading of file %1 cancelled").arg(f.fileName());
+				return false;
+			}
+			progress->report(first, count);
+		}
+
+		// no conversion needed, copy rows straight from mapped file
+		if (sampleFormat == SAMPLES_FLOAT32 && Q_BYTE_ORDER == Q_LITTLE_ENDIAN)
+			memcpy(buffer + first, data + first * 4, width * 4);
+		else if (sampleFormat == SAMPLES_FLOAT32)
+		{
+			for (int i = first; i < first + width; ++i)
+			{
+				quint32 u = qFromLittleEndian<quint32>(data + i * 4);
+				memcpy(&buffer[i], &u, 4);
+			}
+		}
+		else
+		{
+			for (int i = first; i < first + width; ++i)
+				buffer[i] = qFromLittleEndian<qint16>(data + i * 2) / 100.0f;
+		}
+
+		for (int i = first; i < first + width; ++i)
+			if (!(validity[i / 8] & (1 << (i % 8))))
+				buffer[i] = -1000;
+	}
+
+	if (progress)
+		progress->report(1, 1);
+
+	return true;
+}
@@ -0,0 +1,102 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "frameio.h"
+#include "framefile.h"
+
+#include <QtConcurrentRun>
+
+using namespace QThermCam;
+
+FrameIO::FrameIO(QObject *parent) : QObject(parent)
+{
+	progress_ = new FileProgress(this);
+	connect(progress_, SIGNAL(progress(int)), this, SIGNAL(progress(int)));
+	connect(&watcher, SIGNAL(finished()), this, SLOT(finished()));
+}
+
+FrameIO::~FrameIO()
+{
+	// don't lose data user asked to save
+	if (busy() && !job.save)
+		progress_->cancel();
+	watcher.waitForFinished();
+}
+
+bool FrameIO::run(Job *job, FileProgress *progress)
+{
+	if (job->save)
+		return FrameFile::save(job->file, job->frame, job->err, progress);
+	return FrameFile::load(job->file, job->frame, job->calibration, job->err, job->warning, progress);
+}
+
+void FrameIO::start()
+{
+	job.err.clear();
+	job.warning.clear();
+	progress_->reset();
+	emit started(job.file);
+	watcher.setFuture(QtConcurrent::run(&FrameIO::run, &job, progress_));
+}
+
+bool FrameIO::load(const QString &file, const Calibration &calibration)
+{
+	if (busy())
+		return false;
+
+	job.save = false;
+	job.file = file;
+	job.calibration = calibration;
+	job.frame = ThermFrame();
+	start();
+	return true;
+}
+
+bool FrameIO::save(const QString &file, const ThermFrame &frame)
+{
+	if (busy())
+		return false;
+
+	job.save = true;
+	job.file = file;
+	job.frame = frame;
+	start();
+	return true;
+}
+
+void FrameIO::cancel()
+{
+	progress_->cancel();
+}
+
+void FrameIO::finished()
+{
+	bool ok = watcher.result();
+
+	// drop reference to the scan buffer, so it's not copied on next change
+	ThermFrame frame = job.frame;
+	job.frame = ThermFrame();
+
+	if (!job.warning.isEmpty())
+		emit warning(job.warning);
+
+	if (!ok)
+		emit error(job.err);
+	else if (job.save)
+		emit saved(job.file);
+	else
+		emit loaded(job.file, frame);
+}
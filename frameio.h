@@ -0,0 +1,72 @@
+#ifndef FRAMEIO_H_
+#define FRAMEIO_H_
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+
+#include "calibration.h"
+#include "thermframe.h"
+
+namespace QThermCam
+{
+
+class FileProgress;
+
+/* Runs FrameFile operations in a worker thread, one at a time. Results are
+ * delivered by signals in the thread FrameIO lives in.
+ */
+class FrameIO : public QObject
+{
+	Q_OBJECT
+
+	struct Job
+	{
+		bool save;
+		QString file;
+		ThermFrame frame;
+		Calibration calibration;
+		QString err, warning;
+	};
+
+	FileProgress *progress_;
+	QFutureWatcher<bool> watcher;
+	Job job;
+
+	static bool run(Job *job, FileProgress *progress);
+
+	void start();
+
+public:
+	FrameIO(QObject *parent = 0);
+
+	/* waits for running save, cancels load */
+	~FrameIO();
+
+	bool busy() { return watcher.isRunning(); }
+
+	/* returns false if another operation is in progress; raw readings are
+	 * converted with calibration */
+	bool load(const QString &file, const Calibration &calibration);
+
+	/* frame is shared, not copied, so scan can go on while it's being saved */
+	bool save(const QString &file, const ThermFrame &frame);
+
+public slots:
+	void cancel();
+
+private slots:
+	void finished();
+
+signals:
+	void started(const QString &file);
+	void progress(int percent);
+	void loaded(const QString &file, const ThermFrame &frame);
+	void saved(const QString &file);
+	void warning(const QString &msg);
+	void error(const QString &msg);
+};
+
+}
+
+#endif /* FRAMEIO_H_ */
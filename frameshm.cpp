@@ -0,0 +1,227 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* Live frame ring - POSIX shared memory object (/dev/shm/<name>):
+ *
+ *   FrameShmHeader, padded to 64 bytes
+ *   FRAME_SHM_SLOTS slots of slotSize bytes each:
+ *     FrameShmSlot, padded to 64 bytes
+ *     float data[FRAME_SHM_MAX_SIDE * FRAME_SHM_MAX_SIDE]
+ *
+ * Every scan takes the next slot, so the previous FRAME_SHM_SLOTS - 1 frames
+ * stay readable while a new one is scanned. Writer is the only one changing
+ * anything; all counters are stored with release and should be loaded with
+ * acquire semantics.
+ *
+ * Reading a row:
+ *   1. f = currentFrame, slot = f % slotCount
+ *   2. s1 = slot.seq (acquire); retry while odd
+ *   3. check slot.frame == f and rowFrame[y - ymin] == f, copy or use the row
+ *   4. __atomic_thread_fence(__ATOMIC_ACQUIRE), so that the reads of step 3
+ *      can't be moved after the next load
+ *   5. s2 = slot.seq (relaxed is enough); if s1 != s2, the slot was reused
+ *      for a newer frame
+ * Rows which are not complete can be read the same way, they just may still
+ * change. Poll generation to learn about new rows.
+ */
+
+#include "frameshm.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace QThermCam;
+
+template<typename T> static inline void storeRelease(T *p, T v)
+{
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+FrameShm::FrameShm() : fd(-1), map(NULL), size(0), header(NULL), slot(NULL), data(NULL)
+{
+}
+
+/* true if object was left by a daemon which is not running anymore */
+static bool isStale(const char *name)
+{
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1)
+		return errno == ENOENT;
+
+	struct stat st;
+	bool stale = false;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(FrameShmHeader))
+	{
+		void *m = mmap(NULL, sizeof(FrameShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+		if (m != MAP_FAILED)
+		{
+			const FrameShmHeader *h = (const FrameShmHeader *)m;
+			// objects of older versions have no owner, nobody reads them
+			stale = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == FRAME_SHM_MAGIC &&
+					(h->version < FRAME_SHM_VERSION ||
+					(h->owner > 0 && kill(h->owner, 0) == -1 && errno == ESRCH));
+			munmap(m, sizeof(FrameShmHeader));
+		}
+	}
+	::close(fd);
+	return stale;
+}
+
+bool FrameShm::open(const QString &name, QString &err)
+{
+	close();
+
+	quint32 slotSize = frameShmDataOffset() + FRAME_SHM_MAX_SIDE * FRAME_SHM_MAX_SIDE * sizeof(float);
+	slotSize = (slotSize + FRAME_SHM_ALIGN - 1) & ~(FRAME_SHM_ALIGN - 1);
+	size = frameShmSlotOffset(FRAME_SHM_SLOTS, slotSize);
+
+	QByteArray nameLocal = name.toLocal8Bit();
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+	fd = shm_open(nameLocal.constData(), O_RDWR | O_CREAT | O_EXCL, mode);
+	if (fd == -1 && errno == EEXIST && isStale(nameLocal.constData()))
+	{
+		shm_unlink(nameLocal.constData());
+		fd = shm_open(nameLocal.constData(), O_RDWR | O_CREAT | O_EXCL, mode);
+	}
+	if (fd == -1 && errno == EEXIST)
+	{
+		err = tr("Shared memory %1 is used by another process").arg(name);
+		return false;
+	}
+	if (fd == -1)
+	{
+		err = tr("Cannot create shared memory %1: %2").arg(name).arg(strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(fd, size))
+	{
+		err = tr("Cannot resize shared memory %1: %2").arg(name).arg(strerror(errno));
+		::close(fd);
+		shm_unlink(nameLocal.constData());
+		fd = -1;
+		return false;
+	}
+
+	void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (m == MAP_FAILED)
+	{
+		err = tr("Cannot map shared memory %1: %2").arg(name).arg(strerror(errno));
+		::close(fd);
+		shm_unlink(nameLocal.constData());
+		fd = -1;
+		return false;
+	}
+
+	map = (uchar *)m;
+	name_ = name;
+	header = (FrameShmHeader *)map;
+
+	// object is new and zeroed; readers check magic last, so they never see
+	// half initialized header
+	header->version = FRAME_SHM_VERSION;
+	header->slotCount = FRAME_SHM_SLOTS;
+	header->slotSize = slotSize;
+	header->owner = getpid();
+	storeRelease(&header->magic, (quint32)FRAME_SHM_MAGIC);
+	return true;
+}
+
+void FrameShm::close()
+{
+	if (!map)
+		return;
+
+	munmap(map, size);
+	::close(fd);
+	shm_unlink(name_.toLocal8Bit().constData());
+	map = NULL;
+	fd = -1;
+	header = NULL;
+	slot = NULL;
+	data = NULL;
+}
+
+void FrameShm::startFrame(int xmin, int xmax, int ymin, int ymax, qint64 started)
+{
+	if (!map || xmin < 0 || ymin < 0 || xmax >= FRAME_SHM_MAX_SIDE || ymax >= FRAME_SHM_MAX_SIDE)
+	{
+		slot = NULL;
+		data = NULL;
+		return;
+	}
+
+	quint64 frame = header->currentFrame + 1;
+	slot = (FrameShmSlot *)(map + frameShmSlotOffset(frame % header->slotCount, header->slotSize));
+	data = (float *)((uchar *)slot + frameShmDataOffset());
+
+	storeRelease(&slot->seq, slot->seq + 1);
+	// release store orders only what precedes it; without the fence the
+	// stores below could become visible before seq is odd
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->frame = frame;
+	slot->state = 0;
+	slot->started = started;
+	slot->xmin = xmin;
+	slot->xmax = xmax;
+	slot->ymin = ymin;
+	slot->ymax = ymax;
+	slot->rowsDone = 0;
+	for (int i = 0; i < FRAME_SHM_MAX_SIDE; ++i)
+		slot->rowFrame[i] = 0;
+	int count = (xmax - xmin + 1) * (ymax - ymin + 1);
+	for (int i = 0; i < count; ++i)
+		data[i] = -1000;
+	storeRelease(&slot->seq, slot->seq + 1);
+
+	storeRelease(&header->currentFrame, frame);
+	storeRelease(&header->generation, header->generation + 1);
+}
+
+void FrameShm::setTemperatures(int x, int y, const float *temps, int count)
+{
+	if (!slot || y < slot->ymin || y > slot->ymax || x < slot->xmin || x + count - 1 > slot->xmax)
+		return;
+
+	int width = slot->xmax - slot->xmin + 1;
+	memcpy(data + (y - slot->ymin) * width + (x - slot->xmin), temps, count * sizeof(float));
+}
+
+void FrameShm::rowDone(int y)
+{
+	if (!slot || y < slot->ymin || y > slot->ymax)
+		return;
+
+	storeRelease(&slot->rowFrame[y - slot->ymin], slot->frame);
+	storeRelease(&slot->rowsDone, slot->rowsDone + 1);
+	storeRelease(&header->generation, header->generation + 1);
+}
+
+void FrameShm::finishFrame(bool complete)
+{
+	if (!slot)
+		return;
+
+	storeRelease(&slot->state, (quint32)(complete ? 2 : 1));
+	storeRelease(&header->generation, header->generation + 1);
+	slot = NULL;
+	data = NULL;
+}
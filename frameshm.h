@@ -0,0 +1,108 @@
+#ifndef FRAMESHM_H_
+#define FRAMESHM_H_
+
+#include <QCoreApplication>
+#include <QtGlobal>
+
+namespace QThermCam
+{
+
+/* Layout of the live frame ring in POSIX shared memory, see frameshm.cpp.
+ * Readers map the object read-only and use only these definitions.
+ */
+enum
+{
+	FRAME_SHM_MAGIC = 0x4c435451, // "QTCL" in little endian
+	FRAME_SHM_VERSION = 2,
+	FRAME_SHM_SLOTS = 4,
+	/* servo positions are 0..180 */
+	FRAME_SHM_MAX_SIDE = 181,
+	FRAME_SHM_ALIGN = 64
+};
+
+struct FrameShmHeader
+{
+	quint32 magic;
+	quint32 version;
+	quint32 slotCount;
+	quint32 slotSize;
+	/* number of the newest frame, its slot is (frame % slotCount); 0 - none */
+	quint64 currentFrame;
+	/* incremented after every published row, cheap to poll */
+	quint64 generation;
+	/* pid of the daemon writing it */
+	qint32 owner;
+	quint32 reserved;
+};
+
+struct FrameShmSlot
+{
+	/* seqlock: odd while fields below (except data and rowFrame) change */
+	quint32 seq;
+	/* 1 - scan finished, 2 - and all rows were scanned */
+	quint32 state;
+	quint64 frame;
+	qint64 started;
+	qint32 xmin, xmax, ymin, ymax;
+	quint32 rowsDone;
+	/* frame number once row (y - ymin) is complete and won't change */
+	quint64 rowFrame[FRAME_SHM_MAX_SIDE];
+	/* followed by width * height floats at dataOffset, row-major, -1000 -
+	 * not measured */
+};
+
+static inline quint32 frameShmSlotOffset(quint32 slot, quint32 slotSize)
+{
+	quint32 header = (sizeof(FrameShmHeader) + FRAME_SHM_ALIGN - 1) & ~(FRAME_SHM_ALIGN - 1);
+	return header + slot * slotSize;
+}
+
+static inline quint32 frameShmDataOffset()
+{
+	return (sizeof(FrameShmSlot) + FRAME_SHM_ALIGN - 1) & ~(FRAME_SHM_ALIGN - 1);
+}
+
+/* Publishes frames being scanned. Samples are written in place as they
+ * come, so readers see rows without any copying or serialization.
+ */
+class FrameShm
+{
+	Q_DECLARE_TR_FUNCTIONS(FrameShm)
+
+	QString name_;
+	int fd;
+	uchar *map;
+	size_t size;
+	FrameShmHeader *header;
+	FrameShmSlot *slot;
+	float *data;
+
+public:
+	FrameShm();
+
+	~FrameShm() { close(); }
+
+	/* name like "/qthermcamd"; object left by a dead daemon is replaced,
+	 * one which is still in use is not */
+	bool open(const QString &name, QString &err);
+
+	/* removes the object, mapped copies stay valid for readers */
+	void close();
+
+	bool isOpen() { return map != NULL; }
+
+	const QString &name() { return name_; }
+
+	/* next slot of the ring gets this field of view, all unmeasured */
+	void startFrame(int xmin, int xmax, int ymin, int ymax, qint64 started);
+
+	void setTemperatures(int x, int y, const float *temps, int count);
+
+	void rowDone(int y);
+
+	void finishFrame(bool complete);
+};
+
+}
+
+#endif /* FRAMESHM_H_ */
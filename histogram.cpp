@@ -0,0 +1,101 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "histogram.h"
+
+using namespace QThermCam;
+
+// MLX90614 object range is -70..382.2 C, bins are 0.1 C wide
+#define HIST_TMIN -75.0f
+#define HIST_RESOLUTION 0.1f
+
+Histogram::Histogram() : bins(BIN_COUNT, 0), blocks(BIN_COUNT / BLOCK_SIZE, 0), total(0)
+{
+}
+
+void Histogram::clear()
+{
+	bins.fill(0);
+	blocks.fill(0);
+	total = 0;
+}
+
+int Histogram::binOf(float temp)
+{
+	int bin = (int)((temp - HIST_TMIN) / HIST_RESOLUTION);
+	if (bin < 0)
+		return 0;
+	if (bin >= BIN_COUNT)
+		return BIN_COUNT - 1;
+	return bin;
+}
+
+float Histogram::binTemperature(int bin)
+{
+	return HIST_TMIN + (bin + 0.5f) * HIST_RESOLUTION;
+}
+
+void Histogram::add(float temp)
+{
+	int bin = binOf(temp);
+	bins[bin]++;
+	blocks[bin / BLOCK_SIZE]++;
+	total++;
+}
+
+void Histogram::remove(float temp)
+{
+	int bin = binOf(temp);
+	if (bins[bin] == 0)
+		return;
+	bins[bin]--;
+	blocks[bin / BLOCK_SIZE]--;
+	total--;
+}
+
+float Histogram::percentile(float p) const
+{
+	if (total == 0)
+		return 0;
+
+	int wanted = (int)(p * total);
+	if (wanted >= total)
+		wanted = total - 1;
+	if (wanted < 0)
+		wanted = 0;
+
+	int block = 0, seen = 0;
+	while (block < blocks.size() - 1 && seen + blocks[block] <= wanted)
+		seen += blocks[block++];
+
+	int bin = block * BLOCK_SIZE;
+	int last = bin + BLOCK_SIZE - 1;
+	while (bin < last && seen + bins[bin] <= wanted)
+		seen += bins[bin++];
+
+	return binTemperature(bin);
+}
+
+void Histogram::cumulative(QVector<int> &cdf) const
+{
+	cdf.resize(BIN_COUNT);
+	int sum = 0;
+	for (int i = 0; i < BIN_COUNT; ++i)
+	{
+		sum += bins[i];
+		cdf[i] = sum;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <QVector>
+
+namespace QThermCam
+{
+
+/* Fixed-bin histogram of temperatures covering the whole sensor range.
+ * Bins are grouped into blocks with running totals, so percentile lookups
+ * walk at most (bins / BLOCK_SIZE + BLOCK_SIZE) counters, no matter how
+ * many samples were added.
+ */
+class Histogram
+{
+	QVector<int> bins;
+	QVector<int> blocks;
+	int total;
+
+public:
+	enum { BIN_COUNT = 4608, BLOCK_SIZE = 64 };
+
+	Histogram();
+
+	void clear();
+
+	void add(float temp);
+
+	void remove(float temp);
+
+	int count() const { return total; }
+
+	/* temperature below which lies fraction p (0..1) of all samples */
+	float percentile(float p) const;
+
+	/* fills cdf with the number of samples in bins [0, i] for each bin i */
+	void cumulative(QVector<int> &cdf) const;
+
+	static int binOf(float temp);
+
+	static float binTemperature(int bin);
+};
+
+}
+
+#endif /* HISTOGRAM_H_ */
@@ -0,0 +1,33 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "logging.h"
+
+quint32 QThermCam::logMask = 0xffffffff;
+
+void QThermCam::setLogMask(uint categories, uint levels)
+{
+	quint32 mask = 0;
+	for (int c = 0; c < CategoryCount; ++c)
+	{
+		// errors are rare and always worth showing
+		uint l = levels | (1 << LevelError);
+		if (!(categories & (1 << c)))
+			l = 1 << LevelError;
+		mask |= l << (c * LevelCount);
+	}
+	logMask = mask;
+}
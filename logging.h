@@ -0,0 +1,38 @@
+#ifndef LOGGING_H_
+#define LOGGING_H_
+
+#include <QtGlobal>
+
+namespace QThermCam
+{
+
+enum LogCategory { CategorySerial, CategoryScan, CategoryRender, CategoryFile, CategoryCount };
+
+enum LogLevel { LevelDebug, LevelInfo, LevelWarning, LevelError, LevelCount };
+
+/* bit (category * LevelCount + level) is set if messages of given category
+ * and level are consumed by anyone */
+extern quint32 logMask;
+
+static inline bool logEnabled(LogCategory category, LogLevel level)
+{
+	return logMask & (1u << (category * LevelCount + level));
+}
+
+/* enables given levels (bit per level) in given categories (bit per category) */
+void setLogMask(uint categories, uint levels);
+
+}
+
+/* Evaluates stmt (which usually formats a message and emits it) only if
+ * anyone is interested in it. Costs one test of a global when disabled.
+ */
+#define TC_LOG(category, level, stmt) \
+	do { \
+		if (QThermCam::logEnabled(QThermCam::category, QThermCam::level)) \
+		{ \
+			stmt; \
+		} \
+	} while (0)
+
+#endif /* LOGGING_H_ */
@@ -0,0 +1,202 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "logview.h"
+
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QThread>
+#include <QTime>
+
+using namespace QThermCam;
+
+static const char *levelNames[] = { "debug", "info", "warning", "error" };
+
+LogFile::LogFile(const QString &path, qint64 maxSize, int count) : QObject(), file(path), maxSize(maxSize),
+	count(count)
+{
+}
+
+void LogFile::rotate()
+{
+	QString path = file.fileName();
+	file.close();
+
+	QFile::remove(path + "." + QString::number(count - 1));
+	for (int i = count - 2; i > 0; --i)
+		QFile::rename(path + "." + QString::number(i), path + "." + QString::number(i + 1));
+	if (count > 1)
+		QFile::rename(path, path + ".1");
+	else
+		QFile::remove(path);
+}
+
+void LogFile::write(const QString &text)
+{
+	if (text.isEmpty())
+		return;
+	if (!file.isOpen() && !file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+		return;
+
+	file.write(text.toUtf8());
+	file.flush();
+
+	if (file.size() >= maxSize)
+		rotate();
+}
+
+LogView::LogView(QWidget *parent) : QPlainTextEdit(parent), head(0), count(0), pending(0),
+	levelMask((1 << LevelCount) - 1), fileThread(NULL), logFile(NULL)
+{
+	setReadOnly(true);
+	setUndoRedoEnabled(false);
+	setMaximumEntries(10000);
+
+	formats[LevelDebug].setForeground(QColor(128, 128, 128));
+	formats[LevelWarning].setForeground(QColor(192, 96, 0));
+	formats[LevelError].setForeground(QColor(255, 0, 0));
+	formats[LevelError].setFontWeight(QFont::Bold);
+}
+
+LogView::~LogView()
+{
+	setLogFile(QString());
+}
+
+void LogView::setMaximumEntries(int max)
+{
+	if (max < 1)
+		max = 1;
+
+	QVector<Entry> newRing(max);
+	int keep = qMin(count, max);
+	for (int i = 0; i < keep; ++i)
+		newRing[i] = ring[(head + count - keep + i) % ring.size()];
+
+	ring = newRing;
+	head = 0;
+	count = keep;
+	pending = qMin(pending, keep);
+	setMaximumBlockCount(max);
+}
+
+void LogView::setLevelEnabled(LogLevel level, bool enabled)
+{
+	if (enabled)
+		setLevelsMask(levelMask | (1 << level));
+	else
+		setLevelsMask(levelMask & ~(1 << level));
+}
+
+void LogView::setLevelsMask(uint mask)
+{
+	mask &= (1 << LevelCount) - 1;
+	if (mask == levelMask)
+		return;
+	levelMask = mask;
+
+	// rebuild the document from the ring
+	QPlainTextEdit::clear();
+	appendEntries(0, count - pending);
+}
+
+void LogView::setLogFile(const QString &path, qint64 maxSize, int count)
+{
+	if (fileThread)
+	{
+		// also waits for all previously queued writes
+		QMetaObject::invokeMethod(logFile, "write", Qt::BlockingQueuedConnection, Q_ARG(QString, fileBuffer));
+		fileBuffer.clear();
+
+		fileThread->quit();
+		fileThread->wait();
+		delete logFile;
+		delete fileThread;
+		logFile = NULL;
+		fileThread = NULL;
+	}
+
+	if (path.isEmpty())
+		return;
+
+	fileThread = new QThread(this);
+	logFile = new LogFile(path, maxSize, count);
+	logFile->moveToThread(fileThread);
+	connect(this, SIGNAL(writeToFile(const QString &)), logFile, SLOT(write(const QString &)));
+	fileThread->start(QThread::LowPriority);
+}
+
+void LogView::append(LogLevel level, const QString &text)
+{
+	Entry &e = ring[(head + count) % ring.size()];
+	if (count < ring.size())
+		count++;
+	else
+		head = (head + 1) % ring.size();
+	e.level = level;
+	e.text = text;
+
+	if (pending < ring.size())
+		pending++;
+
+	if (logFile)
+		fileBuffer += QString("%1 %2: %3\n").arg(QTime::currentTime().toString("hh:mm:ss.zzz"))
+				.arg(levelNames[level]).arg(text);
+}
+
+void LogView::appendEntries(int first, int n)
+{
+	if (n <= 0)
+		return;
+
+	QScrollBar *bar = verticalScrollBar();
+	bool atEnd = bar->value() == bar->maximum();
+
+	QTextCursor cursor(document());
+	cursor.movePosition(QTextCursor::End);
+	cursor.beginEditBlock();
+	for (int i = first; i < first + n; ++i)
+	{
+		const Entry &e = ring[(head + i) % ring.size()];
+		if (!(levelMask & (1 << e.level)))
+			continue;
+		if (!document()->isEmpty())
+			cursor.insertBlock();
+		cursor.insertText(e.text, formats[e.level]);
+	}
+	cursor.endEditBlock();
+
+	if (atEnd)
+		bar->setValue(bar->maximum());
+}
+
+void LogView::flush()
+{
+	appendEntries(count - pending, pending);
+	pending = 0;
+
+	if (!fileBuffer.isEmpty())
+	{
+		emit writeToFile(fileBuffer);
+		fileBuffer.clear();
+	}
+}
+
+void LogView::clear()
+{
+	head = count = pending = 0;
+	QPlainTextEdit::clear();
+}
@@ -0,0 +1,96 @@
+#ifndef LOGVIEW_H_
+#define LOGVIEW_H_
+
+#include <QFile>
+#include <QPlainTextEdit>
+#include <QTextCharFormat>
+#include <QVector>
+
+#include "logging.h"
+
+class QThread;
+
+namespace QThermCam
+{
+
+/* Appends text to a set of rotated files: path, path.1, ... path.<count - 1>.
+ * Lives in its own thread, so disk latency does not affect the GUI.
+ */
+class LogFile : public QObject
+{
+	Q_OBJECT
+	QFile file;
+	qint64 maxSize;
+	int count;
+
+	void rotate();
+
+public:
+	LogFile(const QString &path, qint64 maxSize, int count);
+
+public slots:
+	void write(const QString &text);
+};
+
+/* Log window. Keeps at most maximumEntries() messages in a ring buffer,
+ * shows only enabled levels and adds new messages to the document in
+ * batches, when flush() is called.
+ */
+class LogView : public QPlainTextEdit
+{
+	Q_OBJECT
+	struct Entry
+	{
+		LogLevel level;
+		QString text;
+	};
+
+	QVector<Entry> ring;
+	int head, count, pending;
+	uint levelMask;
+	QTextCharFormat formats[LevelCount];
+	QString fileBuffer;
+
+	QThread *fileThread;
+	LogFile *logFile;
+
+	void appendEntries(int first, int n);
+
+public:
+	LogView(QWidget *parent = 0);
+	~LogView();
+
+	void setMaximumEntries(int max);
+
+	int maximumEntries() { return ring.size(); }
+
+	void setLevelEnabled(LogLevel level, bool enabled);
+
+	bool levelEnabled(LogLevel level) { return levelMask & (1 << level); }
+
+	uint levelsMask() { return levelMask; }
+
+	void setLevelsMask(uint mask);
+
+	/* empty path disables writing to file */
+	void setLogFile(const QString &path, qint64 maxSize = 1024 * 1024, int count = 5);
+
+	bool writesToFile() { return logFile != NULL; }
+
+	void append(LogLevel level, const QString &text);
+
+	bool hasPending() { return pending > 0; }
+
+public slots:
+	/* shows messages appended since last flush */
+	void flush();
+
+	void clear();
+
+signals:
+	void writeToFile(const QString &text);
+};
+
+}
+
+#endif /* LOGVIEW_H_ */
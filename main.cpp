@@ -15,7 +15,6 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <QApplication>
-#include <QFile>
 #include <QString>
 #include "mainwin.h"
 
@@ -23,22 +22,9 @@ int main(int argc, char *argv[])
 {
 	QString path;
 	QApplication app(argc, argv);
+	// without path MainWin looks for the device itself
 	if (argc > 1)
 		path = QString(argv[1]);
-	else
-	{
-		for (int i = 0; i < 9; ++i)
-		{
-			QString path_ = "/dev/ttyACM" + QString::number(i);
-			if (QFile::exists(path_))
-			{
-				path = path_;
-				break;
-			}
-		}
-	}
-	if (path.isEmpty())
-		path = "/dev/tty?";
 
 	QCoreApplication::setOrganizationDomain("github.com/mslusarz/qthermcam");
 	QCoreApplication::setApplicationName("QThermCam");
@@ -17,40 +17,66 @@
 #include "mainwin.h"
 
 #include <QAction>
+#include <QActionGroup>
 #include <QApplication>
+#include <QComboBox>
+#include <QDateTime>
 #include <QDesktopWidget>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFormLayout>
+#include <QInputDialog>
+#include <QJsonObject>
 #include <QHBoxLayout>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QLineEdit>
 #include <QList>
 #include <QMenuBar>
+#include <QMessageBox>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QRect>
 #include <QSettings>
+#include <QSlider>
 #include <QSizePolicy>
 #include <QSpinBox>
 #include <QSplitter>
 #include <QStatusBar>
-#include <QTextEdit>
+#include <QTabWidget>
 #include <QTimer>
 #include <QToolBar>
 
+#include "calibration.h"
+#include "daemonclient.h"
+#include "deviceprobe.h"
+#include "drift.h"
+#include "frameio.h"
+#include "logview.h"
+#include "scanhead.h"
+#include "scanjournal.h"
+#include "series.h"
+#include "tempscale.h"
 #include "tempview.h"
 #include "thermcam.h"
-#include <math.h>
+#include "updatescheduler.h"
 
 using namespace QThermCam;
 
-MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), splitter(NULL), tempView(NULL), x(-1), y(-1),
-		temp_object(-1000), temp_ambient(-1000), imageFileDialog(NULL), dataFileDialog(NULL)
+MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), splitter(NULL), views(NULL), tempView(NULL),
+		deviceProbe(NULL), daemon(NULL), autoConnect(path.isEmpty()), rowsTotal(0), rowsDone(0), pointsDone(0), x(-1), y(-1),
+		temp_object(-1000), temp_ambient(-1000), imageFileDialog(NULL), dataFileDialog(NULL),
+		seriesFileDialog(NULL), journal(NULL), resumeRow(-1), benchmarkPreset(-1), series(NULL), updateScheduler(NULL), frameIO(NULL)
 {
 	thermCam = new ThermCam(this);
 	QSettings settings;
 
 	createActions();
+	configureThermCam(thermCam);
 	createMenus();
 	createToolBar();
 	createStatusBar();
@@ -64,8 +90,10 @@ MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), spli
 	leftPanelLayout->addWidget(new QLabel(tr("Max X"), leftPanel), 2, 0, Qt::AlignRight);
 	leftPanelLayout->addWidget(new QLabel(tr("Min Y"), leftPanel), 3, 0, Qt::AlignRight);
 	leftPanelLayout->addWidget(new QLabel(tr("Max Y"), leftPanel), 4, 0, Qt::AlignRight);
+	leftPanelLayout->addWidget(new QLabel(tr("Range"), leftPanel), 5, 0, Qt::AlignRight);
 
 	pathEdit = new QLineEdit(path, leftPanel);
+	pathEdit->setPlaceholderText(tr("looking for device..."));
 	pathEdit->installEventFilter(this);
 	leftPanelLayout->addWidget(pathEdit, 0, 1);
 
@@ -74,6 +102,7 @@ MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), spli
 	scanAction->setEnabled(false);
 	disconnectAction->setEnabled(false);
 	saveImageAction->setEnabled(false);
+	appendSeriesAction->setEnabled(false);
 
 	minX = new QSpinBox(leftPanel);
 	minX->setRange(0, 180);
@@ -95,18 +124,36 @@ MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), spli
 	maxY->setEnabled(false);
 	leftPanelLayout->addWidget(maxY, 4, 1);
 
+	// order has to match TempView::RangeMode
+	rangeMode = new QComboBox(leftPanel);
+	rangeMode->addItem(tr("Min - max"));
+	rangeMode->addItem(tr("1% - 99%"));
+	rangeMode->addItem(tr("Equalized"));
+	rangeMode->addItem(tr("Locked"));
+	rangeMode->setToolTip(tr("How temperatures are mapped to colors"));
+	leftPanelLayout->addWidget(rangeMode, 5, 1);
+
+	seriesLabel = new QLabel(leftPanel);
+	seriesLabel->hide();
+	leftPanelLayout->addWidget(seriesLabel, 6, 0, 1, 2);
+
+	seriesSlider = new QSlider(Qt::Horizontal, leftPanel);
+	seriesSlider->setToolTip(tr("Frame of the series"));
+	seriesSlider->hide();
+	leftPanelLayout->addWidget(seriesSlider, 7, 0, 1, 2);
+	connect(seriesSlider, SIGNAL(valueChanged(int)), this, SLOT(seriesPositionChanged(int)));
+
 	QWidget *spacer = new QWidget(leftPanel);
 	spacer->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::MinimumExpanding);
-	leftPanelLayout->addWidget(spacer, 5, 0);
+	leftPanelLayout->addWidget(spacer, 8, 0);
+
+	tempView = new TempView();
 
-	tempScale = new TempView(leftPanel);
-	leftPanelLayout->addWidget(tempScale, 6, 1);
+	tempScale = new TempScale(tempView, leftPanel);
+	leftPanelLayout->addWidget(tempScale, 9, 0, 1, 2);
 
 	bufferSizeChanged(settings.value("xmin").toInt(), settings.value("xmax").toInt(),
 					  settings.value("ymin").toInt(), settings.value("ymax").toInt());
-	fillTempScale(0, 100);
-	tempScale->refreshImage();
-	tempScale->refreshView();
 	leftPanel->setLayout(leftPanelLayout);
 
 	splitter = new QSplitter(this);
@@ -114,22 +161,36 @@ MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), spli
 
 	splitter->addWidget(leftPanel);
 
-	tempView = new TempView();
-	splitter->addWidget(tempView);
+	views = new QTabWidget(splitter);
+	views->addTab(tempView, tr("Main"));
+	splitter->addWidget(views);
 	connect(tempView, SIGNAL(leftMouseButtonClicked(const QPoint &)), this, SLOT(imageClicked(const QPoint &)));
 	connect(tempView, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
 	connect(tempView, SIGNAL(bufferSizeChanged(int, int, int, int)), this, SLOT(bufferSizeChanged(int, int, int, int)));
-	connect(tempView, SIGNAL(temperatureSet(int, int, float)), this, SLOT(temperatureSet(int, int, float)));
 
-	textEdit = new QTextEdit(splitter);
-	textEdit->setReadOnly(true);
-	textEdit->installEventFilter(this);
-	splitter->addWidget(textEdit);
+	// locked range is meaningless without data, so it's not restored
+	int mode = settings.value("rangeMode", TempView::RangeMinMax).toInt();
+	if (mode < TempView::RangeMinMax || mode >= TempView::RangeManual)
+		mode = TempView::RangeMinMax;
+	rangeMode->setCurrentIndex(mode);
+	tempView->setRangeMode((TempView::RangeMode)mode);
+	connect(rangeMode, SIGNAL(currentIndexChanged(int)), this, SLOT(rangeModeChanged(int)));
+
+	logView = new LogView(splitter);
+	logView->installEventFilter(this);
+	logView->setMaximumEntries(settings.value("logMaxLines", 10000).toInt());
+	logView->setLogFile(settings.value("logFile").toString(), settings.value("logFileMaxSize", 1024 * 1024).toLongLong(),
+			settings.value("logFileCount", 5).toInt());
+	applyLogFilter();
+	splitter->addWidget(logView);
 
 	settingsTimer = new QTimer(this);
 	settingsTimer->setSingleShot(true);
 	connect(settingsTimer, SIGNAL(timeout()), this, SLOT(saveSettings()));
 
+	updateScheduler = new UpdateScheduler(this, settings.value("refreshRate", 30).toInt());
+	connect(updateScheduler, SIGNAL(update(uint)), this, SLOT(updateUi(uint)));
+
 	if (!restoreGeometry(settings.value("geometry").toByteArray()))
 	{
 		QRect deskRect = QDesktopWidget().screenGeometry();
@@ -153,13 +214,79 @@ MainWin::MainWin(QString path) : QMainWindow(), thermCam(NULL), minX(NULL), spli
 	connect(thermCam, SIGNAL(scannerMoved_X(int)), this, SLOT(scannerMoved_X(int)));
 	connect(thermCam, SIGNAL(scannerMoved_Y(int)), this, SLOT(scannerMoved_Y(int)));
 	connect(thermCam, SIGNAL(objectTemperatureRead(int, int, float)), this, SLOT(objectTemperatureRead(int, int, float)));
+	connect(thermCam, SIGNAL(samplesRead(int, int, const QVector<float> &)), this, SLOT(samplesRead(int, int, const QVector<float> &)));
+	connect(thermCam, SIGNAL(variancesRead(int, int, const QVector<float> &)), this, SLOT(variancesRead(int, int, const QVector<float> &)));
 	connect(thermCam, SIGNAL(ambientTemperatureRead(float)), this, SLOT(ambientTemperatureRead(float)));
+	connect(thermCam, SIGNAL(rowAmbientRead(int, float)), this, SLOT(rowAmbientRead(int, float)));
+	connect(thermCam, SIGNAL(settleMeasured(int, float)), this, SLOT(settleMeasured(int, float)));
 	connect(thermCam, SIGNAL(scanningStopped()), this, SLOT(scanningStopped()));
+	connect(thermCam, SIGNAL(rowScanned(int, const QVector<float> &)), this, SLOT(rowDone(int, const QVector<float> &)));
+	connect(thermCam, SIGNAL(pointRescanned(int, int)), this, SLOT(pointRescanned(int, int)));
+	connect(thermCam, SIGNAL(connectionLost()), this, SLOT(connectionLost()));
+	connect(thermCam, SIGNAL(reconnected()), this, SLOT(reconnected()));
 
-	connect(thermCam, SIGNAL(debug(const QString &)), this, SLOT(log(const QString &)));
+	connect(thermCam, SIGNAL(debug(const QString &)), this, SLOT(logDebug(const QString &)));
 	connect(thermCam, SIGNAL(info(const QString &)), this, SLOT(log(const QString &)));
-	connect(thermCam, SIGNAL(warning(const QString &)), this, SLOT(logError(const QString &)));
+	connect(thermCam, SIGNAL(warning(const QString &)), this, SLOT(logWarning(const QString &)));
 	connect(thermCam, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
+
+	QStringList extra = settings.value("extraScanners").toStringList();
+	for (int i = 0; i < extra.size(); ++i)
+		addHead(extra[i]);
+
+	frameIO = new FrameIO(this);
+	connect(frameIO, SIGNAL(started(const QString &)), this, SLOT(fileOperationStarted(const QString &)));
+	connect(frameIO, SIGNAL(progress(int)), fileProgress, SLOT(setValue(int)));
+	connect(frameIO, SIGNAL(loaded(const QString &, const ThermFrame &)), this, SLOT(frameLoaded(const QString &, const ThermFrame &)));
+	connect(frameIO, SIGNAL(saved(const QString &)), this, SLOT(frameSaved(const QString &)));
+	connect(frameIO, SIGNAL(warning(const QString &)), this, SLOT(fileWarning(const QString &)));
+	connect(frameIO, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
+	connect(frameIO, SIGNAL(error(const QString &)), this, SLOT(fileOperationFinished()));
+	connect(fileCancel, SIGNAL(clicked()), frameIO, SLOT(cancel()));
+
+	journal = new ScanJournal(this);
+	connect(journal, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
+	connect(thermCam, SIGNAL(rowScanned(int, const QVector<float> &)), journal, SLOT(addRow(int, const QVector<float> &)));
+	checkJournal();
+	if (resumeRow >= 0)
+	{
+		ThermFrame frame;
+		journal->recover(frame, resumeRow);
+		tempView->setFrame(frame);
+		saveImageAction->setEnabled(true);
+		appendSeriesAction->setEnabled(true);
+		updateTempScale();
+		TC_LOG(CategoryFile, LevelInfo,
+				log(tr("Interrupted scan found, it can be resumed from row %1 after connecting").arg(resumeRow)));
+	}
+
+	daemon = new DaemonClient(this);
+	connect(daemon, SIGNAL(connected()), this, SLOT(daemonConnected()));
+	connect(daemon, SIGNAL(disconnected()), this, SLOT(daemonDisconnected()));
+	connect(daemon, SIGNAL(deviceReady(int, int, int, int)), this, SLOT(scannerReady(int, int, int, int)));
+	connect(daemon, SIGNAL(scanStarted(int, int, int, int)), this, SLOT(daemonScanStarted(int, int, int, int)));
+	connect(daemon, SIGNAL(scanJoined(const ThermFrame &, int)), this, SLOT(daemonScanJoined(const ThermFrame &, int)));
+	connect(daemon, SIGNAL(samplesRead(int, int, const QVector<float> &)), this, SLOT(samplesRead(int, int, const QVector<float> &)));
+	connect(daemon, SIGNAL(rowScanned(int, int)), this, SLOT(daemonRowScanned(int, int)));
+	connect(daemon, SIGNAL(scanFinished(bool)), this, SLOT(daemonScanFinished(bool)));
+	connect(daemon, SIGNAL(info(const QString &)), this, SLOT(log(const QString &)));
+	connect(daemon, SIGNAL(warning(const QString &)), this, SLOT(logWarning(const QString &)));
+	connect(daemon, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
+
+	// the daemon owns the device, don't grab it when it's plugged in
+	if (daemonAction->isChecked())
+		autoConnect = false;
+
+	deviceProbe = new DeviceProbe(this);
+	connect(deviceProbe, SIGNAL(deviceFound(const QString &, int, int, int, int)),
+			this, SLOT(deviceFound(const QString &, int, int, int, int)));
+	connect(deviceProbe, SIGNAL(deviceRemoved(const QString &)), this, SLOT(deviceRemoved(const QString &)));
+	connect(deviceProbe, SIGNAL(debug(const QString &)), this, SLOT(logDebug(const QString &)));
+	deviceProbe->setWatching(true);
+	if (daemonAction->isChecked())
+		doConnect();
+	else if (autoConnect)
+		deviceProbe->probeAll();
 }
 
 void MainWin::createActions()
@@ -179,12 +306,136 @@ void MainWin::createActions()
 
 	stopScanAction = new QAction(QIcon::fromTheme("process-stop"), tr("Stop scanning"), this);
 	stopScanAction->setStatusTip(tr("Stops scanning"));
-	connect(stopScanAction, SIGNAL(triggered()), thermCam, SLOT(stopScanning()));
+	connect(stopScanAction, SIGNAL(triggered()), this, SLOT(stopScanning()));
+
+	resumeScanAction = new QAction(QIcon::fromTheme("media-playback-start"), tr("Resume scanning"), this);
+	resumeScanAction->setStatusTip(tr("Continues interrupted scan from the first missing row"));
+	resumeScanAction->setEnabled(false);
+	connect(resumeScanAction, SIGNAL(triggered()), this, SLOT(resumeScan()));
+
+	QSettings settings;
+	sweepAction = new QAction(tr("Sweep scanning"), this);
+	sweepAction->setStatusTip(tr("Reads rows while moving the sensor continuously - much faster, slightly blurred"));
+	sweepAction->setCheckable(true);
+	sweepAction->setChecked(settings.value("sweepMode", false).toBool());
+	connect(sweepAction, SIGNAL(toggled(bool)), this, SLOT(scanModeChanged()));
+
+	rawModeAction = new QAction(tr("Raw readings"), this);
+	rawModeAction->setStatusTip(tr("Device sends raw sensor readings, they are converted with calibration here"));
+	rawModeAction->setCheckable(true);
+	rawModeAction->setChecked(settings.value("rawMode", false).toBool());
+	connect(rawModeAction, SIGNAL(toggled(bool)), this, SLOT(rawModeChanged(bool)));
+
+	calibrationAction = new QAction(tr("Calibration..."), this);
+	calibrationAction->setStatusTip(tr("Sets emissivity, reflected temperature and sensor offset"));
+	connect(calibrationAction, SIGNAL(triggered()), this, SLOT(editCalibration()));
+
+	QActionGroup *filterGroup = new QActionGroup(this);
+	int preset = qBound(0, settings.value("filterPreset", 0).toInt(), FILTER_PRESET_COUNT - 1);
+	for (int i = 0; i < FILTER_PRESET_COUNT; ++i)
+	{
+		QAction *a = new QAction(ThermCam::tr(filterPresets[i].name), filterGroup);
+		a->setCheckable(true);
+		a->setChecked(i == preset);
+		a->setData(i);
+		filterActions.append(a);
+	}
+	connect(filterGroup, SIGNAL(triggered(QAction *)), this, SLOT(filterPresetChanged()));
+
+	QActionGroup *samplingGroup = new QActionGroup(this);
+	int samples = settings.value("samplesPerPoint", 1).toInt();
+	const int sampleCounts[] = { 1, 4, 8, 16 };
+	for (int i = 0; i < 4; ++i)
+	{
+		QAction *a = new QAction(tr("%n reading(s)", "", sampleCounts[i]), samplingGroup);
+		a->setCheckable(true);
+		a->setChecked(sampleCounts[i] == samples);
+		a->setData(sampleCounts[i]);
+		samplingActions.append(a);
+	}
+	if (!samplingGroup->checkedAction())
+		samplingActions[0]->setChecked(true);
+	connect(samplingGroup, SIGNAL(triggered(QAction *)), this, SLOT(samplingChanged()));
+
+	trimmedMeanAction = new QAction(tr("Trimmed mean instead of median"), this);
+	trimmedMeanAction->setStatusTip(tr("Averages the middle half of readings instead of taking the middle one"));
+	trimmedMeanAction->setCheckable(true);
+	trimmedMeanAction->setChecked(settings.value("trimmedMean", false).toBool());
+	connect(trimmedMeanAction, SIGNAL(toggled(bool)), this, SLOT(samplingChanged()));
+
+	noiseMapAction = new QAction(tr("Noise map"), this);
+	noiseMapAction->setStatusTip(tr("Shows standard deviation of readings taken at each point"));
+	noiseMapAction->setCheckable(true);
+	connect(noiseMapAction, SIGNAL(toggled(bool)), this, SLOT(noiseMapToggled(bool)));
+
+	QActionGroup *ambientGroup = new QActionGroup(this);
+	int ambientInterval = settings.value("ambientInterval", 1).toInt();
+	const int intervals[] = { 0, 1, 5, 20 };
+	const char *intervalNames[] = { QT_TR_NOOP("Never"), QT_TR_NOOP("Every row"), QT_TR_NOOP("Every 5 rows"),
+			QT_TR_NOOP("Every 20 rows") };
+	for (int i = 0; i < 4; ++i)
+	{
+		QAction *a = new QAction(tr(intervalNames[i]), ambientGroup);
+		a->setCheckable(true);
+		a->setChecked(intervals[i] == ambientInterval);
+		a->setData(intervals[i]);
+		ambientActions.append(a);
+	}
+	if (!ambientGroup->checkedAction())
+		ambientActions[1]->setChecked(true);
+	connect(ambientGroup, SIGNAL(triggered(QAction *)), this, SLOT(ambientIntervalChanged()));
+
+	driftAction = new QAction(tr("Correct sensor drift..."), this);
+	driftAction->setStatusTip(tr("Compensates for warming up of the sensor, using ambient temperature read during scan"));
+	connect(driftAction, SIGNAL(triggered()), this, SLOT(correctDrift()));
+
+	addScannerAction = new QAction(tr("Add scanner..."), this);
+	addScannerAction->setStatusTip(tr("Adds a device which scans the same area in parallel, in its own tab"));
+	connect(addScannerAction, SIGNAL(triggered()), this, SLOT(addScanner()));
+
+	removeScannerAction = new QAction(tr("Remove scanner"), this);
+	removeScannerAction->setStatusTip(tr("Removes the scanner shown in the current tab"));
+	connect(removeScannerAction, SIGNAL(triggered()), this, SLOT(removeScanner()));
+
+	findDevicesAction = new QAction(QIcon::fromTheme("edit-find"), tr("Find devices"), this);
+	findDevicesAction->setStatusTip(tr("Asks all serial ports whether QThermCam is connected to them"));
+	connect(findDevicesAction, SIGNAL(triggered()), this, SLOT(findDevices()));
+
+	daemonAction = new QAction(tr("Use qthermcamd"), this);
+	daemonAction->setStatusTip(tr("Connects to qthermcamd instead of the device, scans started by its other clients are shown too"));
+	daemonAction->setCheckable(true);
+	daemonAction->setChecked(settings.value("useDaemon", false).toBool());
+	connect(daemonAction, SIGNAL(toggled(bool)), this, SLOT(saveSettingsLater()));
+
+	filterBenchmarkAction = new QAction(tr("Measure settle time"), this);
+	filterBenchmarkAction->setStatusTip(tr("Measures how long sensor needs after move with each filter preset"));
+	connect(filterBenchmarkAction, SIGNAL(triggered()), this, SLOT(benchmarkFilters()));
 
 	// application internal actions
 	clearLogAction = new QAction(QIcon::fromTheme("edit-clear"), tr("Clear log"), this);
 	connect(clearLogAction, SIGNAL(triggered()), this, SLOT(clearLog()));
 
+	uint levels = settings.value("logLevels", 0xf).toUInt();
+	const char *levelNames[] = { QT_TR_NOOP("Debug"), QT_TR_NOOP("Info"), QT_TR_NOOP("Warnings"), QT_TR_NOOP("Errors") };
+	for (int i = 0; i < 4; ++i)
+	{
+		logLevelActions[i] = new QAction(tr(levelNames[i]), this);
+		logLevelActions[i]->setCheckable(true);
+		logLevelActions[i]->setChecked(levels & (1 << i));
+		connect(logLevelActions[i], SIGNAL(toggled(bool)), this, SLOT(logLevelsChanged()));
+	}
+
+	uint categories = settings.value("logCategories", 0xf).toUInt();
+	const char *categoryNames[] = { QT_TR_NOOP("Serial port"), QT_TR_NOOP("Scanning"), QT_TR_NOOP("Rendering"),
+			QT_TR_NOOP("Files") };
+	for (int i = 0; i < 4; ++i)
+	{
+		logCategoryActions[i] = new QAction(tr(categoryNames[i]), this);
+		logCategoryActions[i]->setCheckable(true);
+		logCategoryActions[i]->setChecked(categories & (1 << i));
+		connect(logCategoryActions[i], SIGNAL(toggled(bool)), this, SLOT(logLevelsChanged()));
+	}
+
 	// file actions
 	loadAction = new QAction(QIcon::fromTheme("document-open"), tr("Load file"), this);
 	loadAction->setStatusTip(tr("Loads previously saved data file"));
@@ -198,6 +449,10 @@ void MainWin::createActions()
 	saveImageAction->setStatusTip(tr("Saves currently scanned data file as image"));
 	connect(saveImageAction, SIGNAL(triggered()), this, SLOT(saveImage()));
 
+	appendSeriesAction = new QAction(tr("Append to series"), this);
+	appendSeriesAction->setStatusTip(tr("Adds current image as the next frame of a series file"));
+	connect(appendSeriesAction, SIGNAL(triggered()), this, SLOT(appendToSeries()));
+
 	exitAction = new QAction(QIcon::fromTheme("window-close"), tr("E&xit"), this);
 	connect(exitAction, SIGNAL(triggered()), qApp, SLOT(closeAllWindows()));
 
@@ -214,20 +469,57 @@ void MainWin::createMenus()
 	fileMenu->addAction(loadAction);
 	fileMenu->addAction(saveAction);
 	fileMenu->addAction(saveImageAction);
-	fileMenu->addSeparator();
-	fileMenu->addAction(clearLogAction);
+	fileMenu->addAction(appendSeriesAction);
 	fileMenu->addSeparator();
 	fileMenu->addAction(exitAction);
 
 	deviceMenu = menuBar()->addMenu(tr("&Device"));
 	deviceMenu->addAction(connectAction);
 	deviceMenu->addAction(disconnectAction);
+	deviceMenu->addAction(findDevicesAction);
+	deviceMenu->addAction(daemonAction);
 	deviceMenu->addSeparator();
 	deviceMenu->addAction(scanAction);
 	deviceMenu->addAction(stopScanAction);
+	deviceMenu->addAction(resumeScanAction);
+	deviceMenu->addSeparator();
+	deviceMenu->addAction(addScannerAction);
+	deviceMenu->addAction(removeScannerAction);
+	deviceMenu->addSeparator();
+	deviceMenu->addAction(sweepAction);
+	deviceMenu->addAction(rawModeAction);
+	deviceMenu->addAction(calibrationAction);
+	filterMenu = deviceMenu->addMenu(tr("Sensor filter"));
+	for (int i = 0; i < filterActions.size(); ++i)
+		filterMenu->addAction(filterActions[i]);
+	filterMenu->addSeparator();
+	filterMenu->addAction(filterBenchmarkAction);
+	samplingMenu = deviceMenu->addMenu(tr("Readings per point"));
+	for (int i = 0; i < samplingActions.size(); ++i)
+		samplingMenu->addAction(samplingActions[i]);
+	samplingMenu->addSeparator();
+	samplingMenu->addAction(trimmedMeanAction);
+	ambientMenu = deviceMenu->addMenu(tr("Read ambient temperature"));
+	for (int i = 0; i < ambientActions.size(); ++i)
+		ambientMenu->addAction(ambientActions[i]);
+
+	logMenu = menuBar()->addMenu(tr("&Log"));
+	logMenu->addAction(clearLogAction);
+	logMenu->addSeparator();
+	for (int i = 0; i < 4; ++i)
+		logMenu->addAction(logLevelActions[i]);
+	logMenu->addSeparator();
+	for (int i = 0; i < 4; ++i)
+		logMenu->addAction(logCategoryActions[i]);
 
 	menuBar()->addSeparator();
 
+	viewMenu = menuBar()->addMenu(tr("&View"));
+	viewMenu->addAction(noiseMapAction);
+
+	toolsMenu = menuBar()->addMenu(tr("&Tools"));
+	toolsMenu->addAction(driftAction);
+
 	helpMenu = menuBar()->addMenu(tr("&Help"));
 	helpMenu->addAction(aboutAction);
 	helpMenu->addAction(aboutQtAction);
@@ -243,6 +535,7 @@ void MainWin::createToolBar()
 	deviceToolbar->addSeparator();
 	deviceToolbar->addAction(scanAction);
 	deviceToolbar->addAction(stopScanAction);
+	deviceToolbar->addAction(resumeScanAction);
 
 	fileToolbar = addToolBar(tr("File"));
 	fileToolbar->setObjectName("file_toolbar");
@@ -257,6 +550,25 @@ void MainWin::createToolBar()
 void MainWin::createStatusBar()
 {
 	statusBar()->showMessage(tr("Ready"));
+
+	scanRate = new QLabel(statusBar());
+	scanRate->hide();
+	statusBar()->addPermanentWidget(scanRate);
+
+	scanProgress = new QProgressBar(statusBar());
+	scanProgress->setMaximumWidth(150);
+	scanProgress->hide();
+	statusBar()->addPermanentWidget(scanProgress);
+
+	fileProgress = new QProgressBar(statusBar());
+	fileProgress->setRange(0, 100);
+	fileProgress->setMaximumWidth(150);
+	fileProgress->hide();
+	statusBar()->addPermanentWidget(fileProgress);
+
+	fileCancel = new QPushButton(tr("Cancel"), statusBar());
+	fileCancel->hide();
+	statusBar()->addPermanentWidget(fileCancel);
 }
 
 void MainWin::about()
@@ -264,25 +576,49 @@ void MainWin::about()
 	// TODO: implement
 }
 
+void MainWin::logDebug(const QString &msg)
+{
+	logView->append(LevelDebug, msg);
+	updateScheduler->markDirty(UpdateScheduler::Log);
+}
+
 void MainWin::log(const QString &txt)
 {
-	textEdit->append(txt);
+	logView->append(LevelInfo, txt);
+	updateScheduler->markDirty(UpdateScheduler::Log);
+}
+
+void MainWin::logWarning(const QString &msg)
+{
+	logView->append(LevelWarning, msg);
+	updateScheduler->markDirty(UpdateScheduler::Log);
 }
 
 void MainWin::doConnect()
 {
+	if (daemonAction->isChecked())
+	{
+		QString name = QSettings().value("daemonSocket", "qthermcamd").toString();
+		TC_LOG(CategorySerial, LevelInfo, log(tr("%1: connecting to qthermcamd").arg(name)));
+		connectAction->setEnabled(false);
+		daemonAction->setEnabled(false);
+		daemon->connectToDaemon(name);
+		return;
+	}
+
 	QString path = pathEdit->text();
 
-	log(tr("%1: connecting").arg(path));
+	TC_LOG(CategorySerial, LevelInfo, log(tr("%1: connecting").arg(path)));
 
 	if (!thermCam->doConnect(path))
 		return;
 
-	log(tr("%1: connected").arg(path));
+	TC_LOG(CategorySerial, LevelInfo, log(tr("%1: connected").arg(path)));
 	statusBar()->showMessage(tr("connected"));
 
 	connectAction->setEnabled(false);
 	disconnectAction->setEnabled(true);
+	daemonAction->setEnabled(false);
 
 	pathEdit->setEnabled(false);
 
@@ -290,29 +626,163 @@ void MainWin::doConnect()
 	maxX->setEnabled(true);
 	minY->setEnabled(true);
 	maxY->setEnabled(true);
+
+	for (int i = 0; i < heads.size(); ++i)
+		heads[i]->connectDevice();
 }
 
 void MainWin::doDisconnect()
 {
+	// user wants it disconnected, don't connect to the next device plugged in
+	autoConnect = false;
+	if (daemon->isConnected())
+	{
+		// scan goes on in the daemon, others may be watching it
+		daemon->disconnectFromDaemon();
+		return;
+	}
 	thermCam->doDisconnect();
+	for (int i = 0; i < heads.size(); ++i)
+		heads[i]->disconnectDevice();
 
 	disconnectAction->setEnabled(false);
 	connectAction->setEnabled(true);
+	daemonAction->setEnabled(true);
 
 	pathEdit->setEnabled(true);
 	scanAction->setEnabled(false);
+	updateResumeAction();
 	minX->setEnabled(false);
 	maxX->setEnabled(false);
 	minY->setEnabled(false);
 	maxY->setEnabled(false);
 
-	log(tr("%1: disconnected").arg(pathEdit->text()));
+	TC_LOG(CategorySerial, LevelInfo, log(tr("%1: disconnected").arg(pathEdit->text())));
 	statusBar()->showMessage(tr("disconnected"));
 }
 
+void MainWin::daemonConnected()
+{
+	statusBar()->showMessage(tr("connected to qthermcamd"));
+
+	disconnectAction->setEnabled(true);
+	pathEdit->setEnabled(false);
+
+	minX->setEnabled(true);
+	maxX->setEnabled(true);
+	minY->setEnabled(true);
+	maxY->setEnabled(true);
+}
+
+/* also when connecting failed */
+void MainWin::daemonDisconnected()
+{
+	if (stopScanAction->isEnabled())
+		daemonScanFinished(false);
+
+	disconnectAction->setEnabled(false);
+	connectAction->setEnabled(true);
+	daemonAction->setEnabled(true);
+
+	pathEdit->setEnabled(true);
+	scanAction->setEnabled(false);
+	minX->setEnabled(false);
+	maxX->setEnabled(false);
+	minY->setEnabled(false);
+	maxY->setEnabled(false);
+
+	statusBar()->showMessage(tr("disconnected"));
+}
+
+/* scan of any client of the daemon, including queued jobs */
+void MainWin::daemonScanStarted(int xmin, int xmax, int ymin, int ymax)
+{
+	closeSeries();
+	tempView->setBuffer(xmin, xmax, ymin, ymax);
+	tempView->setFileMetadata("scanStarted", QDateTime::currentDateTime().toString(Qt::ISODate));
+	tempView->setFileMetadata("device", daemon->path());
+	tempView->setMinimumWidth(xmax - xmin + 1);
+	updateTempScale();
+
+	startScanUi();
+	startProgress(ymax - ymin + 1);
+}
+
+void MainWin::daemonScanJoined(const ThermFrame &frame, int rowsDone)
+{
+	closeSeries();
+	tempView->setFrame(frame);
+	tempView->setMinimumWidth(frame.width());
+	updateTempScale();
+	updateScheduler->markDirty(UpdateScheduler::View | UpdateScheduler::Legend);
+
+	startScanUi();
+	startProgress(frame.height());
+	this->rowsDone = rowsDone;
+	scanProgress->setValue(qMin(rowsDone, rowsTotal));
+}
+
+void MainWin::daemonRowScanned(int rowsDone, int rowsTotal)
+{
+	// only rows seen by this client count into the rate
+	pointsDone += tempView->bufferWidth();
+	this->rowsDone = rowsDone;
+	this->rowsTotal = rowsTotal;
+	scanProgress->setRange(0, rowsTotal);
+	scanProgress->setValue(qMin(rowsDone, rowsTotal));
+
+	qint64 ms = scanTimer.elapsed();
+	if (ms > 0)
+		scanRate->setText(tr("%1 / %2 rows, %3 points/s").arg(rowsDone).arg(rowsTotal)
+				.arg(pointsDone * 1000.0 / ms, 0, 'f', 1));
+}
+
+void MainWin::daemonScanFinished(bool complete)
+{
+	if (!complete && rowsTotal > 0)
+		TC_LOG(CategoryScan, LevelWarning, logWarning(tr("Scan was not completed")));
+	scanningStopped();
+}
+
+void MainWin::connectionLost()
+{
+	statusBar()->showMessage(tr("connection lost, waiting for device"));
+	updateResumeAction();
+}
+
+void MainWin::reconnected()
+{
+	statusBar()->showMessage(tr("reconnected"));
+	updateResumeAction();
+}
+
 void MainWin::clearLog()
 {
-	textEdit->clear();
+	logView->clear();
+}
+
+void MainWin::logLevelsChanged()
+{
+	applyLogFilter();
+	saveSettingsLater();
+}
+
+void MainWin::applyLogFilter()
+{
+	uint levels = 0, categories = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (logLevelActions[i]->isChecked())
+			levels |= 1 << i;
+		if (logCategoryActions[i]->isChecked())
+			categories |= 1 << i;
+	}
+	logView->setLevelsMask(levels);
+
+	// messages nobody will see are not even formatted
+	if (logView->writesToFile())
+		levels = (1 << LevelCount) - 1;
+	setLogMask(categories, levels);
 }
 
 void MainWin::resetStatusBar()
@@ -355,11 +825,430 @@ bool MainWin::eventFilter(QObject *obj, QEvent *_event)
 
 void MainWin::scanImage()
 {
+	if (daemon->isConnected())
+	{
+		QJsonObject config;
+		config["xmin"] = minX->value();
+		config["xmax"] = maxX->value();
+		config["ymin"] = minY->value();
+		config["ymax"] = maxY->value();
+		config["mode"] = QString(sweepAction->isChecked() ? "sweep" : "step");
+		config["raw"] = rawModeAction->isChecked();
+		for (int i = 0; i < filterActions.size(); ++i)
+			if (filterActions[i]->isChecked())
+				config["filter"] = i;
+		for (int i = 0; i < samplingActions.size(); ++i)
+			if (samplingActions[i]->isChecked())
+				config["samples"] = samplingActions[i]->data().toInt();
+		config["trimmed"] = trimmedMeanAction->isChecked();
+		for (int i = 0; i < ambientActions.size(); ++i)
+			if (ambientActions[i]->isChecked())
+				config["ambientInterval"] = ambientActions[i]->data().toInt();
+		Calibration c = Calibration::fromSettings();
+		config["emissivity"] = c.emissivity();
+		config["reflected"] = c.reflected();
+		config["offset"] = c.offset();
+
+		// UI is switched when the daemon announces the scan
+		scanAction->setEnabled(false);
+		daemon->scan(config);
+		return;
+	}
+
 	QSize sz = QSize(maxX->value() - minX->value() + 1, maxY->value() - minY->value() + 1);
 
+	closeSeries();
 	tempView->setBuffer(minX->value(), maxX->value(), minY->value(), maxY->value());
+	tempView->setFileMetadata("scanStarted", QDateTime::currentDateTime().toString(Qt::ISODate));
+	tempView->setFileMetadata("device", pathEdit->text());
+	tempView->setFileMetadata("scanMode", sweepAction->isChecked() ? "sweep" : "step");
+	for (int i = 0; i < samplingActions.size(); ++i)
+		if (samplingActions[i]->isChecked() && samplingActions[i]->data().toInt() > 1)
+			tempView->setFileMetadata("readingsPerPoint", QString("%1 (%2)").arg(samplingActions[i]->data().toInt())
+					.arg(trimmedMeanAction->isChecked() ? "trimmed mean" : "median"));
+	Calibration c = Calibration::fromSettings();
+	tempView->setFileMetadata("calibration", QString("emissivity=%1 reflected=%2 offset=%3").arg(c.emissivity())
+			.arg(c.reflected()).arg(c.offset()));
 	tempView->setMinimumWidth(sz.width());
+	updateTempScale();
+
+	journal->start(minX->value(), maxX->value(), minY->value(), maxY->value(), pathEdit->text(),
+			QDateTime::currentDateTime().toMSecsSinceEpoch());
+	resumeRow = -1;
+
+	startScanUi();
+	thermCam->scanImage(minX->value(), maxX->value(), minY->value(), maxY->value());
+
+	// all heads scan at the same time, their I/O is driven by this event loop;
+	// each one covers as much of the field of view as its servos can reach
+	int rows = sz.height();
+	for (int i = 0; i < heads.size(); ++i)
+	{
+		ThermCam *cam = heads[i]->thermCam();
+		if (!cam->connected() || cam->scanInProgress())
+			continue;
+		int xmin = minX->value(), xmax = maxX->value(), ymin = minY->value(), ymax = maxY->value();
+		if (!heads[i]->clamp(xmin, xmax, ymin, ymax))
+		{
+			logWarning(tr("%1: field of view is out of reach of the device, it won't scan").arg(heads[i]->path()));
+			continue;
+		}
+		heads[i]->startScan(xmin, xmax, ymin, ymax);
+		heads[i]->view()->setFileMetadata("scanMode", sweepAction->isChecked() ? "sweep" : "step");
+		rows += ymax - ymin + 1;
+	}
+	startProgress(rows);
+}
+
+void MainWin::stopScanning()
+{
+	if (daemon->isConnected())
+		daemon->stop();
+
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < cams.size(); ++i)
+		if (cams[i]->scanInProgress())
+			cams[i]->stopScanning();
+}
+
+QList<ThermCam *> MainWin::thermCams()
+{
+	QList<ThermCam *> cams;
+	cams.append(thermCam);
+	for (int i = 0; i < heads.size(); ++i)
+		cams.append(heads[i]->thermCam());
+	return cams;
+}
+
+/* view whose image is saved, main one if it's not one of heads */
+TempView *MainWin::currentView()
+{
+	for (int i = 0; i < heads.size(); ++i)
+		if (views->currentWidget() == heads[i]->view())
+			return heads[i]->view();
+	return tempView;
+}
+
+/* applies device settings selected in menus */
+void MainWin::configureThermCam(ThermCam *cam)
+{
+	QSettings settings;
+	// rate is limited by the firmware to 5..1000 ms per degree
+	int rate = qBound(5, settings.value("sweepRate", 20).toInt(), 1000);
+	int lag = settings.value("sweepLag", 30).toInt();
+	cam->setScanMode(sweepAction->isChecked() ? ThermCam::ScanSweep : ThermCam::ScanStep, rate, lag);
+	cam->setRawMode(rawModeAction->isChecked());
+	cam->setCalibration(Calibration::fromSettings());
+	for (int i = 0; i < filterActions.size(); ++i)
+		if (filterActions[i]->isChecked())
+			cam->setFilter(filterPresets[i]);
+	for (int i = 0; i < samplingActions.size(); ++i)
+		if (samplingActions[i]->isChecked())
+			cam->setSampling(samplingActions[i]->data().toInt(), trimmedMeanAction->isChecked());
+	for (int i = 0; i < ambientActions.size(); ++i)
+		if (ambientActions[i]->isChecked())
+			cam->setAmbientInterval(ambientActions[i]->data().toInt());
+}
+
+ScanHead *MainWin::addHead(const QString &path)
+{
+	ScanHead *head = new ScanHead(path, this);
+	configureThermCam(head->thermCam());
+	head->view()->setRangeMode((TempView::RangeMode)rangeMode->currentIndex());
+	views->addTab(head->view(), path);
+
+	connect(head, SIGNAL(changed()), this, SLOT(headChanged()));
+	connect(head->thermCam(), SIGNAL(scanningStopped()), this, SLOT(scanningStopped()));
+	connect(head->thermCam(), SIGNAL(rowScanned(int, const QVector<float> &)), this, SLOT(rowDone(int, const QVector<float> &)));
+	connect(head, SIGNAL(debug(const QString &)), this, SLOT(logDebug(const QString &)));
+	connect(head, SIGNAL(info(const QString &)), this, SLOT(log(const QString &)));
+	connect(head, SIGNAL(warning(const QString &)), this, SLOT(logWarning(const QString &)));
+	connect(head, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
+
+	heads.append(head);
+	return head;
+}
+
+void MainWin::addScanner()
+{
+	bool ok;
+	QString path = QInputDialog::getText(this, tr("Add scanner"), tr("Device path:"), QLineEdit::Normal,
+			"/dev/ttyACM1", &ok);
+	if (!ok || path.isEmpty())
+		return;
+
+	if (path == pathEdit->text())
+	{
+		logError(tr("%1 is the main scanner").arg(path));
+		return;
+	}
+	for (int i = 0; i < heads.size(); ++i)
+		if (heads[i]->path() == path)
+		{
+			logError(tr("Scanner %1 is already added").arg(path));
+			return;
+		}
+
+	ScanHead *head = addHead(path);
+	views->setCurrentWidget(head->view());
+	if (thermCam->connected())
+		head->connectDevice();
+	saveSettingsLater();
+}
+
+void MainWin::removeScanner()
+{
+	for (int i = 0; i < heads.size(); ++i)
+	{
+		ScanHead *head = heads[i];
+		if (views->currentWidget() != head->view())
+			continue;
+
+		if (head->thermCam()->scanInProgress())
+		{
+			logError(tr("Scanner %1 is scanning").arg(head->path()));
+			return;
+		}
+
+		head->disconnectDevice();
+		heads.removeAt(i);
+		views->removeTab(views->indexOf(head->view()));
+		delete head->view();
+		delete head;
+		saveSettingsLater();
+		return;
+	}
+	logError(tr("Main scanner can't be removed, select tab of other one"));
+}
+
+void MainWin::startProgress(int rows)
+{
+	rowsTotal = rows;
+	rowsDone = 0;
+	pointsDone = 0;
+	scanTimer.start();
+	scanProgress->setRange(0, rowsTotal);
+	scanProgress->setValue(0);
+	scanProgress->show();
+	scanRate->clear();
+	scanRate->show();
+}
+
+void MainWin::rowDone(int, const QVector<float> &temps)
+{
+	rowsDone++;
+	pointsDone += temps.size();
+	scanProgress->setValue(qMin(rowsDone, rowsTotal));
+
+	qint64 ms = scanTimer.elapsed();
+	if (ms > 0)
+		scanRate->setText(tr("%1 / %2 rows, %3 points/s").arg(rowsDone).arg(rowsTotal)
+				.arg(pointsDone * 1000.0 / ms, 0, 'f', 1));
+}
+
+void MainWin::findDevices()
+{
+	autoConnect = !thermCam->connected() && !thermCam->reconnecting() && !daemonAction->isChecked();
+	deviceProbe->probeAll();
+}
+
+void MainWin::deviceFound(const QString &path, int xmin, int xmax, int ymin, int ymax)
+{
+	TC_LOG(CategorySerial, LevelInfo, log(tr("%1: QThermCam found, x %2 - %3, y %4 - %5").arg(path)
+			.arg(xmin).arg(xmax).arg(ymin).arg(ymax)));
+
+	// additional scanner plugged in after the main one was connected
+	for (int i = 0; i < heads.size(); ++i)
+		if (heads[i]->path() == path)
+		{
+			ThermCam *cam = heads[i]->thermCam();
+			if (thermCam->connected() && !cam->connected() && !cam->reconnecting())
+				heads[i]->connectDevice();
+			return;
+		}
+
+	if (autoConnect && !thermCam->connected() && !thermCam->reconnecting())
+	{
+		pathEdit->setText(path);
+		doConnect();
+		autoConnect = !thermCam->connected();
+	}
+}
+
+void MainWin::deviceRemoved(const QString &path)
+{
+	// ThermCam notices it by itself and waits for the device
+	TC_LOG(CategorySerial, LevelDebug, logDebug(tr("%1: device node removed").arg(path)));
+}
+
+void MainWin::headChanged()
+{
+	updateScheduler->markDirty(UpdateScheduler::View);
+}
+
+void MainWin::scanModeChanged()
+{
+	QSettings settings;
+	// rate is limited by the firmware to 5..1000 ms per degree
+	int rate = qBound(5, settings.value("sweepRate", 20).toInt(), 1000);
+	int lag = settings.value("sweepLag", 30).toInt();
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < cams.size(); ++i)
+		cams[i]->setScanMode(sweepAction->isChecked() ? ThermCam::ScanSweep : ThermCam::ScanStep, rate, lag);
+}
+
+void MainWin::rawModeChanged(bool raw)
+{
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < cams.size(); ++i)
+		cams[i]->setRawMode(raw);
+	saveSettingsLater();
+}
+
+void MainWin::editCalibration()
+{
+	Calibration c = Calibration::fromSettings();
+
+	QDialog dialog(this);
+	dialog.setWindowTitle(tr("Calibration"));
+	QFormLayout *layout = new QFormLayout(&dialog);
+
+	QDoubleSpinBox *emissivity = new QDoubleSpinBox(&dialog);
+	emissivity->setRange(0.01, 1.0);
+	emissivity->setSingleStep(0.01);
+	emissivity->setValue(c.emissivity());
+	layout->addRow(tr("Emissivity"), emissivity);
+
+	QDoubleSpinBox *reflected = new QDoubleSpinBox(&dialog);
+	reflected->setRange(-70, 380);
+	reflected->setSuffix(tr(" C"));
+	reflected->setValue(c.reflected());
+	layout->addRow(tr("Reflected temperature"), reflected);
+
+	QDoubleSpinBox *offset = new QDoubleSpinBox(&dialog);
+	offset->setRange(-20, 20);
+	offset->setSingleStep(0.1);
+	offset->setSuffix(tr(" C"));
+	offset->setValue(c.offset());
+	layout->addRow(tr("Sensor offset"), offset);
+
+	QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal, &dialog);
+	connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+	connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+	layout->addRow(buttons);
+
+	if (dialog.exec() != QDialog::Accepted)
+		return;
+
+	c = Calibration(emissivity->value(), reflected->value(), offset->value());
+	c.saveSettings();
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < cams.size(); ++i)
+		cams[i]->setCalibration(c);
+	log(tr("Calibration: emissivity %1, reflected temperature %2 C, offset %3 C").arg(c.emissivity())
+			.arg(c.reflected()).arg(c.offset()));
+}
+
+void MainWin::filterPresetChanged()
+{
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < filterActions.size(); ++i)
+		if (filterActions[i]->isChecked())
+			for (int j = 0; j < cams.size(); ++j)
+				cams[j]->setFilter(filterPresets[i]);
+}
+
+/* Runs settle time measurement for every preset, one after another, then
+ * restores the selected one.
+ */
+void MainWin::benchmarkFilters()
+{
+	if (!thermCam->connected() || thermCam->scanInProgress() || benchmarkPreset != -1)
+		return;
+
+	log(tr("Measuring settle time between x = %1 and x = %2").arg(minX->value()).arg(maxX->value()));
+	benchmarkPreset = 0;
+	thermCam->setFilter(filterPresets[benchmarkPreset]);
+	thermCam->sendCommand_settleBenchmark(minX->value(), maxX->value());
+}
+
+void MainWin::settleMeasured(int ms, float temp)
+{
+	if (benchmarkPreset == -1)
+		return;
+
+	const FilterPreset &p = filterPresets[benchmarkPreset];
+	if (ms < 0)
+		logWarning(tr("%1: readings did not settle").arg(ThermCam::tr(p.name)));
+	else
+		log(tr("%1: settled in %2 ms at %3 C (configured delay: %4 ms)").arg(ThermCam::tr(p.name)).arg(ms)
+				.arg(temp, 0, 'f', 2).arg(p.settleMs));
+
+	if (++benchmarkPreset < FILTER_PRESET_COUNT)
+	{
+		thermCam->setFilter(filterPresets[benchmarkPreset]);
+		thermCam->sendCommand_settleBenchmark(minX->value(), maxX->value());
+		return;
+	}
+
+	benchmarkPreset = -1;
+	filterPresetChanged();
+}
+
+void MainWin::samplingChanged()
+{
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < samplingActions.size(); ++i)
+		if (samplingActions[i]->isChecked())
+			for (int j = 0; j < cams.size(); ++j)
+				cams[j]->setSampling(samplingActions[i]->data().toInt(), trimmedMeanAction->isChecked());
+}
+
+void MainWin::ambientIntervalChanged()
+{
+	QList<ThermCam *> cams = thermCams();
+	for (int i = 0; i < ambientActions.size(); ++i)
+		if (ambientActions[i]->isChecked())
+			for (int j = 0; j < cams.size(); ++j)
+				cams[j]->setAmbientInterval(ambientActions[i]->data().toInt());
+}
+
+void MainWin::correctDrift()
+{
+	if (thermCam->scanInProgress())
+	{
+		logError(tr("Drift can be corrected after the scan"));
+		return;
+	}
+
+	ThermFrame frame = tempView->frame();
+	if (Drift::isCorrected(frame) && QMessageBox::question(this, tr("Correct sensor drift"),
+			tr("Drift of this image was already corrected. Correct it again?"),
+			QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+		return;
+
+	QSettings settings;
+	bool ok;
+	double k = QInputDialog::getDouble(this, tr("Correct sensor drift"),
+			tr("Change of reading per degree of sensor warming:"), settings.value("driftCoefficient", 1.0).toDouble(),
+			0, 5, 2, &ok);
+	if (!ok)
+		return;
+	settings.setValue("driftCoefficient", k);
+
+	if (!Drift::correct(frame, k))
+	{
+		logError(tr("Image has less than 2 ambient temperature readings, drift can't be corrected"));
+		return;
+	}
+
+	tempView->setFrame(frame);
+	updateTempScale();
+	log(tr("Sensor drift corrected"));
+}
 
+void MainWin::startScanUi()
+{
 	minX->setEnabled(false);
 	maxX->setEnabled(false);
 	minY->setEnabled(false);
@@ -370,14 +1259,78 @@ void MainWin::scanImage()
 	scanAction->setEnabled(false);
 	stopScanAction->setEnabled(true);
 	disconnectAction->setEnabled(false);
+	resumeScanAction->setEnabled(false);
 
 	saveImageAction->setEnabled(true);
+	appendSeriesAction->setEnabled(true);
+}
 
-	thermCam->scanImage(minX->value(), maxX->value(), minY->value(), maxY->value());
+void MainWin::resumeScan()
+{
+	ThermFrame frame;
+	if (!journal->recover(frame, resumeRow))
+	{
+		logError(tr("Interrupted scan cannot be resumed"));
+		resumeRow = -1;
+		updateResumeAction();
+		return;
+	}
+
+	// journal is reopened for appending only when the scan will really go on
+	if (frame.xmin < minX->minimum() || frame.xmax > maxX->maximum() ||
+			frame.ymin < minY->minimum() || frame.ymax > maxY->maximum())
+	{
+		logError(tr("Interrupted scan does not fit in the field of view of this device"));
+		return;
+	}
+
+	if (!journal->resume())
+	{
+		logError(tr("Interrupted scan cannot be resumed"));
+		resumeRow = -1;
+		updateResumeAction();
+		return;
+	}
+
+	closeSeries();
+	tempView->setFrame(frame);
+	tempView->setMinimumWidth(frame.width());
+	updateTempScale();
+
+	TC_LOG(CategoryScan, LevelInfo, log(tr("Resuming scan from row %1").arg(resumeRow)));
+	startScanUi();
+	startProgress(frame.ymax - resumeRow + 1);
+	thermCam->scanImage(frame.xmin, frame.xmax, frame.ymin, frame.ymax, resumeRow);
+}
+
+/* looks for scan which was interrupted and can be resumed */
+void MainWin::checkJournal()
+{
+	ThermFrame frame;
+	journal->sync();
+	if (!journal->recover(frame, resumeRow))
+	{
+		resumeRow = -1;
+		journal->discard();
+	}
+	updateResumeAction();
+}
+
+void MainWin::updateResumeAction()
+{
+	resumeScanAction->setEnabled(resumeRow >= 0 && thermCam->connected() && !thermCam->scanInProgress() &&
+			scanAction->isEnabled());
 }
 
 void MainWin::scanningStopped()
 {
+	// heads finish on their own time
+	for (int i = 0; i < heads.size(); ++i)
+		if (heads[i]->thermCam()->scanInProgress())
+			return;
+	if (thermCam && thermCam->scanInProgress())
+		return;
+
 	disconnectAction->setEnabled(true);
 	stopScanAction->setEnabled(false);
 	scanAction->setEnabled(true);
@@ -385,6 +1338,19 @@ void MainWin::scanningStopped()
 	if (tempView)
 		tempView->setMinimumWidth(0);
 
+	if (minX && rowsTotal > 0)
+	{
+		scanProgress->hide();
+		rowsTotal = 0;
+		TC_LOG(CategoryScan, LevelInfo, log(tr("Scan finished: %1").arg(scanRate->text())));
+	}
+
+	if (updateScheduler)
+		updateScheduler->flush();
+
+	if (journal)
+		checkJournal();
+
 	if (minX)
 	{
 		minX->setEnabled(true);
@@ -396,7 +1362,7 @@ void MainWin::scanningStopped()
 
 void MainWin::splitterMoved(int, int)
 {
-	tempView->refreshView();
+	currentView()->refreshView();
 	saveSettingsLater();
 }
 
@@ -407,8 +1373,8 @@ void MainWin::saveImage()
 		imageFileDialog = new QFileDialog(this, tr("Choose file name"));
 		imageFileDialog->setNameFilter(tr("All image files (*.png *.jpg *.bmp *.ppm *.tiff *.xbm *.xpm)"));
 	}
-	tempView->highlightPoint(-1, -1);
-	tempView->refreshView();
+	currentView()->highlightPoint(-1, -1);
+	currentView()->refreshView();
 	imageFileDialog->open(this, SLOT(imageFileSelected(const QString &)));
 }
 
@@ -419,8 +1385,8 @@ void MainWin::imageFileSelected(const QString &file_)
 	if (s != "png" && s != "jpg" && s != "bmp" && s != "ppm" && s != "tiff" && s != "xbm" && s != "xpm")
 		file += ".png";
 
-	if (tempView->pixmap()->save(file))
-		log(tr("File %1 saved").arg(file));
+	if (currentView()->pixmap()->save(file))
+		TC_LOG(CategoryFile, LevelInfo, log(tr("File %1 saved").arg(file)));
 	else
 		logError(tr("Saving to file %1 failed").arg(file));
 }
@@ -432,6 +1398,31 @@ void MainWin::saveSettings()
 	settings.setValue("xmax", maxX->value());
 	settings.setValue("ymin", minY->value());
 	settings.setValue("ymax", maxY->value());
+	settings.setValue("rangeMode", rangeMode->currentIndex());
+	settings.setValue("sweepMode", sweepAction->isChecked());
+	settings.setValue("rawMode", rawModeAction->isChecked());
+	settings.setValue("useDaemon", daemonAction->isChecked());
+	for (int i = 0; i < samplingActions.size(); ++i)
+		if (samplingActions[i]->isChecked())
+			settings.setValue("samplesPerPoint", samplingActions[i]->data().toInt());
+	settings.setValue("trimmedMean", trimmedMeanAction->isChecked());
+	for (int i = 0; i < ambientActions.size(); ++i)
+		if (ambientActions[i]->isChecked())
+			settings.setValue("ambientInterval", ambientActions[i]->data().toInt());
+	for (int i = 0; i < filterActions.size(); ++i)
+		if (filterActions[i]->isChecked())
+			settings.setValue("filterPreset", i);
+	QStringList extra;
+	for (int i = 0; i < heads.size(); ++i)
+		extra.append(heads[i]->path());
+	settings.setValue("extraScanners", extra);
+	settings.setValue("refreshRate", updateScheduler->rate());
+	settings.setValue("logLevels", logView->levelsMask());
+	uint categories = 0;
+	for (int i = 0; i < 4; ++i)
+		if (logCategoryActions[i]->isChecked())
+			categories |= 1 << i;
+	settings.setValue("logCategories", categories);
 	settings.setValue("splitterSizes", splitter->saveState());
 	settings.setValue("geometry", saveGeometry());
 	settings.setValue("windowState", saveState());
@@ -445,8 +1436,12 @@ void MainWin::saveSettingsLater()
 void MainWin::closeEvent(QCloseEvent *event)
 {
 	saveSettings();
-	if (thermCam->connected())
+	if (daemon->isConnected())
+		daemon->disconnectFromDaemon();
+	if (thermCam->connected() || thermCam->reconnecting())
 		doDisconnect();
+	for (int i = 0; i < heads.size(); ++i)
+		heads[i]->disconnectDevice();
 	QMainWindow::closeEvent(event);
 }
 
@@ -464,7 +1459,12 @@ void MainWin::prepareDataFileDialog()
 	if (!dataFileDialog)
 	{
 		dataFileDialog = new QFileDialog(this, tr("Choose file name"));
-		dataFileDialog->setNameFilter(tr("QThermCam data files (*.qtcd *.qtc)"));
+		QStringList filters;
+		filters << tr("QThermCam data files (*.qtcd *.qtc *.qtcb *.qtcs)")
+				<< tr("QThermCam XML data files (*.qtcd *.qtc)")
+				<< tr("QThermCam binary data files (*.qtcb)")
+				<< tr("QThermCam series files (*.qtcs)");
+		dataFileDialog->setNameFilters(filters);
 	}
 }
 
@@ -482,21 +1482,185 @@ void MainWin::saveData()
 
 void MainWin::loadDataFileSelected(const QString &file)
 {
-	if (tempView->loadFromFile(file))
-		saveImageAction->setEnabled(true);
+	// loaded frame would be overwritten by the scan anyway
+	if (thermCam->scanInProgress())
+	{
+		logError(tr("Cannot load file %1 while scanning").arg(file));
+		return;
+	}
+
+	if (file.endsWith(".qtcs"))
+	{
+		openSeries(file);
+		return;
+	}
+
+	// settings are read here, not in the worker thread
+	if (!frameIO->load(file, Calibration::fromSettings()))
+		logError(tr("Cannot load file %1, other file operation is in progress").arg(file));
 }
 
 void MainWin::saveDataFileSelected(const QString &file_)
 {
 	QString file = file_;
-	if (!file.endsWith(".qtcd"))
-		file += ".qtcd";
-	tempView->saveToFile(file);
+	if (!file.endsWith(".qtcd") && !file.endsWith(".qtcb"))
+	{
+		if (dataFileDialog->selectedNameFilter().contains("*.qtcd"))
+			file += ".qtcd";
+		else
+			file += ".qtcb";
+	}
+
+	if (!frameIO->save(file, currentView()->frame()))
+		logError(tr("Cannot save file %1, other file operation is in progress").arg(file));
+}
+
+void MainWin::appendToSeries()
+{
+	if (!seriesFileDialog)
+	{
+		seriesFileDialog = new QFileDialog(this, tr("Choose series file"));
+		seriesFileDialog->setNameFilter(tr("QThermCam series files (*.qtcs)"));
+	}
+	seriesFileDialog->open(this, SLOT(seriesFileSelected(const QString &)));
+}
+
+void MainWin::seriesFileSelected(const QString &file_)
+{
+	QString file = file_;
+	if (!file.endsWith(".qtcs"))
+		file += ".qtcs";
+
+	// writer truncates the index, which may be mapped by the reader
+	bool reopen = series && QFileInfo(file) == QFileInfo(seriesFile);
+	if (reopen)
+		closeSeries();
+
+	ThermFrame frame = currentView()->frame();
+	QDateTime started = QDateTime::fromString(frame.metadata.value("scanStarted"), Qt::ISODate);
+	if (!started.isValid())
+		started = QDateTime::currentDateTime();
+
+	QString err;
+	SeriesWriter writer;
+	if (!writer.open(file, frame.xmin, frame.xmax, frame.ymin, frame.ymax, err) ||
+			!writer.append(frame, started.toMSecsSinceEpoch(), err) || !writer.close(err))
+	{
+		logError(err);
+		return;
+	}
+	TC_LOG(CategoryFile, LevelInfo, log(tr("Frame %1 appended to %2").arg(writer.frameCount()).arg(file)));
+
+	if (reopen)
+		openSeries(file);
+}
+
+void MainWin::openSeries(const QString &file)
+{
+	closeSeries();
+
+	QString err;
+	series = new SeriesReader();
+	if (!series->open(file, err) || series->frameCount() == 0)
+	{
+		logError(err.isEmpty() ? tr("File %1 has no frames").arg(file) : err);
+		closeSeries();
+		return;
+	}
+
+	seriesFile = file;
+	seriesSlider->blockSignals(true);
+	seriesSlider->setRange(0, series->frameCount() - 1);
+	seriesSlider->setValue(series->frameCount() - 1);
+	seriesSlider->blockSignals(false);
+	seriesSlider->show();
+	seriesLabel->show();
+	seriesPositionChanged(seriesSlider->value());
+
+	saveImageAction->setEnabled(true);
+	appendSeriesAction->setEnabled(true);
+	TC_LOG(CategoryFile, LevelInfo, log(tr("Series %1 opened, %2 frames").arg(file).arg(series->frameCount())));
+}
+
+void MainWin::closeSeries()
+{
+	delete series;
+	series = NULL;
+	seriesSlider->hide();
+	seriesLabel->hide();
+}
+
+void MainWin::seriesPositionChanged(int index)
+{
+	if (!series)
+		return;
+
+	ThermFrame frame;
+	if (!series->frame(index, frame))
+	{
+		logError(tr("Cannot decode frame %1 of the series").arg(index + 1));
+		return;
+	}
+
+	tempView->setFrame(frame);
+	seriesLabel->setText(tr("Frame %1 / %2, %3").arg(index + 1).arg(series->frameCount())
+			.arg(QDateTime::fromMSecsSinceEpoch(series->timestamp(index)).toString(Qt::DefaultLocaleShortDate)));
+	updateTempScale();
+}
+
+void MainWin::fileOperationStarted(const QString &file)
+{
+	TC_LOG(CategoryFile, LevelDebug, logDebug(tr("Processing file %1").arg(file)));
+	loadAction->setEnabled(false);
+	saveAction->setEnabled(false);
+	fileProgress->setValue(0);
+	fileProgress->show();
+	fileCancel->show();
+}
+
+void MainWin::fileWarning(const QString &msg)
+{
+	TC_LOG(CategoryFile, LevelWarning, logWarning(msg));
+}
+
+void MainWin::fileOperationFinished()
+{
+	loadAction->setEnabled(true);
+	saveAction->setEnabled(true);
+	fileProgress->hide();
+	fileCancel->hide();
+}
+
+void MainWin::frameLoaded(const QString &file, const ThermFrame &frame)
+{
+	fileOperationFinished();
+
+	// scan could have been started while file was loading
+	if (thermCam->scanInProgress())
+	{
+		logError(tr("File %1 loaded during scan, discarding").arg(file));
+		return;
+	}
+
+	closeSeries();
+	tempView->setFrame(frame);
+	views->setCurrentWidget(tempView);
+	saveImageAction->setEnabled(true);
+	appendSeriesAction->setEnabled(true);
+	updateTempScale();
+	TC_LOG(CategoryFile, LevelInfo, log(tr("File %1 loaded").arg(file)));
+}
+
+void MainWin::frameSaved(const QString &file)
+{
+	fileOperationFinished();
+	TC_LOG(CategoryFile, LevelInfo, log(tr("File %1 saved").arg(file)));
 }
 
 void MainWin::logError(const QString &msg)
 {
-	log("<b><font color=\"red\">" + msg + "</font></b>");
+	logView->append(LevelError, msg);
+	updateScheduler->markDirty(UpdateScheduler::Log);
 }
 
 void MainWin::bufferSizeChanged(int xmin, int xmax, int ymin, int ymax)
@@ -505,8 +1669,6 @@ void MainWin::bufferSizeChanged(int xmin, int xmax, int ymin, int ymax)
 	maxX->setValue(xmax);
 	minY->setValue(ymin);
 	maxY->setValue(ymax);
-
-	tempScale->setBuffer(0, 59, 0, 255);
 }
 
 void MainWin::scannerReady(int xmin, int xmax, int ymin, int ymax)
@@ -517,24 +1679,39 @@ void MainWin::scannerReady(int xmin, int xmax, int ymin, int ymax)
 	maxY->setRange(ymin, ymax);
 
 	scanAction->setEnabled(true);
+	updateResumeAction();
+
+	// called while a line from the device is processed, nested event loop
+	// of the dialog would process next lines in the middle of it
+	if (resumeRow >= 0)
+		QTimer::singleShot(0, this, SLOT(askResume()));
+}
+
+void MainWin::askResume()
+{
+	// state could have changed before the event loop got here
+	if (resumeRow < 0 || !thermCam->connected() || thermCam->scanInProgress())
+		return;
+
+	if (QMessageBox::question(this, tr("Interrupted scan"),
+			tr("Scan was interrupted at row %1. Resume it?").arg(resumeRow),
+			QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes && resumeRow >= 0 &&
+			thermCam->connected() && !thermCam->scanInProgress())
+		resumeScan();
 }
 
 void MainWin::scannerMoved_X(int x)
 {
 	this->x = x;
 	tempView->highlightPoint(x, y);
-	if (!thermCam->scanInProgress())
-		tempView->refreshView();
-	resetStatusBar();
+	updateScheduler->markDirty(UpdateScheduler::View | UpdateScheduler::StatusBar);
 }
 
 void MainWin::scannerMoved_Y(int y)
 {
 	this->y = y;
 	tempView->highlightPoint(x, y);
-	if (!thermCam->scanInProgress())
-		tempView->refreshView();
-	resetStatusBar();
+	updateScheduler->markDirty(UpdateScheduler::View | UpdateScheduler::StatusBar);
 }
 
 void MainWin::objectTemperatureRead(int x, int y, float temp)
@@ -544,61 +1721,92 @@ void MainWin::objectTemperatureRead(int x, int y, float temp)
 	if (thermCam->scanInProgress())
 	{
 		tempView->setTemperature(x, y, temp);
-
-		if (x == maxX->value())
-		{
-			tempView->refreshImage(minY->value(), y);
-			tempView->refreshView();
-			qApp->processEvents();
-		}
+		updateScheduler->markDirty(UpdateScheduler::View | UpdateScheduler::Legend);
 	}
 
-	resetStatusBar();
+	updateScheduler->markDirty(UpdateScheduler::StatusBar);
 }
 
-void MainWin::ambientTemperatureRead(float temp)
+void MainWin::samplesRead(int x, int y, const QVector<float> &temps)
 {
-	temp_ambient = temp;
-	resetStatusBar();
+	temp_object = temps.last();
+	tempView->setTemperatures(x, y, temps.constData(), temps.size());
+	updateScheduler->markDirty(UpdateScheduler::View | UpdateScheduler::Legend | UpdateScheduler::StatusBar);
 }
 
-void MainWin::fillTempScale(float tmin, float tmax)
+void MainWin::variancesRead(int x, int y, const QVector<float> &variances)
 {
-	for (int y = 0; y < tempScale->bufferHeight(); ++y)
-	{
-		float temp2 = tmin + y * (tmax - tmin) / tempScale->bufferHeight();
-		for (int x = 0; x < tempScale->bufferWidth(); ++x)
-			tempScale->setTemperature(x, y, temp2);
-	}
+	tempView->setVariances(x, y, variances.constData(), variances.size());
+	updateScheduler->markDirty(UpdateScheduler::View);
 }
 
-void MainWin::temperatureSet(int x, int y, float /*temp*/)
+void MainWin::pointRescanned(int x, int y)
 {
-	if (x != tempView->maximumX())
-		return;
-	if (!thermCam->scanInProgress() && y != tempView->maximumY())
-		return;
+	tempView->markRescanned(QPoint(x, y));
+}
+
+void MainWin::ambientTemperatureRead(float temp)
+{
+	temp_ambient = temp;
+	updateScheduler->markDirty(UpdateScheduler::StatusBar);
+}
 
-	float tmin = tempView->minTemperature();
-	float tmax = tempView->maxTemperature();
+void MainWin::rowAmbientRead(int y, float temp)
+{
+	tempView->addRowAmbient(y, temp);
+}
 
-	fillTempScale(tmin, tmax);
+void MainWin::updateUi(uint parts)
+{
+	if (parts & UpdateScheduler::View)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		tempView->refreshChangedRows();
+		tempView->refreshView();
+		for (int i = 0; i < heads.size(); ++i)
+		{
+			heads[i]->view()->refreshChangedRows();
+			heads[i]->view()->refreshView();
+		}
 
-	tempScale->clearStaticLabels();
-	tempScale->addStaticLabel(QPoint(10, 0));
-	tempScale->addStaticLabel(QPoint(10, tempScale->bufferHeight() - 1));
+		// such updates lower the refresh rate
+		qint64 frameMs = 1000 / updateScheduler->rate();
+		if (timer.elapsed() > frameMs)
+			TC_LOG(CategoryRender, LevelDebug, logDebug(tr("View update took %1 ms, more than a frame (%2 ms)")
+					.arg(timer.elapsed()).arg(frameMs)));
+	}
+	if (parts & UpdateScheduler::Legend)
+		updateTempScale();
+	if (parts & UpdateScheduler::StatusBar)
+		resetStatusBar();
+	if (parts & UpdateScheduler::Log)
+		logView->flush();
+}
 
-	int prev_y = 5; // TODO: see below
-	for (float t = ceil(tmin * 2) / 2; t < tmax; t += 0.5)
+void MainWin::rangeModeChanged(int index)
+{
+	tempView->setRangeMode((TempView::RangeMode)index);
+	tempView->refreshImage();
+	tempView->refreshView();
+	for (int i = 0; i < heads.size(); ++i)
 	{
-		int y = (t - tmin) * tempScale->bufferHeight() / (tmax - tmin);
-		// TODO: these values should be derived from values calculated in refreshView (rect size and yoffset)
-		if (y < prev_y + 20 || y > tempScale->bufferHeight() - 20)
-			continue;
-		tempScale->addStaticLabel(QPoint(10, y));
-		prev_y = y;
+		heads[i]->view()->setRangeMode((TempView::RangeMode)index);
+		heads[i]->view()->refreshImage();
+		heads[i]->view()->refreshView();
 	}
+	updateTempScale();
+	saveSettingsLater();
+}
+
+void MainWin::noiseMapToggled(bool show)
+{
+	tempView->setNoiseMap(show);
+	// legend describes temperatures
+	tempScale->setVisible(!show);
+}
 
-	tempScale->refreshImage();
-	tempScale->refreshView();
+void MainWin::updateTempScale()
+{
+	tempScale->sourceChanged();
 }
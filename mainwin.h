@@ -1,20 +1,39 @@
 #ifndef mainwin_h
 #define mainwin_h
 
+#include <QElapsedTimer>
+#include <QList>
 #include <QMainWindow>
+#include <QVector>
+
+#include "thermframe.h"
 
 class QAction;
+class QComboBox;
+class QLabel;
 class QFileDialog;
 class QLineEdit;
+class QProgressBar;
+class QPushButton;
+class QSlider;
 class QSpinBox;
 class QSplitter;
-class QTextEdit;
+class QTabWidget;
 class QToolBar;
 
 namespace QThermCam
 {
+class DaemonClient;
+class DeviceProbe;
+class FrameIO;
+class LogView;
+class ScanHead;
+class ScanJournal;
+class SeriesReader;
+class TempScale;
 class TempView;
 class ThermCam;
+class UpdateScheduler;
 
 class MainWin : public QMainWindow
 {
@@ -22,38 +41,94 @@ class MainWin : public QMainWindow
 	ThermCam *thermCam;
 
 	QToolBar *fileToolbar, *deviceToolbar;
-	QMenu *fileMenu, *deviceMenu, *helpMenu;
-
-	QAction *connectAction, *disconnectAction, *scanAction, *stopScanAction;
-	QAction *loadAction, *saveAction, *saveImageAction;
+	QMenu *fileMenu, *deviceMenu, *logMenu, *helpMenu;
+
+	QAction *connectAction, *disconnectAction, *scanAction, *stopScanAction, *resumeScanAction, *sweepAction;
+	QAction *rawModeAction, *calibrationAction;
+	QList<QAction *> filterActions;
+	QAction *filterBenchmarkAction;
+	QMenu *filterMenu, *samplingMenu, *viewMenu;
+	QList<QAction *> samplingActions;
+	QAction *trimmedMeanAction, *noiseMapAction;
+	QMenu *ambientMenu, *toolsMenu;
+	QList<QAction *> ambientActions;
+	QAction *driftAction;
+	QAction *addScannerAction, *removeScannerAction, *findDevicesAction;
+	/* scans are driven by qthermcamd instead of the device */
+	QAction *daemonAction;
+	/* preset being benchmarked, -1 if none */
+	int benchmarkPreset;
+	QAction *loadAction, *saveAction, *saveImageAction, *appendSeriesAction;
 	QAction *exitAction, *aboutAction, *aboutQtAction, *clearLogAction;
+	QAction *logLevelActions[4], *logCategoryActions[4];
 
 	QLineEdit *pathEdit;
 	QSpinBox *minX, *maxX, *minY, *maxY;
-	TempView *tempScale;
+	QComboBox *rangeMode;
+	TempScale *tempScale;
+	QSlider *seriesSlider;
+	QLabel *seriesLabel;
 
 	QSplitter *splitter;
+	/* tab of the main scanner is first, then one per additional head */
+	QTabWidget *views;
 	TempView *tempView;
+	QList<ScanHead *> heads;
+
+	DeviceProbe *deviceProbe;
+	DaemonClient *daemon;
+	/* connect to the first device found, path was not given */
+	bool autoConnect;
+
+	/* progress of all scanners together */
+	QProgressBar *scanProgress;
+	QLabel *scanRate;
+	QElapsedTimer scanTimer;
+	int rowsTotal, rowsDone, pointsDone;
 
-	QTextEdit *textEdit;
+	LogView *logView;
+
+	FrameIO *frameIO;
+	QProgressBar *fileProgress;
+	QPushButton *fileCancel;
 
 	int x, y;
 
 	float temp_object, temp_ambient;
 
-	QFileDialog *imageFileDialog, *dataFileDialog;
+	QFileDialog *imageFileDialog, *dataFileDialog, *seriesFileDialog;
+
+	ScanJournal *journal;
+	/* first row of interrupted scan which was not scanned, -1 if none */
+	int resumeRow;
+
+	SeriesReader *series;
+	QString seriesFile;
 
 	QTimer *settingsTimer;
+	UpdateScheduler *updateScheduler;
 
 	void prepareDataFileDialog();
 
+	QList<ThermCam *> thermCams();
+	void configureThermCam(ThermCam *cam);
+	TempView *currentView();
+	ScanHead *addHead(const QString &path);
+	void startProgress(int rows);
+
 	void createActions();
 	void createMenus();
 	void createToolBar();
 	void createStatusBar();
 
 	void resetStatusBar();
-	void fillTempScale(float tmin, float tmax);
+	void applyLogFilter();
+	void updateTempScale();
+	void startScanUi();
+	void checkJournal();
+	void updateResumeAction();
+	void openSeries(const QString &file);
+	void closeSeries();
 
 	void closeEvent(QCloseEvent *event);
 	bool eventFilter(QObject *obj, QEvent *event);
@@ -65,31 +140,80 @@ class MainWin : public QMainWindow
 	/* toolbar actions - device */
 	void doConnect();
 	void doDisconnect();
+	void connectionLost();
+	void reconnected();
 	void scanImage();
+	void resumeScan();
+	void askResume();
 	void scanningStopped();
+	void scanModeChanged();
+	void rawModeChanged(bool raw);
+	void editCalibration();
+	void filterPresetChanged();
+	void benchmarkFilters();
+	void samplingChanged();
+	void noiseMapToggled(bool show);
+	void ambientIntervalChanged();
+	void correctDrift();
+	void addScanner();
+	void removeScanner();
+	void stopScanning();
+	void findDevices();
 
 	/* toolbar actions - app */
 	void loadData();
 	void saveData();
 	void saveImage();
+	void appendToSeries();
 	void clearLog();
+	void logLevelsChanged();
 
 	void loadDataFileSelected(const QString &file);
 	void saveDataFileSelected(const QString &file);
 	void imageFileSelected(const QString &file);
+	void seriesFileSelected(const QString &file);
+	void seriesPositionChanged(int index);
+
+	/* FrameIO */
+	void fileOperationStarted(const QString &file);
+	void fileOperationFinished();
+	void fileWarning(const QString &msg);
+	void frameLoaded(const QString &file, const ThermFrame &frame);
+	void frameSaved(const QString &file);
 
 	/* TempView */
 	void bufferSizeChanged(int xmin, int xmax, int ymin, int ymax);
 	void splitterMoved(int pos, int index);
 	void imageClicked(const QPoint &p);
-	void temperatureSet(int x, int y, float t);
+	void rangeModeChanged(int index);
 
 	/* ThermCam */
 	void scannerReady(int xmin, int xmax, int ymin, int ymax);
+	void settleMeasured(int ms, float temp);
 	void scannerMoved_X(int x);
 	void scannerMoved_Y(int y);
 	void objectTemperatureRead(int x, int y, float temp);
+	void samplesRead(int x, int y, const QVector<float> &temps);
+	void variancesRead(int x, int y, const QVector<float> &variances);
+	void pointRescanned(int x, int y);
 	void ambientTemperatureRead(float temp);
+	void rowAmbientRead(int y, float temp);
+	void rowDone(int y, const QVector<float> &temps);
+
+	/* DaemonClient */
+	void daemonConnected();
+	void daemonDisconnected();
+	void daemonScanStarted(int xmin, int xmax, int ymin, int ymax);
+	void daemonScanJoined(const ThermFrame &frame, int rowsDone);
+	void daemonRowScanned(int rowsDone, int rowsTotal);
+	void daemonScanFinished(bool complete);
+
+	/* DeviceProbe */
+	void deviceFound(const QString &path, int xmin, int xmax, int ymin, int ymax);
+	void deviceRemoved(const QString &path);
+
+	/* ScanHead */
+	void headChanged();
 
 	/* misc */
 	void about();
@@ -97,7 +221,11 @@ class MainWin : public QMainWindow
 	void saveSettings();
 	void saveSettingsLater();
 
+	void updateUi(uint parts);
+
+	void logDebug(const QString &msg);
 	void log(const QString &msg);
+	void logWarning(const QString &msg);
 	void logError(const QString &msg);
 };
 
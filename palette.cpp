@@ -0,0 +1,91 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "palette.h"
+
+using namespace QThermCam;
+
+static QRgb getColor(int level)
+{
+	level = 1023 - level;
+	if (level < 256)
+		return qRgb(255, 255 - level, 0);
+	if (level < 512)
+		return qRgb(255, 0, level - 256);
+	if (level < 768)
+		return qRgb(255 - (level - 512), 0, 255);
+	return qRgb(0, level - 768, 255);
+}
+
+static QRgb getIronColor(int level)
+{
+	// black - blue - red - yellow - white
+	if (level < 256)
+		return qRgb(0, 0, level / 2);
+	if (level < 512)
+		return qRgb(level - 256, 0, 128 - (level - 256) / 2);
+	if (level < 768)
+		return qRgb(255, level - 512, 0);
+	return qRgb(255, 255, level - 768);
+}
+
+static QRgb getGrayColor(int level)
+{
+	return qRgb(level / 4, level / 4, level / 4);
+}
+
+namespace
+{
+struct PaletteTable
+{
+	QRgb colors[PaletteCount][PALETTE_LEVELS];
+
+	PaletteTable()
+	{
+		for (int i = 0; i < PALETTE_LEVELS; ++i)
+		{
+			colors[PaletteDefault][i] = getColor(i);
+			colors[PaletteIron][i] = getIronColor(i);
+			colors[PaletteGray][i] = getGrayColor(i);
+		}
+	}
+};
+}
+
+static const char *paletteNames[PaletteCount] = { "default", "iron", "gray" };
+
+const QRgb *QThermCam::paletteTable(PaletteType type)
+{
+	static PaletteTable table;
+	if (type < 0 || type >= PaletteCount)
+		type = PaletteDefault;
+	return table.colors[type];
+}
+
+QString QThermCam::paletteName(PaletteType type)
+{
+	if (type < 0 || type >= PaletteCount)
+		return QString();
+	return paletteNames[type];
+}
+
+PaletteType QThermCam::paletteByName(const QString &name)
+{
+	for (int i = 0; i < PaletteCount; ++i)
+		if (name == paletteNames[i])
+			return (PaletteType)i;
+	return PaletteCount;
+}
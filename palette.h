@@ -0,0 +1,25 @@
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#include <QRgb>
+#include <QString>
+
+namespace QThermCam
+{
+
+enum { PALETTE_LEVELS = 1024 };
+
+enum PaletteType { PaletteDefault, PaletteIron, PaletteGray, PaletteCount };
+
+/* PALETTE_LEVELS colors, from the coldest to the hottest */
+const QRgb *paletteTable(PaletteType type = PaletteDefault);
+
+/* short name, usable on command line */
+QString paletteName(PaletteType type);
+
+/* PaletteCount if name is unknown */
+PaletteType paletteByName(const QString &name);
+
+}
+
+#endif /* PALETTE_H_ */
@@ -2,10 +2,10 @@ TEMPLATE = app
 DEPENDPATH += .
 INCLUDEPATH += .
 CONFIG += debug
-QT += xml widgets
+QT += widgets concurrent network
 
 OBJECTS_DIR=.tmp
 MOC_DIR=.tmp
 
-HEADERS += mainwin.h tempview.h thermcam.h
-SOURCES += main.cpp mainwin.cpp tempview.cpp thermcam.cpp thermcam_lock.cpp
+HEADERS += calibration.h daemonclient.h deviceprobe.h drift.h frameio.h framefile.h histogram.h logging.h logview.h mainwin.h palette.h scanhead.h scanjournal.h series.h sweep.h tempscale.h tempview.h thermcam.h thermframe.h updatescheduler.h
+SOURCES += calibration.cpp daemonclient.cpp deviceprobe.cpp drift.cpp frameio.cpp framefile.cpp framefile_binary.cpp histogram.cpp logging.cpp logview.cpp main.cpp mainwin.cpp palette.cpp scanhead.cpp scanjournal.cpp series.cpp sweep.cpp tempscale.cpp tempview.cpp thermcam.cpp thermcam_lock.cpp updatescheduler.cpp
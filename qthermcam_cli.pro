@@ -0,0 +1,15 @@
+# qmake qthermcam_cli.pro && make -f Makefile.cli
+TEMPLATE = app
+TARGET = qthermcam-cli
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG += debug console
+CONFIG -= app_bundle
+QT = core gui concurrent
+
+MAKEFILE = Makefile.cli
+OBJECTS_DIR=.tmp-cli
+MOC_DIR=.tmp-cli
+
+HEADERS += calibration.h frameexport.h framefile.h histogram.h palette.h thermframe.h
+SOURCES += calibration.cpp cli.cpp frameexport.cpp framefile.cpp framefile_binary.cpp histogram.cpp palette.cpp
@@ -0,0 +1,16 @@
+# qmake qthermcamd.pro && make -f Makefile.daemon
+TEMPLATE = app
+TARGET = qthermcamd
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG += debug console
+CONFIG -= app_bundle
+QT = core network
+
+MAKEFILE = Makefile.daemon
+OBJECTS_DIR=.tmp-daemon
+MOC_DIR=.tmp-daemon
+
+HEADERS += calibration.h deviceprobe.h drift.h framefile.h frameshm.h logging.h scanqueue.h scanserver.h sweep.h thermcam.h thermframe.h
+SOURCES += calibration.cpp daemon.cpp deviceprobe.cpp drift.cpp framefile.cpp framefile_binary.cpp frameshm.cpp logging.cpp scanqueue.cpp scanserver.cpp sweep.cpp thermcam.cpp thermcam_lock.cpp
+LIBS += -lrt
@@ -0,0 +1,137 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "scanhead.h"
+#include "logging.h"
+#include "tempview.h"
+#include "thermcam.h"
+
+#include <QDateTime>
+
+using namespace QThermCam;
+
+ScanHead::ScanHead(const QString &path, QObject *parent) : QObject(parent), path_(path), ready(false)
+{
+	cam = new ThermCam(this);
+	view_ = new TempView();
+
+	connect(cam, SIGNAL(scannerReady(int, int, int, int)), this, SLOT(scannerReady(int, int, int, int)));
+	connect(cam, SIGNAL(samplesRead(int, int, const QVector<float> &)), this, SLOT(samplesRead(int, int, const QVector<float> &)));
+	connect(cam, SIGNAL(variancesRead(int, int, const QVector<float> &)), this, SLOT(variancesRead(int, int, const QVector<float> &)));
+	connect(cam, SIGNAL(pointRescanned(int, int)), this, SLOT(pointRescanned(int, int)));
+	connect(cam, SIGNAL(rowAmbientRead(int, float)), this, SLOT(rowAmbientRead(int, float)));
+	connect(cam, SIGNAL(scanningStopped()), this, SLOT(scanningStopped()));
+
+	connect(cam, SIGNAL(debug(const QString &)), this, SLOT(camDebug(const QString &)));
+	connect(cam, SIGNAL(info(const QString &)), this, SLOT(camInfo(const QString &)));
+	connect(cam, SIGNAL(warning(const QString &)), this, SLOT(camWarning(const QString &)));
+	connect(cam, SIGNAL(error(const QString &)), this, SLOT(camError(const QString &)));
+}
+
+bool ScanHead::connectDevice()
+{
+	if (!cam->doConnect(path_))
+		return false;
+	TC_LOG(CategorySerial, LevelInfo, emit info(tr("%1: connected").arg(path_)));
+	return true;
+}
+
+void ScanHead::disconnectDevice()
+{
+	if (!cam->connected() && !cam->reconnecting())
+		return;
+	cam->doDisconnect();
+	ready = false;
+	TC_LOG(CategorySerial, LevelInfo, emit info(tr("%1: disconnected").arg(path_)));
+}
+
+bool ScanHead::clamp(int &xmin, int &xmax, int &ymin, int &ymax)
+{
+	if (!ready)
+		return false;
+
+	xmin = qMax(xmin, devXmin);
+	xmax = qMin(xmax, devXmax);
+	ymin = qMax(ymin, devYmin);
+	ymax = qMin(ymax, devYmax);
+	return xmin <= xmax && ymin <= ymax;
+}
+
+void ScanHead::startScan(int xmin, int xmax, int ymin, int ymax)
+{
+	view_->setBuffer(xmin, xmax, ymin, ymax);
+	view_->setFileMetadata("scanStarted", QDateTime::currentDateTime().toString(Qt::ISODate));
+	view_->setFileMetadata("device", path_);
+	cam->scanImage(xmin, xmax, ymin, ymax);
+}
+
+void ScanHead::scannerReady(int xmin, int xmax, int ymin, int ymax)
+{
+	devXmin = xmin;
+	devXmax = xmax;
+	devYmin = ymin;
+	devYmax = ymax;
+	ready = true;
+}
+
+void ScanHead::samplesRead(int x, int y, const QVector<float> &temps)
+{
+	view_->setTemperatures(x, y, temps.constData(), temps.size());
+	emit changed();
+}
+
+void ScanHead::variancesRead(int x, int y, const QVector<float> &variances)
+{
+	view_->setVariances(x, y, variances.constData(), variances.size());
+	emit changed();
+}
+
+void ScanHead::pointRescanned(int x, int y)
+{
+	view_->markRescanned(QPoint(x, y));
+}
+
+void ScanHead::rowAmbientRead(int y, float temp)
+{
+	view_->addRowAmbient(y, temp);
+}
+
+void ScanHead::scanningStopped()
+{
+	TC_LOG(CategoryScan, LevelInfo, emit info(tr("%1: scan finished").arg(path_)));
+	emit changed();
+}
+
+// messages of all devices end up in one log
+void ScanHead::camDebug(const QString &msg)
+{
+	emit debug(QString("%1: %2").arg(path_).arg(msg));
+}
+
+void ScanHead::camInfo(const QString &msg)
+{
+	emit info(QString("%1: %2").arg(path_).arg(msg));
+}
+
+void ScanHead::camWarning(const QString &msg)
+{
+	emit warning(QString("%1: %2").arg(path_).arg(msg));
+}
+
+void ScanHead::camError(const QString &msg)
+{
+	emit error(QString("%1: %2").arg(path_).arg(msg));
+}
@@ -0,0 +1,72 @@
+#ifndef SCANHEAD_H_
+#define SCANHEAD_H_
+
+#include <QObject>
+#include <QVector>
+
+namespace QThermCam
+{
+
+class TempView;
+class ThermCam;
+
+/* Additional scanner working next to the main one - own device, scan engine
+ * and view. ThermCam does non-blocking I/O driven by socket notifiers, so all
+ * heads are multiplexed on the GUI event loop and scan in parallel.
+ */
+class ScanHead : public QObject
+{
+	Q_OBJECT
+	QString path_;
+	ThermCam *cam;
+	TempView *view_;
+	/* field of view reported by the device, valid once ready */
+	bool ready;
+	int devXmin, devXmax, devYmin, devYmax;
+
+public:
+	/* view is meant to be put into a tab, which takes its ownership */
+	ScanHead(const QString &path, QObject *parent);
+
+	const QString &path() { return path_; }
+
+	ThermCam *thermCam() { return cam; }
+
+	TempView *view() { return view_; }
+
+	bool connectDevice();
+
+	void disconnectDevice();
+
+	/* limits field of view to what the device can reach; false if it's not
+	 * known yet or nothing is left */
+	bool clamp(int &xmin, int &xmax, int &ymin, int &ymax);
+
+	void startScan(int xmin, int xmax, int ymin, int ymax);
+
+private slots:
+	void scannerReady(int xmin, int xmax, int ymin, int ymax);
+	void samplesRead(int x, int y, const QVector<float> &temps);
+	void variancesRead(int x, int y, const QVector<float> &variances);
+	void pointRescanned(int x, int y);
+	void rowAmbientRead(int y, float temp);
+	void scanningStopped();
+
+	void camDebug(const QString &msg);
+	void camInfo(const QString &msg);
+	void camWarning(const QString &msg);
+	void camError(const QString &msg);
+
+signals:
+	/* view needs refresh */
+	void changed();
+
+	void debug(const QString &msg);
+	void info(const QString &msg);
+	void warning(const QString &msg);
+	void error(const QString &msg);
+};
+
+}
+
+#endif /* SCANHEAD_H_ */
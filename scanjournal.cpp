@@ -0,0 +1,243 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Journal is a sequence of records, all numbers are little endian:
+ *   char    tag[4]     "QTCJ" - header, "ROW " - scanned row
+ *   uint32  size       of payload
+ *   payload
+ *   uint16  checksum   qChecksum of tag, size and payload
+ *
+ * header payload: int16 xmin, xmax, ymin, ymax; int64 start time (ms since
+ * epoch); UTF-8 device path
+ * row payload: int16 y; width * float32
+ *
+ * Record which does not fit or has wrong checksum ends the journal - it was
+ * being written when the program died.
+ */
+
+#include "scanjournal.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QtEndian>
+
+#include <string.h>
+#include <unistd.h>
+
+using namespace QThermCam;
+
+ScanJournal::ScanJournal(QObject *parent) : QObject(parent), unsynced(0), xmin(0), xmax(-1), ymin(0), ymax(-1)
+{
+	syncTimer = new QTimer(this);
+	syncTimer->setSingleShot(true);
+	syncTimer->setInterval(SYNC_INTERVAL);
+	connect(syncTimer, SIGNAL(timeout()), this, SLOT(sync()));
+	setPath(defaultPath());
+}
+
+QString ScanJournal::defaultPath()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/scan.journal";
+}
+
+void ScanJournal::setPath(const QString &path)
+{
+	f.close();
+	f.setFileName(path);
+}
+
+static QByteArray makeRecord(const char *tag, const QByteArray &payload)
+{
+	QByteArray record(tag, 4);
+	uchar buf[4];
+	qToLittleEndian<quint32>(payload.size(), buf);
+	record.append((const char *)buf, 4);
+	record += payload;
+	qToLittleEndian<quint16>(qChecksum(record.constData(), record.size()), buf);
+	record.append((const char *)buf, 2);
+	return record;
+}
+
+bool ScanJournal::writeRecord(const QByteArray &record)
+{
+	if (!f.isOpen())
+		return false;
+
+	if (f.write(record) != record.size() || !f.flush())
+	{
+		emit error(tr("Cannot write to scan journal %1: %2").arg(f.fileName()).arg(f.errorString()));
+		f.close();
+		return false;
+	}
+	return true;
+}
+
+bool ScanJournal::start(int _xmin, int _xmax, int _ymin, int _ymax, const QString &device, qint64 started)
+{
+	xmin = _xmin;
+	xmax = _xmax;
+	ymin = _ymin;
+	ymax = _ymax;
+
+	f.close();
+	QDir().mkpath(QFileInfo(f.fileName()).path());
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		emit error(tr("Cannot create scan journal %1: %2").arg(f.fileName()).arg(f.errorString()));
+		return false;
+	}
+
+	QByteArray payload(16, '\0');
+	uchar *p = (uchar *)payload.data();
+	qToLittleEndian<qint16>(xmin, p);
+	qToLittleEndian<qint16>(xmax, p + 2);
+	qToLittleEndian<qint16>(ymin, p + 4);
+	qToLittleEndian<qint16>(ymax, p + 6);
+	qToLittleEndian<qint64>(started, p + 8);
+	payload += device.toUtf8();
+
+	if (!writeRecord(makeRecord("QTCJ", payload)))
+		return false;
+	sync();
+	return true;
+}
+
+bool ScanJournal::resume()
+{
+	f.close();
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Append))
+	{
+		emit error(tr("Cannot open scan journal %1: %2").arg(f.fileName()).arg(f.errorString()));
+		return false;
+	}
+	return true;
+}
+
+void ScanJournal::addRow(int y, const QVector<float> &temps)
+{
+	if (!f.isOpen() || y < ymin || y > ymax || temps.size() != xmax - xmin + 1)
+		return;
+
+	QByteArray payload(2 + temps.size() * 4, '\0');
+	uchar *p = (uchar *)payload.data();
+	qToLittleEndian<qint16>(y, p);
+	for (int i = 0; i < temps.size(); ++i)
+	{
+		quint32 u;
+		memcpy(&u, &temps[i], 4);
+		qToLittleEndian<quint32>(u, p + 2 + i * 4);
+	}
+
+	if (!writeRecord(makeRecord("ROW ", payload)))
+		return;
+
+	if (++unsynced >= SYNC_ROWS)
+		sync();
+	else if (!syncTimer->isActive())
+		syncTimer->start();
+}
+
+void ScanJournal::sync()
+{
+	syncTimer->stop();
+	unsynced = 0;
+	if (f.isOpen())
+		::fdatasync(f.handle());
+}
+
+void ScanJournal::discard()
+{
+	syncTimer->stop();
+	unsynced = 0;
+	f.close();
+	f.remove();
+}
+
+bool ScanJournal::recover(ThermFrame &frame, int &nextRow)
+{
+	f.close();
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	QByteArray data = f.readAll();
+	f.close();
+
+	const uchar *p = (const uchar *)data.constData();
+	const uchar *end = p + data.size();
+	QVector<bool> haveRow;
+	bool haveHeader = false;
+
+	while (end - p >= 10)
+	{
+		quint32 size = qFromLittleEndian<quint32>(p + 4);
+		if ((quint64)(end - p) < 10 + (quint64)size)
+			break;
+		if (qFromLittleEndian<quint16>(p + 8 + size) != qChecksum((const char *)p, 8 + size))
+			break;
+
+		const uchar *payload = p + 8;
+		if (memcmp(p, "QTCJ", 4) == 0 && !haveHeader && size >= 16)
+		{
+			xmin = qFromLittleEndian<qint16>(payload);
+			xmax = qFromLittleEndian<qint16>(payload + 2);
+			ymin = qFromLittleEndian<qint16>(payload + 4);
+			ymax = qFromLittleEndian<qint16>(payload + 6);
+			if (xmax < xmin || ymax < ymin || xmax - xmin > 1000 || ymax - ymin > 1000)
+				return false;
+
+			frame.reset(xmin, xmax, ymin, ymax);
+			frame.metadata["scanStarted"] = QDateTime::fromMSecsSinceEpoch(
+					qFromLittleEndian<qint64>(payload + 8)).toString(Qt::ISODate);
+			frame.metadata["device"] = QString::fromUtf8((const char *)payload + 16, size - 16);
+			haveRow.fill(false, ymax - ymin + 1);
+			haveHeader = true;
+		}
+		else if (memcmp(p, "ROW ", 4) == 0 && haveHeader && size == 2 + (quint32)frame.width() * 4)
+		{
+			int y = qFromLittleEndian<qint16>(payload);
+			if (y >= ymin && y <= ymax)
+			{
+				float *row = frame.data.data() + (y - ymin) * frame.width();
+				for (int x = 0; x < frame.width(); ++x)
+				{
+					quint32 u = qFromLittleEndian<quint32>(payload + 2 + x * 4);
+					memcpy(&row[x], &u, 4);
+				}
+				haveRow[y - ymin] = true;
+			}
+		}
+		else if (!haveHeader)
+			return false;
+
+		p += 10 + size;
+	}
+
+	if (!haveHeader)
+		return false;
+
+	nextRow = ymin + haveRow.indexOf(false);
+	if (nextRow < ymin)
+		return false; // all rows are there
+
+	// drop damaged tail, so resumed scan appends after the last good record
+	if (p != end)
+		f.resize(p - (const uchar *)data.constData());
+
+	return true;
+}
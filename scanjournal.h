@@ -0,0 +1,64 @@
+#ifndef SCANJOURNAL_H_
+#define SCANJOURNAL_H_
+
+#include <QFile>
+#include <QObject>
+#include <QVector>
+
+#include "thermframe.h"
+
+class QTimer;
+
+namespace QThermCam
+{
+
+/* Append-only record of scanned rows, so an interrupted scan (stop, crash,
+ * lost connection) can be continued from the first missing row. Rows are
+ * fsynced in batches - at most SYNC_ROWS rows or SYNC_INTERVAL ms can be
+ * lost on power failure.
+ */
+class ScanJournal : public QObject
+{
+	Q_OBJECT
+	enum { SYNC_ROWS = 8, SYNC_INTERVAL = 2000 };
+
+	QFile f;
+	QTimer *syncTimer;
+	int unsynced;
+	int xmin, xmax, ymin, ymax;
+
+	bool writeRecord(const QByteArray &record);
+
+public:
+	ScanJournal(QObject *parent = 0);
+
+	/* default location, in application data directory */
+	static QString defaultPath();
+
+	void setPath(const QString &path);
+
+	/* starts new journal, forgetting the old one */
+	bool start(int xmin, int xmax, int ymin, int ymax, const QString &device, qint64 started);
+
+	/* continues journal returned by recover() */
+	bool resume();
+
+	void discard();
+
+	/* Reads journal up to the first damaged record. Returns false if there's
+	 * nothing to resume; nextRow is the first row which was not scanned.
+	 * Scan start time and device are stored in frame metadata. */
+	bool recover(ThermFrame &frame, int &nextRow);
+
+public slots:
+	void addRow(int y, const QVector<float> &temps);
+
+	void sync();
+
+signals:
+	void error(const QString &msg);
+};
+
+}
+
+#endif /* SCANJOURNAL_H_ */
@@ -0,0 +1,279 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "scanqueue.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+using namespace QThermCam;
+
+// weight of the newest measurement in the running average of scan speed
+#define THROUGHPUT_WEIGHT 0.3
+
+ScanQueue::ScanQueue() : nextId(1)
+{
+}
+
+QString ScanQueue::throughputKey(const ScanJob &job)
+{
+	return QString("%1/f%2/n%3").arg(job.sweep ? "sweep" : "step").arg(job.filterPreset).arg(job.samples);
+}
+
+bool ScanQueue::load(const QString &file_, QString &err)
+{
+	file = file_;
+	jobs_.clear();
+	throughput.clear();
+	nextId = 1;
+
+	QFile f(file);
+	if (!f.exists())
+		return true;
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		err = tr("Cannot open file %1: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	QJsonParseError parseError;
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &parseError);
+	if (!doc.isObject())
+	{
+		err = tr("Invalid queue file %1: %2").arg(file).arg(parseError.errorString());
+		return false;
+	}
+
+	QJsonObject root = doc.object();
+	QJsonArray jobs = root.value("jobs").toArray();
+	for (int i = 0; i < jobs.size(); ++i)
+	{
+		ScanJob job;
+		if (!fromJson(jobs[i].toObject(), job, err))
+		{
+			err = tr("Invalid job in %1: %2").arg(file).arg(err);
+			return false;
+		}
+		QJsonObject o = jobs[i].toObject();
+		job.id = o.value("id").toInt();
+		job.runs = o.value("runs").toInt();
+		job.lastResult = o.value("lastResult").toString();
+		nextId = qMax(nextId, job.id + 1);
+		jobs_.append(job);
+	}
+
+	QJsonObject t = root.value("throughput").toObject();
+	for (QJsonObject::const_iterator it = t.constBegin(); it != t.constEnd(); ++it)
+		throughput[it.key()] = it.value().toDouble();
+	return true;
+}
+
+bool ScanQueue::save(QString &err)
+{
+	QJsonArray jobs;
+	for (int i = 0; i < jobs_.size(); ++i)
+		jobs.append(toJson(jobs_[i]));
+
+	QJsonObject t;
+	for (QMap<QString, double>::const_iterator it = throughput.constBegin(); it != throughput.constEnd(); ++it)
+		t[it.key()] = it.value();
+
+	QJsonObject root;
+	root["jobs"] = jobs;
+	root["throughput"] = t;
+
+	QDir().mkpath(QFileInfo(file).path());
+	// old queue stays untouched if anything goes wrong
+	QSaveFile f(file);
+	if (!f.open(QIODevice::WriteOnly) || f.write(QJsonDocument(root).toJson()) < 0 || !f.commit())
+	{
+		err = tr("Cannot write to file %1: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+	return true;
+}
+
+int ScanQueue::add(ScanJob job)
+{
+	job.id = nextId++;
+	job.runs = 0;
+	jobs_.append(job);
+	return job.id;
+}
+
+bool ScanQueue::remove(int id)
+{
+	for (int i = 0; i < jobs_.size(); ++i)
+		if (jobs_[i].id == id)
+		{
+			jobs_.removeAt(i);
+			return true;
+		}
+	return false;
+}
+
+ScanJob *ScanQueue::job(int id)
+{
+	for (int i = 0; i < jobs_.size(); ++i)
+		if (jobs_[i].id == id)
+			return &jobs_[i];
+	return NULL;
+}
+
+ScanJob *ScanQueue::due(qint64 now)
+{
+	ScanJob *first = NULL;
+	for (int i = 0; i < jobs_.size(); ++i)
+		if (jobs_[i].nextRun <= now && (!first || jobs_[i].nextRun < first->nextRun))
+			first = &jobs_[i];
+	return first;
+}
+
+qint64 ScanQueue::msToNext(qint64 now)
+{
+	if (jobs_.isEmpty())
+		return -1;
+
+	qint64 next = jobs_[0].nextRun;
+	for (int i = 1; i < jobs_.size(); ++i)
+		next = qMin(next, jobs_[i].nextRun);
+	return qMax(next - now, (qint64)0);
+}
+
+void ScanQueue::finished(int id, qint64 started, qint64 ended, int pointsDone, const QString &result)
+{
+	ScanJob *j = job(id);
+	if (!j)
+		return;
+
+	if (pointsDone > 0 && ended > started)
+	{
+		double ms = (double)(ended - started) / pointsDone;
+		QString key = throughputKey(*j);
+		if (throughput.contains(key))
+			ms = throughput[key] * (1 - THROUGHPUT_WEIGHT) + ms * THROUGHPUT_WEIGHT;
+		throughput[key] = ms;
+	}
+
+	j->runs++;
+	j->lastResult = result;
+	if (j->repeats > 0)
+		j->repeats--;
+
+	if (j->interval <= 0 || j->repeats == 0)
+	{
+		remove(id);
+		return;
+	}
+
+	// runs longer than interval start right after the previous one
+	j->nextRun = qMax(started + j->interval * (qint64)1000, ended);
+}
+
+qint64 ScanQueue::estimate(const ScanJob &job)
+{
+	QString key = throughputKey(job);
+	if (!throughput.contains(key))
+		return -1;
+	return (qint64)(throughput[key] * job.points());
+}
+
+QString ScanQueue::outputFile(const ScanJob &job, const QDateTime &started)
+{
+	QString out = job.output;
+	out.replace("%t", started.toString("yyyyMMdd-hhmmss"));
+	out.replace("%n", QString::number(job.runs + 1));
+	return out;
+}
+
+QJsonObject ScanQueue::toJson(const ScanJob &job)
+{
+	QJsonObject o;
+	o["id"] = job.id;
+	o["name"] = job.name;
+	o["xmin"] = job.xmin;
+	o["xmax"] = job.xmax;
+	o["ymin"] = job.ymin;
+	o["ymax"] = job.ymax;
+	o["mode"] = QString(job.sweep ? "sweep" : "step");
+	o["filter"] = job.filterPreset;
+	o["samples"] = job.samples;
+	o["trimmed"] = job.trimmed;
+	o["interval"] = job.interval;
+	o["repeats"] = job.repeats;
+	o["nextRun"] = QDateTime::fromMSecsSinceEpoch(job.nextRun).toString(Qt::ISODate);
+	o["output"] = job.output;
+	o["runs"] = job.runs;
+	o["lastResult"] = job.lastResult;
+	return o;
+}
+
+bool ScanQueue::fromJson(const QJsonObject &json, ScanJob &job, QString &err)
+{
+	ScanJob j = job;
+	j.name = json.value("name").toString(job.name);
+	j.xmin = json.value("xmin").toInt(job.xmin);
+	j.xmax = json.value("xmax").toInt(job.xmax);
+	j.ymin = json.value("ymin").toInt(job.ymin);
+	j.ymax = json.value("ymax").toInt(job.ymax);
+	QString mode = json.value("mode").toString(job.sweep ? "sweep" : "step");
+	j.sweep = mode == "sweep";
+	j.filterPreset = json.value("filter").toInt(job.filterPreset);
+	j.samples = json.value("samples").toInt(job.samples);
+	j.trimmed = json.value("trimmed").toBool(job.trimmed);
+	j.interval = json.value("interval").toInt(job.interval);
+	j.repeats = json.value("repeats").toInt(job.repeats);
+	j.output = json.value("output").toString(job.output);
+
+	if (json.contains("nextRun"))
+	{
+		QDateTime next = QDateTime::fromString(json.value("nextRun").toString(), Qt::ISODate);
+		if (!next.isValid())
+		{
+			err = tr("Invalid time %1").arg(json.value("nextRun").toString());
+			return false;
+		}
+		j.nextRun = next.toMSecsSinceEpoch();
+	}
+
+	if (mode != "step" && mode != "sweep")
+	{
+		err = tr("Unknown scan mode %1").arg(mode);
+		return false;
+	}
+	if (j.xmin < 0 || j.xmax > 180 || j.xmin > j.xmax || j.ymin < 0 || j.ymax > 180 || j.ymin > j.ymax)
+	{
+		err = tr("Invalid field of view");
+		return false;
+	}
+	if (j.interval < 0 || j.repeats == 0 || j.repeats < -1)
+	{
+		err = tr("Invalid interval or repeat count");
+		return false;
+	}
+	if (j.output.isEmpty())
+	{
+		err = tr("Output file is missing");
+		return false;
+	}
+
+	job = j;
+	return true;
+}
@@ -0,0 +1,100 @@
+#ifndef SCANQUEUE_H_
+#define SCANQUEUE_H_
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+namespace QThermCam
+{
+
+struct ScanJob
+{
+	int id;
+	QString name;
+	int xmin, xmax, ymin, ymax;
+	bool sweep;
+	int filterPreset;
+	int samples;
+	bool trimmed;
+	/* seconds between starts of runs, 0 - run once */
+	int interval;
+	/* runs left, -1 - forever */
+	int repeats;
+	/* ms since epoch */
+	qint64 nextRun;
+	/* %t is replaced by start time, %n by run number; .qtcb - binary,
+	 * anything else - XML */
+	QString output;
+	int runs;
+	QString lastResult;
+
+	ScanJob() : id(0), xmin(0), xmax(180), ymin(0), ymax(180), sweep(false), filterPreset(0), samples(1),
+			trimmed(false), interval(0), repeats(1), nextRun(0), runs(0)
+	{
+	}
+
+	int points() const { return (xmax - xmin + 1) * (ymax - ymin + 1); }
+};
+
+/* Scans waiting to be run, stored in a JSON file after every change, so
+ * the queue survives restarts. Also remembers measured scan speed for each
+ * combination of settings and estimates job durations from it.
+ */
+class ScanQueue
+{
+	Q_DECLARE_TR_FUNCTIONS(ScanQueue)
+
+	QString file;
+	QList<ScanJob> jobs_;
+	int nextId;
+	/* ms per point, by throughputKey */
+	QMap<QString, double> throughput;
+
+	static QString throughputKey(const ScanJob &job);
+
+public:
+	ScanQueue();
+
+	/* missing file is an empty queue */
+	bool load(const QString &file, QString &err);
+
+	bool save(QString &err);
+
+	const QList<ScanJob> &jobs() { return jobs_; }
+
+	/* assigns id */
+	int add(ScanJob job);
+
+	bool remove(int id);
+
+	ScanJob *job(int id);
+
+	/* earliest job which should already run, NULL if none */
+	ScanJob *due(qint64 now);
+
+	/* time left to the next job, -1 if queue is empty */
+	qint64 msToNext(qint64 now);
+
+	/* records speed of the run and schedules the next one or drops the job */
+	void finished(int id, qint64 started, qint64 ended, int pointsDone, const QString &result);
+
+	/* ms, -1 if scans with these settings were not measured yet */
+	qint64 estimate(const ScanJob &job);
+
+	QString outputFile(const ScanJob &job, const QDateTime &started);
+
+	static QJsonObject toJson(const ScanJob &job);
+
+	/* Settings of job as sent by clients, fields missing in json are taken
+	 * from job. Id, runs and lastResult are kept, they are read only by load.
+	 */
+	static bool fromJson(const QJsonObject &json, ScanJob &job, QString &err);
+};
+
+}
+
+#endif /* SCANQUEUE_H_ */
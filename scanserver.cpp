@@ -0,0 +1,919 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "scanserver.h"
+#include "deviceprobe.h"
+#include "drift.h"
+#include "framefile.h"
+#include "thermcam.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QTextStream>
+#include <QTimer>
+
+#include <string.h>
+
+using namespace QThermCam;
+
+ScanServer::ScanServer(QObject *parent) : QObject(parent), waitingForDevice(false), devXmin(-1), devXmax(-1),
+		devYmin(-1), devYmax(-1), rowsDone(0), runningJob(-1), jobStarted(0)
+{
+	server = new QLocalServer(this);
+	connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+	cam = new ThermCam(this);
+	connect(cam, SIGNAL(scannerReady(int, int, int, int)), this, SLOT(scannerReady(int, int, int, int)));
+	connect(cam, SIGNAL(samplesRead(int, int, const QVector<float> &)), this, SLOT(samplesRead(int, int, const QVector<float> &)));
+	connect(cam, SIGNAL(variancesRead(int, int, const QVector<float> &)), this, SLOT(variancesRead(int, int, const QVector<float> &)));
+	connect(cam, SIGNAL(pointRescanned(int, int)), this, SLOT(pointRescanned(int, int)));
+	connect(cam, SIGNAL(rowAmbientRead(int, float)), this, SLOT(rowAmbientRead(int, float)));
+	connect(cam, SIGNAL(rowScanned(int, const QVector<float> &)), this, SLOT(rowScanned(int, const QVector<float> &)));
+	connect(cam, SIGNAL(scanningStopped()), this, SLOT(scanningStopped()));
+	connect(cam, SIGNAL(connectionLost()), this, SLOT(connectionLost()));
+	connect(cam, SIGNAL(reconnected()), this, SLOT(reconnected()));
+	connect(cam, SIGNAL(debug(const QString &)), this, SLOT(logDebug(const QString &)));
+	connect(cam, SIGNAL(info(const QString &)), this, SLOT(logInfo(const QString &)));
+	connect(cam, SIGNAL(warning(const QString &)), this, SLOT(logWarning(const QString &)));
+	connect(cam, SIGNAL(error(const QString &)), this, SLOT(logError(const QString &)));
+
+	queueTimer = new QTimer(this);
+	queueTimer->setSingleShot(true);
+	connect(queueTimer, SIGNAL(timeout()), this, SLOT(runJobs()));
+
+	probe = new DeviceProbe(this);
+	connect(probe, SIGNAL(deviceFound(const QString &, int, int, int, int)),
+			this, SLOT(deviceFound(const QString &, int, int, int, int)));
+	connect(probe, SIGNAL(finished()), this, SLOT(probeFinished()));
+	connect(probe, SIGNAL(debug(const QString &)), this, SLOT(logDebug(const QString &)));
+
+	// starts with whatever was used in the GUI last time
+	QSettings settings;
+	xmin = settings.value("xmin", 0).toInt();
+	xmax = settings.value("xmax", 180).toInt();
+	ymin = settings.value("ymin", 0).toInt();
+	ymax = settings.value("ymax", 180).toInt();
+	sweep = settings.value("sweepMode", false).toBool();
+	rawMode = settings.value("rawMode", false).toBool();
+	filterPreset = qBound(0, settings.value("filterPreset", 0).toInt(), FILTER_PRESET_COUNT - 1);
+	samplesPerPoint = settings.value("samplesPerPoint", 1).toInt();
+	trimmedMean = settings.value("trimmedMean", false).toBool();
+	ambientInterval = settings.value("ambientInterval", 1).toInt();
+	calibration = Calibration::fromSettings();
+	applyConfig();
+}
+
+ScanServer::~ScanServer()
+{
+	if (cam->connected() || cam->reconnecting())
+		cam->doDisconnect();
+}
+
+bool ScanServer::listen(const QString &name, QString &err)
+{
+	// socket left by a crashed daemon has to be removed, a live one not
+	QLocalSocket probeSocket;
+	probeSocket.connectToServer(name);
+	if (probeSocket.waitForConnected(500))
+	{
+		err = tr("Other daemon already listens on %1").arg(name);
+		return false;
+	}
+	QLocalServer::removeServer(name);
+
+	// clients can write files where the daemon can, so only its owner may
+	// connect
+	server->setSocketOptions(QLocalServer::UserAccessOption);
+	if (!server->listen(name))
+	{
+		err = tr("Cannot listen on %1: %2").arg(name).arg(server->errorString());
+		return false;
+	}
+	logInfo(tr("Listening on %1").arg(server->fullServerName()));
+	return true;
+}
+
+bool ScanServer::setOutputDir(const QString &dir, QString &err)
+{
+	if (!QDir().mkpath(dir))
+	{
+		err = tr("Cannot create directory %1").arg(dir);
+		return false;
+	}
+	outputDir = QFileInfo(dir).canonicalFilePath();
+	return true;
+}
+
+static bool insideDir(const QString &path, const QString &dir)
+{
+	QString c = QFileInfo(path).canonicalFilePath();
+	return c == dir || c.startsWith(dir + "/");
+}
+
+/* Resolves file name given by client relative to output directory. Fails
+ * for paths leading out of it, also through symlinks. With create, makes
+ * missing directories.
+ */
+bool ScanServer::outputPath(const QString &file, QString &path, bool create, QString &err)
+{
+	if (file.isEmpty())
+	{
+		err = tr("File name is missing");
+		return false;
+	}
+
+	path = QDir::cleanPath(QDir::isAbsolutePath(file) ? file : outputDir + "/" + file);
+	if (!path.startsWith(outputDir + "/"))
+	{
+		err = tr("Files can be saved only in %1").arg(outputDir);
+		return false;
+	}
+
+	QString existing = QFileInfo(path).path();
+	while (!QFileInfo(existing).exists())
+		existing = QFileInfo(existing).path();
+	if (!insideDir(existing, outputDir) ||
+			(create && (!QDir().mkpath(QFileInfo(path).path()) || !insideDir(QFileInfo(path).path(), outputDir))))
+	{
+		err = tr("Files can be saved only in %1").arg(outputDir);
+		return false;
+	}
+	return true;
+}
+
+bool ScanServer::publish(const QString &name, QString &err)
+{
+	if (!shm.open(name, err))
+		return false;
+	logInfo(tr("Frames are published in shared memory %1").arg(name));
+	return true;
+}
+
+bool ScanServer::loadQueue(const QString &file, QString &err)
+{
+	if (!queue.load(file, err))
+		return false;
+	logInfo(tr("%n job(s) queued in %1", "", queue.jobs().size()).arg(file));
+	runJobs();
+	return true;
+}
+
+void ScanServer::saveQueue()
+{
+	QString err;
+	if (!queue.save(err))
+		logError(err);
+}
+
+/* starts the first job which is due, or waits for it */
+void ScanServer::runJobs()
+{
+	queueTimer->stop();
+	if (runningJob != -1 || cam->scanInProgress() || !cam->connected() || devXmin == -1)
+		return;
+
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+	ScanJob *job = queue.due(now);
+	if (!job)
+	{
+		qint64 ms = queue.msToNext(now);
+		if (ms >= 0)
+			queueTimer->start((int)qMin(ms, (qint64)MAX_QUEUE_WAIT));
+		return;
+	}
+
+	// job settings stay in effect after it, like after configure
+	// output was checked when the job was queued, but output directory
+	// could change since then
+	QString err;
+	QString file;
+	if (!outputPath(queue.outputFile(*job, QDateTime::fromMSecsSinceEpoch(now)), file, true, err) ||
+			!configure(ScanQueue::toJson(*job), err) || !startScan(err))
+	{
+		logError(tr("Job %1 (%2) cannot be started: %3").arg(job->id).arg(job->name).arg(err));
+		queue.finished(job->id, now, now, 0, err);
+		saveQueue();
+		QTimer::singleShot(0, this, SLOT(runJobs()));
+		return;
+	}
+
+	runningJob = job->id;
+	jobStarted = now;
+	saveFile = file;
+	if (!job->name.isEmpty())
+		frame.metadata["job"] = job->name;
+
+	qint64 estimate = queue.estimate(*job);
+	if (estimate >= 0)
+		logInfo(tr("Job %1 (%2) started, it should take %3 min").arg(job->id).arg(job->name)
+				.arg(estimate / 60000.0, 0, 'f', 1));
+	else
+		logInfo(tr("Job %1 (%2) started").arg(job->id).arg(job->name));
+
+	QJsonObject event;
+	event["event"] = QString("jobStarted");
+	event["job"] = ScanQueue::toJson(*job);
+	broadcast(event);
+}
+
+void ScanServer::jobDone(bool complete, const QString &saveError)
+{
+	QString result;
+	if (!saveError.isEmpty())
+		result = saveError;
+	else if (!complete)
+		result = tr("incomplete, saved to %1").arg(saveFile);
+	else
+		result = tr("saved to %1").arg(saveFile);
+
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+	queue.finished(runningJob, jobStarted, now, rowsDone * frame.width(), result);
+	saveQueue();
+
+	QJsonObject event;
+	event["event"] = QString("jobFinished");
+	event["id"] = runningJob;
+	event["result"] = result;
+	broadcast(event);
+	runningJob = -1;
+}
+
+QJsonObject ScanServer::queueJson()
+{
+	QJsonObject q;
+	QJsonArray jobs;
+	qint64 total = 0;
+	bool known = true;
+	for (int i = 0; i < queue.jobs().size(); ++i)
+	{
+		const ScanJob &job = queue.jobs()[i];
+		QJsonObject j = ScanQueue::toJson(job);
+		qint64 estimate = queue.estimate(job);
+		if (estimate >= 0)
+		{
+			j["estimatedMs"] = estimate;
+			total += estimate;
+		}
+		else
+			known = false;
+		jobs.append(j);
+	}
+	q["jobs"] = jobs;
+	q["running"] = runningJob;
+	// estimate of one run of every job
+	if (known)
+		q["estimatedMs"] = total;
+	return q;
+}
+
+bool ScanServer::connectDevice(const QString &p, QString &err)
+{
+	if (cam->connected() || cam->reconnecting())
+	{
+		err = tr("Already connected to %1").arg(path);
+		return false;
+	}
+
+	if (p.isEmpty())
+	{
+		waitingForDevice = true;
+		probe->probeAll();
+		return true;
+	}
+
+	if (!cam->doConnect(p))
+	{
+		err = tr("Cannot connect to %1").arg(p);
+		return false;
+	}
+
+	waitingForDevice = false;
+	path = p;
+	devXmin = devXmax = devYmin = devYmax = -1;
+	logInfo(tr("%1: connected").arg(path));
+
+	QJsonObject event;
+	event["event"] = QString("connected");
+	event["path"] = path;
+	broadcast(event);
+	return true;
+}
+
+void ScanServer::deviceFound(const QString &p, int, int, int, int)
+{
+	if (!waitingForDevice)
+		return;
+
+	QString err;
+	if (!connectDevice(p, err))
+		logError(err);
+}
+
+void ScanServer::probeFinished()
+{
+	if (!waitingForDevice)
+		return;
+	waitingForDevice = false;
+	logWarning(tr("No device found"));
+}
+
+void ScanServer::applyConfig()
+{
+	QSettings settings;
+	// rate is limited by the firmware to 5..1000 ms per degree
+	int rate = qBound(5, settings.value("sweepRate", 20).toInt(), 1000);
+	int lag = settings.value("sweepLag", 30).toInt();
+	cam->setScanMode(sweep ? ThermCam::ScanSweep : ThermCam::ScanStep, rate, lag);
+	cam->setRawMode(rawMode);
+	cam->setCalibration(calibration);
+	cam->setFilter(filterPresets[filterPreset]);
+	cam->setSampling(samplesPerPoint, trimmedMean);
+	cam->setAmbientInterval(ambientInterval);
+}
+
+/* Changes only settings present in the request, nothing if any is invalid. */
+bool ScanServer::configure(const QJsonObject &req, QString &err)
+{
+	if (cam->scanInProgress())
+	{
+		err = tr("Cannot configure during scan");
+		return false;
+	}
+
+	int x0 = req.value("xmin").toInt(xmin), x1 = req.value("xmax").toInt(xmax);
+	int y0 = req.value("ymin").toInt(ymin), y1 = req.value("ymax").toInt(ymax);
+	int lx = devXmin == -1 ? 0 : devXmin, hx = devXmin == -1 ? 180 : devXmax;
+	int ly = devYmin == -1 ? 0 : devYmin, hy = devYmin == -1 ? 180 : devYmax;
+	if (x0 < lx || x1 > hx || x0 > x1 || y0 < ly || y1 > hy || y0 > y1)
+	{
+		err = tr("Invalid field of view, device allows x %1 - %2, y %3 - %4").arg(lx).arg(hx).arg(ly).arg(hy);
+		return false;
+	}
+
+	QString mode = req.value("mode").toString(sweep ? "sweep" : "step");
+	if (mode != "step" && mode != "sweep")
+	{
+		err = tr("Unknown scan mode %1").arg(mode);
+		return false;
+	}
+
+	int preset = req.value("filter").toInt(filterPreset);
+	if (preset < 0 || preset >= FILTER_PRESET_COUNT)
+	{
+		err = tr("Filter preset has to be 0 - %1").arg(FILTER_PRESET_COUNT - 1);
+		return false;
+	}
+
+	// firmware keeps at most 16 readings
+	int samples = req.value("samples").toInt(samplesPerPoint);
+	if (samples < 1 || samples > 16)
+	{
+		err = tr("Readings per point have to be 1 - 16");
+		return false;
+	}
+
+	int interval = req.value("ambientInterval").toInt(ambientInterval);
+	if (interval < 0)
+	{
+		err = tr("Invalid ambient temperature interval");
+		return false;
+	}
+
+	double emissivity = req.value("emissivity").toDouble(calibration.emissivity());
+	if (emissivity < 0.01 || emissivity > 1.0)
+	{
+		err = tr("Emissivity has to be 0.01 - 1");
+		return false;
+	}
+
+	xmin = x0;
+	xmax = x1;
+	ymin = y0;
+	ymax = y1;
+	sweep = mode == "sweep";
+	filterPreset = preset;
+	samplesPerPoint = samples;
+	trimmedMean = req.value("trimmed").toBool(trimmedMean);
+	ambientInterval = interval;
+	rawMode = req.value("raw").toBool(rawMode);
+	calibration = Calibration(emissivity, req.value("reflected").toDouble(calibration.reflected()),
+			req.value("offset").toDouble(calibration.offset()));
+	applyConfig();
+	return true;
+}
+
+bool ScanServer::startScan(QString &err)
+{
+	if (!cam->connected())
+	{
+		err = tr("Not connected");
+		return false;
+	}
+	if (devXmin == -1)
+	{
+		err = tr("Device is not ready yet");
+		return false;
+	}
+	if (cam->scanInProgress())
+	{
+		err = tr("Scan is already in progress");
+		return false;
+	}
+
+	frame.reset(xmin, xmax, ymin, ymax);
+	frame.metadata["scanStarted"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+	frame.metadata["device"] = path;
+	frame.metadata["scanMode"] = sweep ? "sweep" : "step";
+	if (samplesPerPoint > 1)
+		frame.metadata["readingsPerPoint"] = QString("%1 (%2)").arg(samplesPerPoint)
+				.arg(trimmedMean ? "trimmed mean" : "median");
+	frame.metadata["calibration"] = QString("emissivity=%1 reflected=%2 offset=%3").arg(calibration.emissivity())
+			.arg(calibration.reflected()).arg(calibration.offset());
+	rowsDone = 0;
+	shm.startFrame(xmin, xmax, ymin, ymax, QDateTime::currentMSecsSinceEpoch());
+
+	cam->scanImage(xmin, xmax, ymin, ymax);
+
+	QJsonObject event;
+	event["event"] = QString("scanStarted");
+	event["xmin"] = xmin;
+	event["xmax"] = xmax;
+	event["ymin"] = ymin;
+	event["ymax"] = ymax;
+	broadcast(event);
+	return true;
+}
+
+bool ScanServer::saveFrame(const QString &file, QString &err)
+{
+	if (frame.isEmpty())
+	{
+		err = tr("Nothing was scanned");
+		return false;
+	}
+	if (file.isEmpty())
+	{
+		err = tr("File name is missing");
+		return false;
+	}
+	if (!FrameFile::save(file, frame, err))
+		return false;
+	logInfo(tr("File %1 saved").arg(file));
+	return true;
+}
+
+QJsonObject ScanServer::status()
+{
+	QJsonObject s;
+	s["connected"] = cam->connected();
+	s["reconnecting"] = cam->reconnecting();
+	s["path"] = path;
+	s["scanning"] = cam->scanInProgress();
+	if (devXmin != -1)
+	{
+		QJsonObject dims;
+		dims["xmin"] = devXmin;
+		dims["xmax"] = devXmax;
+		dims["ymin"] = devYmin;
+		dims["ymax"] = devYmax;
+		s["device"] = dims;
+	}
+	s["xmin"] = xmin;
+	s["xmax"] = xmax;
+	s["ymin"] = ymin;
+	s["ymax"] = ymax;
+	s["mode"] = QString(sweep ? "sweep" : "step");
+	s["raw"] = rawMode;
+	s["filter"] = filterPreset;
+	s["samples"] = samplesPerPoint;
+	s["trimmed"] = trimmedMean;
+	s["ambientInterval"] = ambientInterval;
+	s["emissivity"] = calibration.emissivity();
+	s["reflected"] = calibration.reflected();
+	s["offset"] = calibration.offset();
+	s["rowsDone"] = rowsDone;
+	s["rowsTotal"] = frame.isEmpty() ? 0 : frame.height();
+	if (shm.isOpen())
+		s["shm"] = shm.name();
+	return s;
+}
+
+/* not measured points are null */
+QJsonObject ScanServer::frameJson()
+{
+	QJsonObject f;
+	f["xmin"] = frame.xmin;
+	f["xmax"] = frame.xmax;
+	f["ymin"] = frame.ymin;
+	f["ymax"] = frame.ymax;
+
+	QJsonArray data;
+	for (int i = 0; i < frame.data.size(); ++i)
+		data.append(frame.data[i] == -1000 ? QJsonValue() : QJsonValue(frame.data[i]));
+	f["data"] = data;
+
+	if (!frame.variance.isEmpty())
+	{
+		QJsonArray variance;
+		for (int i = 0; i < frame.variance.size(); ++i)
+			variance.append(frame.variance[i] < 0 ? QJsonValue() : QJsonValue(frame.variance[i]));
+		f["variance"] = variance;
+	}
+
+	QJsonObject metadata;
+	for (QMap<QString, QString>::const_iterator it = frame.metadata.constBegin(); it != frame.metadata.constEnd(); ++it)
+		metadata[it.key()] = it.value();
+	f["metadata"] = metadata;
+	return f;
+}
+
+void ScanServer::newConnection()
+{
+	while (QLocalSocket *client = server->nextPendingConnection())
+	{
+		clients.append(client);
+		connect(client, SIGNAL(readyRead()), this, SLOT(clientReadable()));
+		connect(client, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+	}
+}
+
+void ScanServer::clientDisconnected()
+{
+	QLocalSocket *client = qobject_cast<QLocalSocket *>(sender());
+	clients.removeAll(client);
+	subscribers.removeAll(client);
+	// scan goes on, nobody has to watch it
+	client->deleteLater();
+}
+
+void ScanServer::clientReadable()
+{
+	QLocalSocket *client = qobject_cast<QLocalSocket *>(sender());
+	while (client->canReadLine())
+	{
+		QByteArray line = client->readLine(MAX_REQUEST).trimmed();
+		if (line.isEmpty())
+			continue;
+
+		QJsonParseError parseError;
+		QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+		if (!doc.isObject())
+		{
+			replyError(client, QJsonObject(), tr("Invalid request: %1").arg(parseError.errorString()));
+			continue;
+		}
+		handle(client, doc.object());
+	}
+
+	if (client->bytesAvailable() > MAX_REQUEST)
+	{
+		logWarning(tr("Client sent too long request, disconnecting it"));
+		client->abort();
+	}
+}
+
+void ScanServer::handle(QLocalSocket *client, const QJsonObject &req)
+{
+	QString cmd = req.value("cmd").toString();
+	QString err;
+
+	if (cmd == "connect")
+	{
+		if (!connectDevice(req.value("path").toString(), err))
+			replyError(client, req, err);
+		else
+			reply(client, req, status());
+	}
+	else if (cmd == "disconnect")
+	{
+		if (!cam->connected() && !cam->reconnecting())
+		{
+			replyError(client, req, tr("Not connected"));
+			return;
+		}
+		if (cam->scanInProgress())
+			cam->stopScanning();
+		cam->doDisconnect();
+		logInfo(tr("%1: disconnected").arg(path));
+		path.clear();
+		devXmin = devXmax = devYmin = devYmax = -1;
+		reply(client, req, status());
+	}
+	else if (cmd == "configure")
+	{
+		if (!configure(req, err))
+			replyError(client, req, err);
+		else
+			reply(client, req, status());
+	}
+	else if (cmd == "scan")
+	{
+		QString save;
+		if (req.contains("save") && !outputPath(req.value("save").toString(), save, true, err))
+		{
+			replyError(client, req, err);
+			return;
+		}
+		if (!startScan(err))
+			replyError(client, req, err);
+		else
+		{
+			saveFile = save;
+			reply(client, req, status());
+		}
+	}
+	else if (cmd == "stop")
+	{
+		if (!cam->scanInProgress())
+		{
+			replyError(client, req, tr("Not scanning"));
+			return;
+		}
+		cam->stopScanning();
+		reply(client, req, status());
+	}
+	else if (cmd == "status")
+		reply(client, req, status());
+	else if (cmd == "subscribe")
+	{
+		if (!subscribers.contains(client))
+			subscribers.append(client);
+		reply(client, req, QJsonObject());
+	}
+	else if (cmd == "unsubscribe")
+	{
+		subscribers.removeAll(client);
+		reply(client, req, QJsonObject());
+	}
+	else if (cmd == "frame")
+		reply(client, req, frameJson());
+	else if (cmd == "save")
+	{
+		QString file;
+		if (!outputPath(req.value("file").toString(), file, true, err) || !saveFrame(file, err))
+			replyError(client, req, err);
+		else
+			reply(client, req, QJsonObject());
+	}
+	else if (cmd == "enqueue")
+	{
+		ScanJob job;
+		job.xmin = xmin;
+		job.xmax = xmax;
+		job.ymin = ymin;
+		job.ymax = ymax;
+		job.sweep = sweep;
+		job.filterPreset = filterPreset;
+		job.samples = samplesPerPoint;
+		job.trimmed = trimmedMean;
+		job.nextRun = QDateTime::currentMSecsSinceEpoch();
+		if (!ScanQueue::fromJson(req, job, err))
+		{
+			replyError(client, req, err);
+			return;
+		}
+		// firmware keeps at most 16 readings
+		if (job.filterPreset < 0 || job.filterPreset >= FILTER_PRESET_COUNT || job.samples < 1 || job.samples > 16)
+		{
+			replyError(client, req, tr("Invalid filter preset or readings per point"));
+			return;
+		}
+		// %t and %n don't add directories, so any expansion will do; the
+		// pattern is kept absolute
+		QString file;
+		if (!outputPath(queue.outputFile(job, QDateTime::currentDateTime()), file, false, err))
+		{
+			replyError(client, req, err);
+			return;
+		}
+		job.output = QDir::cleanPath(QDir::isAbsolutePath(job.output) ? job.output : outputDir + "/" + job.output);
+
+		int id = queue.add(job);
+		saveQueue();
+		QJsonObject r;
+		r["job"] = ScanQueue::toJson(*queue.job(id));
+		qint64 estimate = queue.estimate(*queue.job(id));
+		if (estimate >= 0)
+			r["estimatedMs"] = estimate;
+		reply(client, req, r);
+		runJobs();
+	}
+	else if (cmd == "dequeue")
+	{
+		// running scan goes on, it just won't be repeated
+		if (!queue.remove(req.value("job").toInt()))
+		{
+			replyError(client, req, tr("No job %1").arg(req.value("job").toInt()));
+			return;
+		}
+		saveQueue();
+		reply(client, req, queueJson());
+	}
+	else if (cmd == "queue")
+		reply(client, req, queueJson());
+	else
+		replyError(client, req, tr("Unknown command %1").arg(cmd));
+}
+
+void ScanServer::reply(QLocalSocket *client, const QJsonObject &req, QJsonObject r)
+{
+	r["ok"] = true;
+	if (req.contains("id"))
+		r["id"] = req.value("id");
+	send(client, r);
+}
+
+void ScanServer::replyError(QLocalSocket *client, const QJsonObject &req, const QString &err)
+{
+	QJsonObject r;
+	r["ok"] = false;
+	r["error"] = err;
+	if (req.contains("id"))
+		r["id"] = req.value("id");
+	send(client, r);
+}
+
+void ScanServer::send(QLocalSocket *client, const QJsonObject &obj)
+{
+	client->write(QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ScanServer::broadcast(const QJsonObject &event)
+{
+	if (subscribers.isEmpty())
+		return;
+	QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact) + '\n';
+	for (int i = 0; i < subscribers.size(); ++i)
+		subscribers[i]->write(line);
+}
+
+void ScanServer::scannerReady(int _xmin, int _xmax, int _ymin, int _ymax)
+{
+	devXmin = _xmin;
+	devXmax = _xmax;
+	devYmin = _ymin;
+	devYmax = _ymax;
+
+	// field of view saved by GUI connected to other device may not fit
+	xmin = qBound(devXmin, xmin, devXmax);
+	xmax = qBound(xmin, xmax, devXmax);
+	ymin = qBound(devYmin, ymin, devYmax);
+	ymax = qBound(ymin, ymax, devYmax);
+
+	QJsonObject event;
+	event["event"] = QString("ready");
+	event["status"] = status();
+	broadcast(event);
+
+	runJobs();
+}
+
+void ScanServer::samplesRead(int x, int y, const QVector<float> &temps)
+{
+	if (frame.isEmpty() || y < frame.ymin || y > frame.ymax || x < frame.xmin || x + temps.size() - 1 > frame.xmax)
+		return;
+	float *row = frame.data.data() + (y - frame.ymin) * frame.width() + (x - frame.xmin);
+	memcpy(row, temps.constData(), temps.size() * sizeof(float));
+	shm.setTemperatures(x, y, temps.constData(), temps.size());
+
+	if (subscribers.isEmpty())
+		return;
+	QJsonObject event;
+	event["event"] = QString("samples");
+	event["x"] = x;
+	event["y"] = y;
+	QJsonArray values;
+	for (int i = 0; i < temps.size(); ++i)
+		values.append(temps[i]);
+	event["temps"] = values;
+	broadcast(event);
+}
+
+void ScanServer::variancesRead(int x, int y, const QVector<float> &variances)
+{
+	if (frame.isEmpty() || y < frame.ymin || y > frame.ymax || x < frame.xmin ||
+			x + variances.size() - 1 > frame.xmax)
+		return;
+	if (frame.variance.isEmpty())
+		frame.variance.fill(-1, frame.data.size());
+	float *row = frame.variance.data() + (y - frame.ymin) * frame.width() + (x - frame.xmin);
+	memcpy(row, variances.constData(), variances.size() * sizeof(float));
+}
+
+void ScanServer::pointRescanned(int x, int y)
+{
+	if (!frame.rescanned.contains(QPoint(x, y)))
+		frame.rescanned.append(QPoint(x, y));
+}
+
+void ScanServer::rowAmbientRead(int y, float temp)
+{
+	Drift::addRowAmbient(frame.metadata, y, temp);
+}
+
+void ScanServer::rowScanned(int y, const QVector<float> &)
+{
+	rowsDone++;
+	shm.rowDone(y);
+
+	QJsonObject event;
+	event["event"] = QString("row");
+	event["y"] = y;
+	event["rowsDone"] = rowsDone;
+	event["rowsTotal"] = frame.height();
+	broadcast(event);
+}
+
+void ScanServer::scanningStopped()
+{
+	QJsonObject event;
+	event["event"] = QString("scanFinished");
+	event["complete"] = rowsDone >= frame.height();
+	event["rowsDone"] = rowsDone;
+	shm.finishFrame(rowsDone >= frame.height());
+
+	QString err;
+	if (!saveFile.isEmpty())
+	{
+		if (saveFrame(saveFile, err))
+			event["saved"] = saveFile;
+		else
+		{
+			logError(err);
+			event["saveError"] = err;
+		}
+	}
+	broadcast(event);
+
+	if (runningJob != -1)
+		jobDone(rowsDone >= frame.height(), err);
+	saveFile.clear();
+
+	// scan requested by client could have delayed the queue
+	QTimer::singleShot(0, this, SLOT(runJobs()));
+}
+
+void ScanServer::connectionLost()
+{
+	QJsonObject event;
+	event["event"] = QString("connectionLost");
+	broadcast(event);
+}
+
+void ScanServer::reconnected()
+{
+	QJsonObject event;
+	event["event"] = QString("reconnected");
+	broadcast(event);
+}
+
+// log goes to stderr and to subscribers
+void ScanServer::broadcastLog(const QString &level, const QString &msg)
+{
+	QTextStream(stderr) << level << ": " << msg << endl;
+
+	QJsonObject event;
+	event["event"] = QString("log");
+	event["level"] = level;
+	event["message"] = msg;
+	broadcast(event);
+}
+
+void ScanServer::logDebug(const QString &msg)
+{
+	broadcastLog("debug", msg);
+}
+
+void ScanServer::logInfo(const QString &msg)
+{
+	broadcastLog("info", msg);
+}
+
+void ScanServer::logWarning(const QString &msg)
+{
+	broadcastLog("warning", msg);
+}
+
+void ScanServer::logError(const QString &msg)
+{
+	broadcastLog("error", msg);
+}
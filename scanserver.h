@@ -0,0 +1,150 @@
+#ifndef SCANSERVER_H_
+#define SCANSERVER_H_
+
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+#include "calibration.h"
+#include "frameshm.h"
+#include "scanqueue.h"
+#include "thermframe.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+
+namespace QThermCam
+{
+
+class DeviceProbe;
+class ThermCam;
+
+/* Owns scanner connection and scanned frame in qthermcamd, controlled by
+ * clients of a local socket. Every request and reply is one line of JSON:
+ *
+ *   {"cmd": "connect", "path": "/dev/ttyACM0"}   path is optional - probe
+ *   {"cmd": "disconnect"}
+ *   {"cmd": "configure", "xmin": 40, "xmax": 140, "mode": "sweep", ...}
+ *   {"cmd": "scan", "save": "roof/scan.qtcb"}    save is optional
+ *   {"cmd": "stop"}
+ *   {"cmd": "status"}
+ *   {"cmd": "subscribe"}                         stream events to client
+ *   {"cmd": "frame"}
+ *   {"cmd": "save", "file": "scan.qtcd"}
+ *   {"cmd": "enqueue", "name": "roof", "xmin": 40, "interval": 3600,
+ *    "repeats": -1, "output": "roof-%t.qtcb"}   see ScanJob
+ *   {"cmd": "dequeue", "job": 3}
+ *   {"cmd": "queue"}
+ *
+ * Files are saved in the output directory, paths leading out of it are
+ * rejected. Replies have "ok" and, on failure, "error"; "id" of request is
+ * copied.
+ * Subscribers also get {"event": ...} lines: samples, row, scanStarted,
+ * scanFinished, ready, jobStarted, jobFinished, connected, connectionLost, log. Frames being scanned are also
+ * published in shared memory, see FrameShm.
+ */
+class ScanServer : public QObject
+{
+	Q_OBJECT
+	/* longest request line, protects against clients sending garbage */
+	enum { MAX_REQUEST = 64 * 1024 };
+	/* queue is checked at least that often, clock may be changed */
+	enum { MAX_QUEUE_WAIT = 60 * 1000 };
+
+	QLocalServer *server;
+	QList<QLocalSocket *> clients, subscribers;
+
+	ThermCam *cam;
+	DeviceProbe *probe;
+	/* connect to the first device probe finds */
+	bool waitingForDevice;
+	QString path;
+	/* limits reported by device, -1 until it's ready */
+	int devXmin, devXmax, devYmin, devYmax;
+
+	/* configuration of the next scan */
+	int xmin, xmax, ymin, ymax;
+	bool sweep, rawMode, trimmedMean;
+	int filterPreset, samplesPerPoint, ambientInterval;
+	Calibration calibration;
+
+	ThermFrame frame;
+	int rowsDone;
+	/* where frame is saved when the current scan finishes */
+	QString saveFile;
+	/* clients can save files only here, canonical path */
+	QString outputDir;
+	/* live copy of scanned frames for other processes */
+	FrameShm shm;
+
+	ScanQueue queue;
+	QTimer *queueTimer;
+	/* id of job being scanned, -1 if none */
+	int runningJob;
+	qint64 jobStarted;
+
+	void handle(QLocalSocket *client, const QJsonObject &req);
+	void reply(QLocalSocket *client, const QJsonObject &req, QJsonObject r);
+	void replyError(QLocalSocket *client, const QJsonObject &req, const QString &err);
+	void send(QLocalSocket *client, const QJsonObject &obj);
+	void broadcast(const QJsonObject &event);
+	void broadcastLog(const QString &level, const QString &msg);
+
+	bool configure(const QJsonObject &req, QString &err);
+	void applyConfig();
+	bool startScan(QString &err);
+	bool outputPath(const QString &file, QString &path, bool create, QString &err);
+	bool saveFrame(const QString &file, QString &err);
+	QJsonObject status();
+	QJsonObject frameJson();
+	QJsonObject queueJson();
+	void saveQueue();
+	void jobDone(bool complete, const QString &saveError);
+
+public:
+	ScanServer(QObject *parent);
+	~ScanServer();
+
+	/* socket is accessible only to the user running the daemon */
+	bool listen(const QString &name, QString &err);
+
+	bool setOutputDir(const QString &dir, QString &err);
+
+	/* frames will be published in POSIX shared memory object name */
+	bool publish(const QString &name, QString &err);
+
+	/* jobs are kept in file and run when device is connected and idle */
+	bool loadQueue(const QString &file, QString &err);
+
+	/* empty path - probes ports and connects to the first device found */
+	bool connectDevice(const QString &path, QString &err);
+
+private slots:
+	void newConnection();
+	void clientReadable();
+	void clientDisconnected();
+
+	void deviceFound(const QString &path, int xmin, int xmax, int ymin, int ymax);
+	void probeFinished();
+	void scannerReady(int xmin, int xmax, int ymin, int ymax);
+	void samplesRead(int x, int y, const QVector<float> &temps);
+	void variancesRead(int x, int y, const QVector<float> &variances);
+	void pointRescanned(int x, int y);
+	void rowAmbientRead(int y, float temp);
+	void rowScanned(int y, const QVector<float> &temps);
+	void scanningStopped();
+	void connectionLost();
+	void reconnected();
+	void runJobs();
+
+	void logDebug(const QString &msg);
+	void logInfo(const QString &msg);
+	void logWarning(const QString &msg);
+	void logError(const QString &msg);
+};
+
+}
+
+#endif /* SCANSERVER_H_ */
@@ -0,0 +1,464 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* .qtcs - QThermCam series file. All numbers are little endian.
+ *
+ * header, 40 bytes:
+ *   char    magic[4]       "QTCS"
+ *   uint16  version        QTCS_VERSION, readers reject newer versions
+ *   uint16  keyInterval    every keyInterval-th frame is a keyframe
+ *   int16   xmin, xmax, ymin, ymax
+ *   uint32  frameCount     valid only if indexOffset != 0
+ *   uint32  reserved
+ *   uint64  indexOffset    0 while file is being written
+ *   uint64  reserved
+ *
+ * followed by frame records:
+ *   char    tag[4]         "KEYF" or "DELT"
+ *   uint32  size           of payload
+ *   int64   timestamp      milliseconds since epoch
+ *   payload                width * height varints
+ *
+ * and index:
+ *   char    tag[4]         "INDX"
+ *   uint32  count
+ *   count * { uint64 offset of frame record, int64 timestamp }
+ *
+ * Samples are stored as hundredths of degree (the sensor has 0.02 C
+ * resolution), -100000 means "not measured". Every value is coded as
+ * zigzag LEB128 varint of difference against a prediction: previous sample
+ * of the same frame for keyframes, the same sample of the previous frame for
+ * delta frames. Decoding any frame needs at most keyInterval frames.
+ *
+ * If the writer didn't finish (indexOffset is 0), readers recover the index
+ * by walking frame records.
+ */
+
+#include "series.h"
+
+#include <QDateTime>
+#include <QtEndian>
+
+#include <stddef.h>
+#include <string.h>
+
+using namespace QThermCam;
+
+#define QTCS_VERSION 1
+
+struct QtcsHeader
+{
+	char magic[4];
+	quint16 version;
+	quint16 keyInterval;
+	qint16 xmin, xmax, ymin, ymax;
+	quint32 frameCount;
+	quint32 reserved;
+	quint64 indexOffset;
+	quint64 reserved2;
+};
+
+struct QtcsFrameHeader
+{
+	char tag[4];
+	quint32 size;
+	qint64 timestamp;
+};
+
+static inline qint32 quantize(float t)
+{
+	return qRound(t * 100);
+}
+
+static void putVarint(QByteArray &out, qint32 v)
+{
+	quint32 u = ((quint32)v << 1) ^ (quint32)(v >> 31);
+	while (u >= 0x80)
+	{
+		out += (char)(u | 0x80);
+		u >>= 7;
+	}
+	out += (char)u;
+}
+
+static bool getVarint(const uchar *&p, const uchar *end, qint32 &v)
+{
+	quint32 u = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (p >= end)
+			return false;
+		uchar b = *p++;
+		u |= (quint32)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+		{
+			v = (qint32)(u >> 1) ^ -(qint32)(u & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+SeriesReader::SeriesReader() : base(NULL), size(0), end(0), xmin(0), xmax(-1), ymin(0), ymax(-1), keyInterval(1),
+		cachedIndex(-1)
+{
+}
+
+void SeriesReader::close()
+{
+	if (base && contents.isEmpty())
+		f.unmap((uchar *)base);
+	f.close();
+	contents.clear();
+	base = NULL;
+	size = end = 0;
+	offsets.clear();
+	timestamps.clear();
+	cachedIndex = -1;
+	cached.clear();
+}
+
+bool SeriesReader::open(const QString &file, QString &err)
+{
+	close();
+
+	f.setFileName(file);
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		err = tr("Cannot open file %1 for reading: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	size = f.size();
+	base = f.map(0, size);
+	if (!base)
+	{
+		contents = f.readAll();
+		base = (const uchar *)contents.constData();
+		size = contents.size();
+	}
+
+	QtcsHeader h;
+	if (size < (qint64)sizeof(h))
+	{
+		err = tr("File %1 is too short").arg(file);
+		close();
+		return false;
+	}
+	memcpy(&h, base, sizeof(h));
+
+	int version = qFromLittleEndian<quint16>(h.version);
+	keyInterval = qFromLittleEndian<quint16>(h.keyInterval);
+	xmin = qFromLittleEndian<qint16>(h.xmin);
+	xmax = qFromLittleEndian<qint16>(h.xmax);
+	ymin = qFromLittleEndian<qint16>(h.ymin);
+	ymax = qFromLittleEndian<qint16>(h.ymax);
+
+	if (memcmp(h.magic, "QTCS", 4) != 0 || keyInterval < 1 ||
+			xmax < xmin || ymax < ymin || xmax - xmin > 1000 || ymax - ymin > 1000)
+	{
+		err = tr("File %1 has invalid header").arg(file);
+		close();
+		return false;
+	}
+	if (version > QTCS_VERSION)
+	{
+		err = tr("File %1 has unsupported version %2").arg(file).arg(version);
+		close();
+		return false;
+	}
+
+	qint64 indexOffset = qFromLittleEndian<quint64>(h.indexOffset);
+	quint32 count = qFromLittleEndian<quint32>(h.frameCount);
+	if (indexOffset > 0 && indexOffset + 8 + (qint64)count * 16 <= size &&
+			memcmp(base + indexOffset, "INDX", 4) == 0 && qFromLittleEndian<quint32>(base + indexOffset + 4) == count)
+	{
+		const uchar *p = base + indexOffset + 8;
+		offsets.resize(count);
+		timestamps.resize(count);
+		for (quint32 i = 0; i < count; ++i, p += 16)
+		{
+			offsets[i] = qFromLittleEndian<quint64>(p);
+			timestamps[i] = qFromLittleEndian<qint64>(p + 8);
+			if (offsets[i] < (qint64)sizeof(QtcsHeader) || offsets[i] + (qint64)sizeof(QtcsFrameHeader) > indexOffset)
+			{
+				err = tr("File %1 has invalid index").arg(file);
+				close();
+				return false;
+			}
+		}
+		end = indexOffset;
+	}
+	else
+		rebuildIndex(sizeof(QtcsHeader));
+
+	return true;
+}
+
+bool SeriesReader::rebuildIndex(qint64 pos)
+{
+	offsets.clear();
+	timestamps.clear();
+
+	while (pos + (qint64)sizeof(QtcsFrameHeader) <= size)
+	{
+		QtcsFrameHeader fh;
+		memcpy(&fh, base + pos, sizeof(fh));
+		if (memcmp(fh.tag, "KEYF", 4) != 0 && memcmp(fh.tag, "DELT", 4) != 0)
+			break;
+		qint64 next = pos + sizeof(fh) + qFromLittleEndian<quint32>(fh.size);
+		if (next > size)
+			break;
+
+		// delta frame without preceding keyframe is useless
+		if (offsets.isEmpty() && memcmp(fh.tag, "KEYF", 4) != 0)
+			break;
+
+		offsets.append(pos);
+		timestamps.append(qFromLittleEndian<qint64>(fh.timestamp));
+		pos = next;
+	}
+
+	end = pos;
+	return !offsets.isEmpty();
+}
+
+bool SeriesReader::isKeyframe(int index)
+{
+	return memcmp(base + offsets[index], "KEYF", 4) == 0;
+}
+
+bool SeriesReader::decode(int index, QVector<qint32> &samples)
+{
+	QtcsFrameHeader fh;
+	memcpy(&fh, base + offsets[index], sizeof(fh));
+	bool key = isKeyframe(index);
+	const uchar *p = base + offsets[index] + sizeof(fh);
+	const uchar *pend = p + qFromLittleEndian<quint32>(fh.size);
+	if (pend > base + size)
+		return false;
+
+	int count = (xmax - xmin + 1) * (ymax - ymin + 1);
+	samples.resize(count);
+	qint32 *s = samples.data();
+	qint32 prev = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		qint32 d;
+		if (!getVarint(p, pend, d))
+			return false;
+		if (key)
+			prev = s[i] = prev + d;
+		else
+			s[i] += d;
+	}
+
+	return true;
+}
+
+bool SeriesReader::frame(int index, ThermFrame &frame)
+{
+	if (!base || index < 0 || index >= offsets.size())
+		return false;
+
+	// decode from the nearest keyframe, or continue from the cached frame
+	int first = index;
+	if (cachedIndex == index)
+		first = index + 1;
+	else
+		while (first > 0 && first != cachedIndex + 1 && !isKeyframe(first))
+			first--;
+
+	for (int i = first; i <= index; ++i)
+	{
+		if (!decode(i, cached))
+		{
+			cachedIndex = -1;
+			return false;
+		}
+		cachedIndex = i;
+	}
+
+	frame.reset(xmin, xmax, ymin, ymax);
+	float *d = frame.data.data();
+	const qint32 *s = cached.constData();
+	for (int i = 0; i < cached.size(); ++i)
+		d[i] = s[i] / 100.0f;
+	frame.metadata["scanStarted"] = QDateTime::fromMSecsSinceEpoch(timestamps[index]).toString(Qt::ISODate);
+
+	return true;
+}
+
+SeriesWriter::SeriesWriter() : xmin(0), xmax(-1), ymin(0), ymax(-1), keyInterval(16)
+{
+}
+
+SeriesWriter::~SeriesWriter()
+{
+	QString err;
+	if (f.isOpen())
+		close(err);
+}
+
+bool SeriesWriter::open(const QString &file, int _xmin, int _xmax, int _ymin, int _ymax, QString &err,
+		int _keyInterval)
+{
+	xmin = _xmin;
+	xmax = _xmax;
+	ymin = _ymin;
+	ymax = _ymax;
+	keyInterval = qBound(1, _keyInterval, 65535);
+	offsets.clear();
+	timestamps.clear();
+	previous.clear();
+
+	qint64 pos = sizeof(QtcsHeader);
+
+	if (QFile::exists(file))
+	{
+		SeriesReader reader;
+		if (!reader.open(file, err))
+			return false;
+
+		ThermFrame last;
+		if (reader.frameCount() > 0 && !reader.frame(reader.frameCount() - 1, last))
+		{
+			err = tr("File %1 is corrupted").arg(file);
+			return false;
+		}
+		if (!last.isEmpty() && (last.xmin != xmin || last.xmax != xmax || last.ymin != ymin || last.ymax != ymax))
+		{
+			err = tr("File %1 has different field of view").arg(file);
+			return false;
+		}
+
+		for (int i = 0; i < reader.frameCount(); ++i)
+		{
+			offsets.append(reader.offsets[i]);
+			timestamps.append(reader.timestamps[i]);
+		}
+		previous = reader.cached;
+		keyInterval = reader.keyframeInterval();
+		pos = reader.dataEnd();
+	}
+
+	f.setFileName(file);
+	if (!f.open(QIODevice::ReadWrite))
+	{
+		err = tr("Cannot open file %1 for writing: %2").arg(file).arg(f.errorString());
+		return false;
+	}
+
+	// old index is rewritten on close, header says there's none until then
+	QtcsHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "QTCS", 4);
+	h.version = qToLittleEndian<quint16>(QTCS_VERSION);
+	h.keyInterval = qToLittleEndian<quint16>(keyInterval);
+	h.xmin = qToLittleEndian<qint16>(xmin);
+	h.xmax = qToLittleEndian<qint16>(xmax);
+	h.ymin = qToLittleEndian<qint16>(ymin);
+	h.ymax = qToLittleEndian<qint16>(ymax);
+
+	if (f.write((const char *)&h, sizeof(h)) != sizeof(h) || !f.resize(pos) || !f.seek(pos))
+	{
+		err = tr("Cannot write to file %1: %2").arg(file).arg(f.errorString());
+		f.close();
+		return false;
+	}
+
+	return true;
+}
+
+bool SeriesWriter::append(const ThermFrame &frame, qint64 timestamp, QString &err)
+{
+	if (frame.xmin != xmin || frame.xmax != xmax || frame.ymin != ymin || frame.ymax != ymax)
+	{
+		err = tr("Frame has different field of view than series %1").arg(f.fileName());
+		return false;
+	}
+
+	int count = frame.data.size();
+	const float *temps = frame.data.constData();
+	bool key = offsets.size() % keyInterval == 0 || previous.size() != count;
+
+	QByteArray payload;
+	payload.reserve(count * 2);
+	previous.resize(count);
+	qint32 *prev = previous.data();
+	qint32 last = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		qint32 q = quantize(temps[i]);
+		putVarint(payload, q - (key ? last : prev[i]));
+		prev[i] = last = q;
+	}
+
+	QtcsFrameHeader fh;
+	memcpy(fh.tag, key ? "KEYF" : "DELT", 4);
+	fh.size = qToLittleEndian<quint32>(payload.size());
+	fh.timestamp = qToLittleEndian<qint64>(timestamp);
+
+	qint64 pos = f.pos();
+	if (f.write((const char *)&fh, sizeof(fh)) != sizeof(fh) || f.write(payload) != payload.size())
+	{
+		err = tr("Cannot write to file %1: %2").arg(f.fileName()).arg(f.errorString());
+		// next frame has to be a keyframe, previous contents are unknown
+		previous.clear();
+		f.resize(pos);
+		f.seek(pos);
+		return false;
+	}
+
+	offsets.append(pos);
+	timestamps.append(timestamp);
+	return true;
+}
+
+bool SeriesWriter::writeIndex()
+{
+	qint64 indexOffset = f.pos();
+
+	QByteArray index("INDX", 4);
+	uchar buf[16];
+	qToLittleEndian<quint32>(offsets.size(), buf);
+	index.append((const char *)buf, 4);
+	for (int i = 0; i < offsets.size(); ++i)
+	{
+		qToLittleEndian<quint64>(offsets[i], buf);
+		qToLittleEndian<qint64>(timestamps[i], buf + 8);
+		index.append((const char *)buf, 16);
+	}
+
+	if (f.write(index) != index.size())
+		return false;
+
+	uchar count[4], offset[8];
+	qToLittleEndian<quint32>(offsets.size(), count);
+	qToLittleEndian<quint64>(indexOffset, offset);
+	return f.seek(offsetof(QtcsHeader, frameCount)) && f.write((const char *)count, 4) == 4 &&
+			f.seek(offsetof(QtcsHeader, indexOffset)) && f.write((const char *)offset, 8) == 8;
+}
+
+bool SeriesWriter::close(QString &err)
+{
+	bool ok = writeIndex();
+	if (!ok)
+		err = tr("Cannot write to file %1: %2").arg(f.fileName()).arg(f.errorString());
+	f.close();
+	return ok;
+}
@@ -0,0 +1,93 @@
+#ifndef SERIES_H_
+#define SERIES_H_
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QVector>
+
+#include "thermframe.h"
+
+namespace QThermCam
+{
+
+/* .qtcs - sequence of frames of the same field of view, see series.cpp */
+class SeriesReader
+{
+	Q_DECLARE_TR_FUNCTIONS(SeriesReader)
+	friend class SeriesWriter;
+
+	QFile f;
+	QByteArray contents;
+	const uchar *base;
+	qint64 size, end;
+	int xmin, xmax, ymin, ymax;
+	int keyInterval;
+	QVector<qint64> offsets;
+	QVector<qint64> timestamps;
+
+	/* last decoded frame, makes stepping forward cost one delta */
+	int cachedIndex;
+	QVector<qint32> cached;
+
+	bool rebuildIndex(qint64 pos);
+	bool isKeyframe(int index);
+	bool decode(int index, QVector<qint32> &samples);
+
+public:
+	SeriesReader();
+
+	~SeriesReader() { close(); }
+
+	bool open(const QString &file, QString &err);
+
+	void close();
+
+	bool isOpen() { return base != NULL; }
+
+	int frameCount() { return offsets.size(); }
+
+	/* milliseconds since epoch */
+	qint64 timestamp(int index) { return timestamps[index]; }
+
+	/* decodes at most keyframe interval frames */
+	bool frame(int index, ThermFrame &frame);
+
+	int keyframeInterval() { return keyInterval; }
+
+	/* end of last frame record, where the next one should go */
+	qint64 dataEnd() { return end; }
+};
+
+class SeriesWriter
+{
+	Q_DECLARE_TR_FUNCTIONS(SeriesWriter)
+
+	QFile f;
+	int xmin, xmax, ymin, ymax;
+	int keyInterval;
+	QVector<qint64> offsets;
+	QVector<qint64> timestamps;
+	QVector<qint32> previous;
+
+	bool writeIndex();
+
+public:
+	SeriesWriter();
+
+	~SeriesWriter();
+
+	/* creates new file or appends to existing one with the same field of
+	 * view */
+	bool open(const QString &file, int xmin, int xmax, int ymin, int ymax, QString &err, int keyInterval = 16);
+
+	bool append(const ThermFrame &frame, qint64 timestamp, QString &err);
+
+	/* writes index, without it readers have to scan the whole file */
+	bool close(QString &err);
+
+	int frameCount() { return offsets.size(); }
+};
+
+}
+
+#endif /* SERIES_H_ */
@@ -0,0 +1,88 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "sweep.h"
+
+using namespace QThermCam;
+
+/* samples farther apart are not interpolated, point is left for rescan */
+#define MAX_GAP 1.5f
+
+/* Positions reported by the device are commanded positions at the middle of
+ * a read, but the sensor output lags behind the servo - the value describes
+ * the area seen lagMs earlier. Samples are shifted back along the sweep by
+ * that time and every integer position gets the value interpolated linearly
+ * between the two samples around it.
+ */
+void Sweep::resample(const QVector<SweepSample> &samples, int from, int to, int msPerDegree, int lagMs,
+		int xmin, QVector<float> &row)
+{
+	row.fill(-1000);
+
+	int dir = to >= from ? 1 : -1;
+	float shift = (float)lagMs / msPerDegree;
+
+	// effective positions along the sweep, samples out of order are dropped
+	QVector<float> pos, temp;
+	pos.reserve(samples.size());
+	temp.reserve(samples.size());
+	for (int i = 0; i < samples.size(); ++i)
+	{
+		const SweepSample &s = samples[i];
+		// time difference is computed on unsigned values, so micros() overflow doesn't matter
+		if (i > 0 && (qint32)(s.time - samples[i - 1].time) <= 0)
+			continue;
+
+		float p = dir * s.pos100 / 100.0f - shift;
+		if (!pos.isEmpty() && p < pos.last())
+			continue;
+		pos.append(p);
+		temp.append(s.temp);
+	}
+
+	if (pos.isEmpty())
+		return;
+
+	// j is the last sample at or before current position
+	int j = -1;
+	int last = pos.size() - 1;
+	for (int x = from; dir > 0 ? x <= to : x >= to; x += dir)
+	{
+		int idx = x - xmin;
+		if (idx < 0 || idx >= row.size())
+			continue;
+
+		float p = dir * x;
+		while (j < last && pos[j + 1] <= p)
+			++j;
+
+		if (j == -1)
+		{
+			if (pos[0] - p < MAX_GAP / 2)
+				row[idx] = temp[0];
+		}
+		else if (j == last)
+		{
+			if (p - pos[j] < MAX_GAP / 2)
+				row[idx] = temp[j];
+		}
+		else if (pos[j + 1] - pos[j] <= MAX_GAP)
+		{
+			float w = (p - pos[j]) / (pos[j + 1] - pos[j]);
+			row[idx] = temp[j] + w * (temp[j + 1] - temp[j]);
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include <QVector>
+
+namespace QThermCam
+{
+
+/* one reading taken while the X servo was moving */
+struct SweepSample
+{
+	/* micros() of the device, wraps around */
+	quint32 time;
+	/* commanded position in 1/100 degree */
+	int pos100;
+	float temp;
+};
+
+namespace Sweep
+{
+	/* Builds row of temperatures for positions from..to out of samples of one
+	 * sweep at msPerDegree, compensating for sensor lag of lagMs. row[x - xmin]
+	 * is set to -1000 where there are no samples close enough.
+	 */
+	void resample(const QVector<SweepSample> &samples, int from, int to, int msPerDegree, int lagMs,
+			int xmin, QVector<float> &row);
+}
+
+}
+
+#endif /* SWEEP_H_ */
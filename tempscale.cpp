@@ -0,0 +1,180 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tempscale.h"
+#include "palette.h"
+#include "tempview.h"
+
+#include <QPainter>
+
+#include <math.h>
+
+using namespace QThermCam;
+
+#define BAR_WIDTH 20
+#define DENSITY_WIDTH 12
+#define DENSITY_BUCKETS 128
+
+TempScale::TempScale(TempView *view, QWidget *parent) : QWidget(parent), view(view), generation(0),
+	histogramCount(0), tmin(0), tmax(0), bar(1, PALETTE_LEVELS, QImage::Format_RGB32),
+	density(DENSITY_BUCKETS, 0), densityMax(0)
+{
+	const QRgb *palette = paletteTable();
+	for (int i = 0; i < PALETTE_LEVELS; ++i)
+		bar.setPixel(0, PALETTE_LEVELS - 1 - i, palette[i]);
+
+	setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Expanding);
+	setMinimumHeight(128);
+	generation = view->rangeGeneration() - 1;
+}
+
+QSize TempScale::sizeHint() const
+{
+	return QSize(BAR_WIDTH + DENSITY_WIDTH + fontMetrics().width("-000.0") + 10, 256);
+}
+
+void TempScale::sourceChanged()
+{
+	int count = view->temperatureHistogram().count();
+	bool mappingChanged = generation != view->rangeGeneration();
+
+	if (!mappingChanged && count <= histogramCount + histogramCount / 10 && count >= histogramCount)
+		return;
+
+	if (mappingChanged)
+	{
+		generation = view->rangeGeneration();
+		tmin = view->rangeMinimum();
+		tmax = view->rangeMaximum();
+		updateTicks();
+	}
+	histogramCount = count;
+	updateDensity();
+	update();
+}
+
+void TempScale::updateTicks()
+{
+	ticks.clear();
+	if (tmax <= tmin)
+		return;
+
+	// aim for about 10 labels with "round" values
+	static const float steps[] = { 0.1f, 0.2f, 0.5f, 1, 2, 5, 10, 20, 50, 100 };
+	float step = steps[0];
+	for (unsigned int i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i)
+	{
+		step = steps[i];
+		if ((tmax - tmin) / step <= 10)
+			break;
+	}
+
+	Tick tick;
+	tick.level = 0;
+	tick.text = QString::number(view->levelTemperature(0), 'f', 1);
+	ticks.append(tick);
+
+	for (float t = ceil(tmin / step) * step; t < tmax; t += step)
+	{
+		tick.level = view->temperatureLevel(t);
+		tick.text = QString::number(t, 'f', step < 1 ? 1 : 0);
+		ticks.append(tick);
+	}
+
+	tick.level = PALETTE_LEVELS - 1;
+	tick.text = QString::number(view->levelTemperature(PALETTE_LEVELS - 1), 'f', 1);
+	ticks.append(tick);
+}
+
+void TempScale::updateDensity()
+{
+	density.fill(0);
+	densityMax = 0;
+	if (tmax <= tmin)
+		return;
+
+	const Histogram &hist = view->temperatureHistogram();
+	QVector<int> cdf;
+	hist.cumulative(cdf);
+
+	int prev = 0;
+	for (int bin = 0; bin < cdf.size(); ++bin)
+	{
+		int n = cdf[bin] - prev;
+		prev = cdf[bin];
+		if (n == 0)
+			continue;
+		int bucket = view->temperatureLevel(Histogram::binTemperature(bin)) * DENSITY_BUCKETS / PALETTE_LEVELS;
+		density[bucket] += n;
+	}
+
+	for (int i = 0; i < DENSITY_BUCKETS; ++i)
+		densityMax = qMax(densityMax, density[i]);
+}
+
+void TempScale::paintEvent(QPaintEvent *)
+{
+	QPainter painter(this);
+	int h = height();
+	int textHeight = fontMetrics().height();
+	int top = textHeight / 2;
+	int barHeight = h - textHeight;
+	if (barHeight <= 0)
+		return;
+
+	QRect barRect(0, top, BAR_WIDTH, barHeight);
+	painter.drawImage(barRect, bar);
+
+	if (densityMax > 0)
+	{
+		painter.setPen(palette().color(QPalette::WindowText));
+		for (int i = 0; i < DENSITY_BUCKETS; ++i)
+		{
+			if (density[i] == 0)
+				continue;
+			int len = qMax(1, density[i] * DENSITY_WIDTH / densityMax);
+			int y1 = top + barHeight - (i + 1) * barHeight / DENSITY_BUCKETS;
+			int y2 = top + barHeight - i * barHeight / DENSITY_BUCKETS - 1;
+			painter.fillRect(BAR_WIDTH + 1, y1, len, qMax(1, y2 - y1 + 1), palette().color(QPalette::Mid));
+		}
+	}
+
+	if (ticks.isEmpty())
+		return;
+
+	painter.setPen(palette().color(QPalette::WindowText));
+	int x = BAR_WIDTH + DENSITY_WIDTH + 4;
+	int lastY = h + textHeight;
+	int bottomY = top + barHeight - 1 - ticks.first().level * (barHeight - 1) / (PALETTE_LEVELS - 1);
+	int topY = top;
+
+	for (int i = 0; i < ticks.size(); ++i)
+	{
+		const Tick &tick = ticks[i];
+		int y = top + barHeight - 1 - tick.level * (barHeight - 1) / (PALETTE_LEVELS - 1);
+		bool edge = i == 0 || i == ticks.size() - 1;
+
+		// skip labels overlapping with previous one or with the top one
+		if (!edge && (y > lastY - textHeight || y < topY + textHeight || y > bottomY - textHeight))
+			continue;
+		if (i == ticks.size() - 1 && y > lastY - textHeight)
+			continue;
+
+		painter.drawLine(BAR_WIDTH, y, x - 2, y);
+		painter.drawText(x, y + fontMetrics().ascent() / 2, tick.text);
+		lastY = y;
+	}
+}
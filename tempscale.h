@@ -0,0 +1,53 @@
+#ifndef TEMPSCALE_H_
+#define TEMPSCALE_H_
+
+#include <QImage>
+#include <QString>
+#include <QVector>
+#include <QWidget>
+
+namespace QThermCam
+{
+class TempView;
+
+/* Color legend of a TempView. Colors come straight from the palette table,
+ * tick labels and sample density are recomputed only when the view changes
+ * its temperature to color mapping.
+ */
+class TempScale : public QWidget
+{
+	Q_OBJECT
+	TempView *view;
+	uint generation;
+	int histogramCount;
+	float tmin, tmax;
+	QImage bar;
+
+	struct Tick
+	{
+		int level;
+		QString text;
+	};
+	QVector<Tick> ticks;
+	QVector<int> density;
+	int densityMax;
+
+	void updateTicks();
+	void updateDensity();
+
+public:
+	TempScale(TempView *view, QWidget *parent = 0);
+
+	QSize sizeHint() const;
+
+public slots:
+	/* cheap if the mapping did not change */
+	void sourceChanged();
+
+protected:
+	void paintEvent(QPaintEvent *event);
+};
+
+}
+
+#endif /* TEMPSCALE_H_ */
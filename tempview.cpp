@@ -15,13 +15,18 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "tempview.h"
+#include "drift.h"
+#include "palette.h"
 
-#include <QDomDocument>
 #include <QImage>
 #include <QMouseEvent>
 #include <QPainter>
 #include <QToolTip>
 
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
 static uint qHash(const QPoint &p)
 {
 	return (p.x() << 16) + p.y();
@@ -29,8 +34,8 @@ static uint qHash(const QPoint &p)
 
 using namespace QThermCam;
 
-TempView::TempView(QWidget *parent, Qt::WindowFlags f) : QLabel(parent, f), buffer(NULL), tmin(999),
-	tmax(-999), xmin(0), xmax(0), ymin(0), ymax(0), dataWidth(0), dataHeight(0), cacheImage(NULL),
+TempView::TempView(QWidget *parent, Qt::WindowFlags f) : QLabel(parent, f), vmax(0), vmaxShown(0), noiseMap_(false), tmin(999),
+	tmax(-999), rangeMode_(RangeMinMax), rangeMin(999), rangeMax(-999), equalizeCount(0), rangeGeneration_(0), xmin(0), xmax(0), ymin(0), ymax(0), dataWidth(0), dataHeight(0), dirtyYmin(1), dirtyYmax(0), cacheImage(NULL),
 	xhighlight(-1), yhighlight(-1)
 {
 	setMouseTracking(true);
@@ -39,7 +44,6 @@ TempView::TempView(QWidget *parent, Qt::WindowFlags f) : QLabel(parent, f), buff
 
 TempView::~TempView()
 {
-	delete[] buffer;
 	delete cacheImage;
 }
 
@@ -53,15 +57,19 @@ void TempView::setBuffer(int _xmin, int _xmax, int _ymin, int _ymax)
 	dataWidth = xmax - xmin + 1;
 	dataHeight = ymax - ymin + 1;
 
-	delete[] buffer;
-	buffer = new float[dataWidth * dataHeight];
-
-	for(int i = 0; i < dataWidth * dataHeight; ++i)
-		buffer[i] = -1000;
+	buffer = QVector<float>(dataWidth * dataHeight, -1000);
+	variance.clear();
+	vmax = vmaxShown = 0;
 	tmin = 999;
 	tmax = -999;
+	histogram.clear();
+	resetRange();
 
 	showPoints.clear();
+	rescanned.clear();
+	metadata.clear();
+	dirtyYmin = ymax + 1;
+	dirtyYmax = ymin - 1;
 
 	if (cacheImage)
 	{
@@ -80,37 +88,231 @@ void TempView::setTemperature(int x, int y, float temp)
 {
 	tmin = qMin(tmin, temp);
 	tmax = qMax(tmax, temp);
-	buffer[dataWidth * (y - ymin) + (x - xmin)] = temp;
+
+	float &slot = buffer[dataWidth * (y - ymin) + (x - xmin)];
+	if (slot != -1000)
+		histogram.remove(slot);
+	slot = temp;
+	histogram.add(temp);
+	dirtyYmin = qMin(dirtyYmin, y);
+	dirtyYmax = qMax(dirtyYmax, y);
+
 	if (showPoints.contains(QPoint(x, y)))
 		showPoints[QPoint(x, y)] = QSize();
-	emit temperatureSet(x, y, temp);
 }
 
-static QRgb getColor(int level)
+void TempView::setTemperatures(int x, int y, const float *temps, int count)
+{
+	if (count <= 0)
+		return;
+
+	float *row = buffer.data() + dataWidth * (y - ymin) + (x - xmin);
+	float min = temps[0], max = temps[0];
+	for (int i = 0; i < count; ++i)
+	{
+		if (row[i] != -1000)
+			histogram.remove(row[i]);
+		histogram.add(temps[i]);
+		min = qMin(min, temps[i]);
+		max = qMax(max, temps[i]);
+	}
+	memcpy(row, temps, count * sizeof(float));
+
+	tmin = qMin(tmin, min);
+	tmax = qMax(tmax, max);
+	dirtyYmin = qMin(dirtyYmin, y);
+	dirtyYmax = qMax(dirtyYmax, y);
+
+	// cached label sizes are no longer valid
+	if (!showPoints.isEmpty())
+		for (int i = 0; i < count; ++i)
+			if (showPoints.contains(QPoint(x + i, y)))
+				showPoints[QPoint(x + i, y)] = QSize();
+}
+
+void TempView::setVariances(int x, int y, const float *vars, int count)
 {
-	level = 1023 - level;
-	if (level < 256)
-		return qRgb(255, 255 - level, 0);
-	if (level < 512)
-		return qRgb(255, 0, level - 256);
-	if (level < 768)
-		return qRgb(255 - (level - 512), 0, 255);
-	return qRgb(0, level - 768, 255);
+	if (count <= 0)
+		return;
+
+	if (variance.isEmpty())
+		variance.fill(-1, buffer.size());
+
+	float *row = variance.data() + dataWidth * (y - ymin) + (x - xmin);
+	for (int i = 0; i < count; ++i)
+		vmax = qMax(vmax, vars[i]);
+	memcpy(row, vars, count * sizeof(float));
+
+	dirtyYmin = qMin(dirtyYmin, y);
+	dirtyYmax = qMax(dirtyYmax, y);
+}
+
+void TempView::setNoiseMap(bool show)
+{
+	noiseMap_ = show;
+	refreshImage();
+	refreshView();
+}
+
+void TempView::setRangeMode(RangeMode mode)
+{
+	rangeMode_ = mode;
+	resetRange();
+	rangeGeneration_++;
+}
+
+void TempView::setManualRange(float min, float max)
+{
+	rangeMode_ = RangeManual;
+	rangeMin = min;
+	rangeMax = max;
+	equalizeLevels.clear();
+	rangeGeneration_++;
+}
+
+void TempView::resetRange()
+{
+	if (rangeMode_ == RangeManual)
+		return;
+	rangeMin = 999;
+	rangeMax = -999;
+	equalizeLevels.clear();
+	equalizeCount = 0;
+	rangeGeneration_++;
+}
+
+/* Recomputes range used for coloring, returns true if the whole image needs
+ * to be recolored. In percentile and equalization modes small changes are
+ * ignored, so palette does not jump around in the middle of the scan.
+ */
+bool TempView::updateRange()
+{
+	if (rangeMode_ == RangeManual || histogram.count() == 0)
+		return false;
+
+	if (rangeMode_ == RangeMinMax)
+	{
+		if (rangeMin == tmin && rangeMax == tmax)
+			return false;
+		rangeMin = tmin;
+		rangeMax = tmax;
+		return true;
+	}
+
+	bool changed = false;
+	float min = histogram.percentile(0.01f);
+	float max = histogram.percentile(0.99f);
+	float slack = qMax((rangeMax - rangeMin) * 0.05f, 0.2f);
+
+	if (rangeMin > rangeMax || qAbs(min - rangeMin) > slack || qAbs(max - rangeMax) > slack)
+	{
+		rangeMin = min;
+		rangeMax = max;
+		changed = true;
+	}
+
+	if (rangeMode_ == RangeEqualize && (equalizeLevels.isEmpty() ||
+			histogram.count() > equalizeCount + equalizeCount / 10 || histogram.count() < equalizeCount))
+	{
+		QVector<int> cdf;
+		histogram.cumulative(cdf);
+		qint64 total = histogram.count();
+
+		equalizeLevels.resize(cdf.size());
+		for (int i = 0; i < cdf.size(); ++i)
+			equalizeLevels[i] = (qint64)cdf[i] * 1023 / total;
+		equalizeCount = total;
+		changed = true;
+	}
+
+	return changed;
+}
+
+int TempView::temperatureLevel(float temp)
+{
+	if (rangeMode_ == RangeEqualize && !equalizeLevels.isEmpty())
+		return equalizeLevels[Histogram::binOf(temp)];
+	if (rangeMax <= rangeMin)
+		return 0;
+	return qBound(0, (int)((temp - rangeMin) * 1023 / (rangeMax - rangeMin)), 1023);
+}
+
+float TempView::levelTemperature(int level)
+{
+	if (rangeMode_ == RangeEqualize && !equalizeLevels.isEmpty())
+	{
+		int bin = std::lower_bound(equalizeLevels.constBegin(), equalizeLevels.constEnd(), level) -
+				equalizeLevels.constBegin();
+		return qBound(rangeMin, Histogram::binTemperature(qMin(bin, equalizeLevels.size() - 1)), rangeMax);
+	}
+	return rangeMin + level * (rangeMax - rangeMin) / 1023;
 }
 
 void TempView::refreshImage(int _ymin, int _ymax)
 {
+	if (!cacheImage)
+		return;
+
+	if (updateRange())
+	{
+		rangeGeneration_++;
+		_ymin = ymin;
+		_ymax = ymax;
+	}
+
+	const QRgb *palette = paletteTable();
+
+	if (noiseMap_)
+	{
+		// colors are relative to the noisiest point
+		if (vmax != vmaxShown)
+		{
+			vmaxShown = vmax;
+			_ymin = ymin;
+			_ymax = ymax;
+		}
+
+		float smax = sqrt(vmaxShown);
+		bool haveVars = !variance.isEmpty();
+		const float *vars = variance.constData();
+		for (int y = _ymin - ymin; y < _ymax - ymin + 1; ++y)
+		{
+			QRgb *line = (QRgb *)cacheImage->scanLine(dataHeight - y - 1);
+			for (int x = 0; x < dataWidth; ++x)
+			{
+				float v = haveVars ? vars[y * dataWidth + x] : -1;
+				line[x] = v < 0 || smax <= 0 ? qRgb(0, 0, 0) : palette[qBound(0, (int)(sqrt(v) * 1023 / smax), 1023)];
+			}
+		}
+		return;
+	}
+
+	const float *temps = buffer.constData();
 	for (int y = _ymin - ymin; y < _ymax - ymin + 1; ++y)
 	{
 		QRgb *line = (QRgb *)cacheImage->scanLine(dataHeight - y - 1);
 		for (int x = 0; x < dataWidth; ++x)
-			line[x] = getColor((buffer[y * dataWidth + x] - tmin) * 1023 / (tmax - tmin));
+		{
+			float t = temps[y * dataWidth + x];
+			line[x] = t == -1000 ? qRgb(0, 0, 0) : palette[temperatureLevel(t)];
+		}
 	}
 }
 
 void TempView::refreshImage()
 {
 	refreshImage(ymin, ymax);
+	dirtyYmin = ymax + 1;
+	dirtyYmax = ymin - 1;
+}
+
+void TempView::refreshChangedRows()
+{
+	if (dirtyYmin > dirtyYmax)
+		return;
+	refreshImage(dirtyYmin, dirtyYmax);
+	dirtyYmin = ymax + 1;
+	dirtyYmax = ymin - 1;
 }
 
 void TempView::refreshView()
@@ -165,7 +367,7 @@ void TempView::refreshView()
 		const QPoint &p = ps.key();
 		QSize &s = ps.value();
 		QPoint imagePoint((p.x() - xmin) * xscale + xscale / 2, tempImage.height() - (p.y() - ymin) * yscale - yscale / 2);
-		QString text = QString::number(buffer[(p.y() - ymin) * dataWidth + p.x() - xmin], 'f', 2);
+		QString text = QString::number(buffer.at((p.y() - ymin) * dataWidth + p.x() - xmin), 'f', 2);
 
 		painter.drawEllipse(imagePoint, 1, 1);
 
@@ -230,7 +432,12 @@ void TempView::mouseMoveEvent(QMouseEvent *event)
 		return;
 	}
 
-	QString s = QString::number(buffer[p.y() * dataWidth + p.x()], 'f', 2);
+	QString s = QString::number(buffer.at(p.y() * dataWidth + p.x()), 'f', 2);
+	int i = p.y() * dataWidth + p.x();
+	if (!variance.isEmpty() && variance.at(i) >= 0)
+		s += QString(" %1 %2").arg(QChar(0xb1)).arg(sqrt(variance.at(i)), 0, 'f', 2);
+	if (rescanned.contains(QPoint(p.x() + xmin, p.y() + ymin)))
+		s += tr(" (read again)");
 	//s.sprintf("%d %d %f", p.x(), p.y(), buffer[p.y() * dataWidth + p.x()]);
 	QToolTip::showText(event->globalPos(), s, this);
 	QLabel::mouseMoveEvent(event);
@@ -248,6 +455,16 @@ void TempView::removeStaticLabel(const QPoint &p)
 		showPoints.remove(p);
 }
 
+void TempView::addRowAmbient(int y, float temp)
+{
+	Drift::addRowAmbient(metadata, y, temp);
+}
+
+void TempView::markRescanned(const QPoint &p)
+{
+	rescanned.insert(p);
+}
+
 void TempView::clearStaticLabels()
 {
 	showPoints.clear();
@@ -294,174 +511,52 @@ void TempView::highlightPoint(int x, int y)
 	yhighlight = y;
 }
 
-void TempView::saveToFile(const QString &file)
+ThermFrame TempView::frame()
 {
-	QDomDocument doc("qtdc");
-	QDomElement root = doc.createElement("qtdc");
-	doc.appendChild(root);
-
-	QDomElement fov = doc.createElement("fov");
-	fov.setAttribute("xmin", xmin);
-	fov.setAttribute("xmax", xmax);
-	fov.setAttribute("ymin", ymin);
-	fov.setAttribute("ymax", ymax);
-	root.appendChild(fov);
-
-	QDomElement highlight = doc.createElement("highlight");
-	highlight.setAttribute("x", xhighlight);
-	highlight.setAttribute("y", yhighlight);
-	root.appendChild(highlight);
-
-	// make it easy to parse, also by external tools
-	QDomElement data = doc.createElement("data");
-	for(int y = 0; y < dataHeight; ++y)
-	{
-		QDomElement row = doc.createElement("row");
-		row.setAttribute("y", y + ymin);
-
-		for (int x = 0; x < dataWidth; ++x)
-		{
-			QDomElement col = doc.createElement("col");
-			col.setAttribute("x", x + xmin);
-			float f = buffer[y * dataWidth + x];
-			if (f == -1000)
-				col.setAttribute("val", "");
-			else
-				col.setAttribute("val", buffer[y * dataWidth + x]);
-			row.appendChild(col);
-		}
-		data.appendChild(row);
-	}
-	root.appendChild(data);
-
-	QDomElement show = doc.createElement("show");
-	for(QHash<QPoint, QSize>::iterator ps = showPoints.begin(); ps != showPoints.end(); ++ps)
-	{
-		const QPoint &p = ps.key();
-		QDomElement point = doc.createElement("point");
-		point.setAttribute("x", p.x());
-		point.setAttribute("y", p.y());
-		show.appendChild(point);
-	}
-	root.appendChild(show);
-
-	QFile f(file);
-	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
-	{
-		emit error(tr("Cannot open file %1 for writing: %2").arg(file).arg(f.errorString()));
-		return;
-	}
-
-	qint64 r = f.write(doc.toString().toUtf8());
-	if (r == -1)
-	{
-		emit error(tr("Cannot write to file %1: %2").arg(file).arg(f.errorString()));
-		f.close();
-		return;
-	}
-
-	f.close();
+	ThermFrame f;
+	f.xmin = xmin;
+	f.xmax = xmax;
+	f.ymin = ymin;
+	f.ymax = ymax;
+	f.xhighlight = xhighlight;
+	f.yhighlight = yhighlight;
+	// shared, copied only when scan modifies the buffer while frame is in use
+	f.data = buffer;
+	f.variance = variance;
+	f.labels = showPoints.keys();
+	f.rescanned = rescanned.toList();
+	f.metadata = metadata;
+	return f;
 }
 
-bool TempView::loadFromFile(const QString &file)
+void TempView::setFrame(const ThermFrame &frame)
 {
-	QDomDocument doc("qtcd");
-	QFile f(file);
+	setBuffer(frame.xmin, frame.xmax, frame.ymin, frame.ymax);
+	highlightPoint(frame.xhighlight, frame.yhighlight);
 
-	if (!f.open(QIODevice::ReadOnly))
+	buffer = frame.data;
+	if (frame.variance.size() == buffer.size())
 	{
-		emit error(tr("Cannot open file %1 for reading: %2").arg(file).arg(f.errorString()));
-		return false;
+		variance = frame.variance;
+		for (int i = 0; i < variance.size(); ++i)
+			vmax = qMax(vmax, variance.at(i));
 	}
-
-	QString err;
-	int line, col;
-	if (!doc.setContent(&f, &err, &line, &col))
+	const float *temps = buffer.constData();
+	for (int i = 0; i < buffer.size(); ++i)
 	{
-		f.close();
-		emit error(tr("Cannot parse file %1, error: %2, line: %3, col: %4").arg(file).arg(f.errorString()).arg(line).arg(col));
-		return false;
-	}
-	f.close();
-
-	QDomElement docElem = doc.documentElement();
-
-	QDomElement fov = docElem.firstChildElement("fov");
-	int xmin = fov.attribute("xmin", "0").toInt();
-	int xmax = fov.attribute("xmax", "180").toInt();
-	int ymin = fov.attribute("ymin", "0").toInt();
-	int ymax = fov.attribute("ymax", "180").toInt();
-
-	setBuffer(xmin, xmax, ymin, ymax);
-
-	QDomElement highlight = docElem.firstChildElement("highlight");
-	int xhl = highlight.attribute("x", "-1").toInt();
-	int yhl = highlight.attribute("y", "-1").toInt();
-
-	highlightPoint(xhl, yhl);
-
-	QDomElement data = docElem.firstChildElement("data");
-	QDomElement row = data.firstChildElement("row");
-	while (!row.isNull())
-	{
-		int y = row.attribute("y", "-1").toInt();
-		if (y < ymin || y > ymax)
-		{
-			emit error(QString("Invalid row number: %1").arg(y));
-			return false;
-		}
-		QDomElement col = row.firstChildElement("col");
-		while (!col.isNull())
-		{
-			QString tstr = col.attribute("val", "");
-			QString xstr = col.attribute("x", "-1");
-
-			if (!tstr.isEmpty() && !xstr.isEmpty())
-			{
-				bool okt, okx;
-				float t = tstr.toFloat(&okt);
-				int x = xstr.toInt(&okx);
-				if (okt && okx)
-				{
-					if (x < xmin || x > xmax)
-					{
-						emit error(tr("Invalid column number: %1 in row %2").arg(x).arg(y));
-						return false;
-					}
-					setTemperature(x, y, t);
-				}
-				else
-				{
-					emit error(tr("Unable to parse x or temperature in row: %1").arg(y));
-					return false;
-				}
-			}
-
-			col = col.nextSiblingElement("col");
-		}
-
-		row = row.nextSiblingElement("row");
+		if (temps[i] == -1000)
+			continue;
+		histogram.add(temps[i]);
+		tmin = qMin(tmin, temps[i]);
+		tmax = qMax(tmax, temps[i]);
 	}
 
-	QDomElement show = docElem.firstChildElement("show");
-	QDomElement point = show.firstChildElement("point");
-	while (!point.isNull())
-	{
-		int x = point.attribute("x", "-1").toInt();
-		int y = point.attribute("y", "-1").toInt();
-		if (x < xmin || x > xmax || y < ymin || y > ymax)
-		{
-			emit error(tr("Invalid selection: %1 / %2").arg(x).arg(y));
-			return false;
-		}
-
-		showPoints.insert(QPoint(x, y), QSize());
-
-		point = point.nextSiblingElement("point");
-	}
+	for (int i = 0; i < frame.labels.size(); ++i)
+		showPoints.insert(frame.labels[i], QSize());
+	for (int i = 0; i < frame.rescanned.size(); ++i)
+		rescanned.insert(frame.rescanned[i]);
+	metadata = frame.metadata;
 
 	refreshImage();
 	refreshView();
-
-	return true;
 }
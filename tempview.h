@@ -3,8 +3,14 @@
 
 #include <QLabel>
 #include <QHash>
+#include <QMap>
 #include <QPoint>
+#include <QSet>
 #include <QSize>
+#include <QVector>
+
+#include "histogram.h"
+#include "thermframe.h"
 
 namespace QThermCam
 {
@@ -12,14 +18,32 @@ namespace QThermCam
 class TempView : public QLabel
 {
 	Q_OBJECT
-	float *buffer;
+public:
+	enum RangeMode { RangeMinMax, RangePercentile, RangeEqualize, RangeManual };
+
+private:
+	QVector<float> buffer;
+	/* empty until the first known variance, see ThermFrame */
+	QVector<float> variance;
+	float vmax, vmaxShown;
+	bool noiseMap_;
 	float tmin, tmax;
+	Histogram histogram;
+	RangeMode rangeMode_;
+	float rangeMin, rangeMax;
+	QVector<int> equalizeLevels;
+	int equalizeCount;
+	uint rangeGeneration_;
 	int xmin, xmax, ymin, ymax;
 	int dataWidth, dataHeight;
+	int dirtyYmin, dirtyYmax;
 	QImage *cacheImage;
 	int xhighlight, yhighlight;
 	QPoint getPoint(QMouseEvent *event);
 	QHash<QPoint, QSize> showPoints;
+	QSet<QPoint> rescanned;
+	QMap<QString, QString> metadata;
+	bool updateRange();
 
 public:
 	TempView(QWidget *parent = 0, Qt::WindowFlags f = 0);
@@ -30,20 +54,64 @@ public:
 
 	void setTemperature(int x, int y, float temp);
 
+	/* sets count temperatures in row y, starting at column x */
+	void setTemperatures(int x, int y, const float *temps, int count);
+
+	/* sets variances of readings, like setTemperatures */
+	void setVariances(int x, int y, const float *vars, int count);
+
+	/* shows standard deviation of readings instead of temperatures */
+	void setNoiseMap(bool show);
+
+	bool noiseMap() { return noiseMap_; }
+
+	bool hasVariance() { return !variance.isEmpty(); }
+
 	void refreshImage(int ymin, int ymax);
 
 	void refreshImage();
 
+	/* recolors rows changed since last refresh */
+	void refreshChangedRows();
+
 	void highlightPoint(int x, int y);
 
-	void saveToFile(const QString &file);
+	/* snapshot of current contents, cheap until the buffer changes */
+	ThermFrame frame();
+
+	/* replaces all contents, see FrameFile for loading from file */
+	void setFrame(const ThermFrame &frame);
 
-	bool loadFromFile(const QString &file);
+	QMap<QString, QString> fileMetadata() { return metadata; }
+
+	void setFileMetadata(const QString &key, const QString &value) { metadata[key] = value; }
 
 	float minTemperature() { return tmin; }
 
 	float maxTemperature() { return tmax; }
 
+	void setRangeMode(RangeMode mode);
+
+	RangeMode rangeMode() { return rangeMode_; }
+
+	void setManualRange(float min, float max);
+
+	/* forgets hysteresis state, next refreshImage recomputes the range */
+	void resetRange();
+
+	float rangeMinimum() { return rangeMin; }
+
+	float rangeMaximum() { return rangeMax; }
+
+	int temperatureLevel(float temp);
+
+	float levelTemperature(int level);
+
+	/* changes every time temperature to color mapping changes */
+	uint rangeGeneration() { return rangeGeneration_; }
+
+	const Histogram &temperatureHistogram() { return histogram; }
+
 	int bufferWidth() { return dataWidth; }
 
 	int bufferHeight() { return dataHeight; }
@@ -61,13 +129,18 @@ public:
 	void removeStaticLabel(const QPoint &p);
 
 	void clearStaticLabels();
+
+	/* ambient temperature read at the beginning of row y, see Drift */
+	void addRowAmbient(int y, float temp);
+
+	/* remembers that reading at p had to be repeated */
+	void markRescanned(const QPoint &p);
 public slots:
 	void refreshView();
 signals:
 	void leftMouseButtonClicked(const QPoint &p);
 	void error(const QString &s);
 	void bufferSizeChanged(int xmin, int xmax, int ymin, int ymax);
-	void temperatureSet(int x, int y, float t);
 protected:
 	void mouseMoveEvent(QMouseEvent *event);
 	void mousePressEvent(QMouseEvent *event);
@@ -16,9 +16,13 @@
  */
 
 #include "thermcam.h"
+#include "logging.h"
 
+#include <QFile>
+#include <QFileSystemWatcher>
 #include <QSocketNotifier>
 #include <QStringList>
+#include <QTimer>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -32,9 +36,48 @@ using namespace QThermCam;
 
 static QString describeTermiosInfo(const struct termios &argp);
 
-ThermCam::ThermCam(QObject *parent) : QObject(parent), fd(-1), notifier(NULL), xmin(-1), xmax(-1), ymin(-1), ymax(-1), x(-1), y(-1)
+/* factory setting is IIR 100b (a1 = 1, b1 = 0), FIR 111b (N = 1024) */
+const FilterPreset QThermCam::filterPresets[FILTER_PRESET_COUNT] =
+{
+	{ QT_TRANSLATE_NOOP("ThermCam", "Factory (accurate)"), 4, 7, 100 },
+	{ QT_TRANSLATE_NOOP("ThermCam", "Low noise"), 5, 7, 250 },
+	{ QT_TRANSLATE_NOOP("ThermCam", "Balanced"), 4, 6, 60 },
+	{ QT_TRANSLATE_NOOP("ThermCam", "Fast survey (noisy)"), 4, 4, 20 },
+};
+
+ThermCam::ThermCam(QObject *parent) : QObject(parent), fd(-1), notifier(NULL), writeNotifier(NULL), xmin(-1), xmax(-1), ymin(-1), ymax(-1), x(-1), y(-1),
+		scanMode(ScanStep), sweepRate(20), sweepLag(0), rawMode(false), filterIir(-1), filterFir(-1), settleMs(-1),
+		samplesPerPoint(1), trimmedMean(false), ambientInterval(0)
 {
 	scan.inProgress = false;
+	scan.awaiting = false;
+	scan.sweeping = false;
+	pending.x = pending.y = -1;
+	pending.haveVariance = false;
+
+	// fires when all data available in this event loop iteration were processed
+	flushTimer = new QTimer(this);
+	flushTimer->setSingleShot(true);
+	flushTimer->setInterval(0);
+	connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushSamples()));
+
+	// commands queued in one event loop iteration are sent with one write
+	writeTimer = new QTimer(this);
+	writeTimer->setSingleShot(true);
+	writeTimer->setInterval(0);
+	connect(writeTimer, SIGNAL(timeout()), this, SLOT(flushOutput()));
+
+	watchdog = new QTimer(this);
+	watchdog->setSingleShot(true);
+	watchdog->setInterval(COMMAND_TIMEOUT);
+	connect(watchdog, SIGNAL(timeout()), this, SLOT(watchdogTimeout()));
+
+	reconnectTimer = new QTimer(this);
+	reconnectTimer->setInterval(RECONNECT_INTERVAL);
+	connect(reconnectTimer, SIGNAL(timeout()), this, SLOT(tryReconnect()));
+
+	devWatcher = new QFileSystemWatcher(this);
+	connect(devWatcher, SIGNAL(directoryChanged(const QString &)), this, SLOT(devChanged()));
 }
 
 bool ThermCam::doConnect(const QString &path)
@@ -46,14 +89,31 @@ bool ThermCam::doConnect(const QString &path)
 		return false;
 	}
 
+	if (!openDevice(path))
+	{
+		unlockDevice(path, err);
+		if (err != QString::null)
+			emit error(err);
+		return false;
+	}
+
+	devicePath = path;
+
+	// board is reset only when DTR goes up, which does not happen if the
+	// port was left open without HUPCL (e.g. by DeviceProbe) - ask it for
+	// dimensions; after a reset the bootloader drops this
+	sendCommand("i!");
+
+	return true;
+}
+
+bool ThermCam::openDevice(const QString &path)
+{
 	QByteArray pathLocal = path.toLocal8Bit();
-	fd = open(pathLocal.constData(), O_RDWR | O_NOCTTY); // +O_NONBLOCK?
+	fd = open(pathLocal.constData(), O_RDWR | O_NOCTTY | O_NONBLOCK);
 	if (fd == -1)
 	{
 		emit error(path + ": " + QString(strerror(errno)));
-		unlockDevice(devicePath, err);
-		if (err != QString::null)
-			emit error(err);
 		return false;
 	}
 
@@ -64,14 +124,10 @@ bool ThermCam::doConnect(const QString &path)
 		emit error(path + " tcgetattr: " + QString(strerror(errno)));
 		::close(fd);
 		fd = -1;
-		unlockDevice(devicePath, err);
-		if (err != QString::null)
-			emit error(err);
 		return false;
 	}
 
-	emit info(tr("Current port settings:"));
-	emit info(describeTermiosInfo(argp));
+	TC_LOG(CategorySerial, LevelDebug, emit debug(tr("Current port settings:") + "\n" + describeTermiosInfo(argp)));
 
 	argp.c_iflag = 0;
 	argp.c_oflag = 0;
@@ -86,37 +142,55 @@ bool ThermCam::doConnect(const QString &path)
 
 	cfsetspeed(&argp, B115200);
 
-	emit info("new port settings: ");
-	emit info(describeTermiosInfo(argp));
+	TC_LOG(CategorySerial, LevelDebug, emit debug(tr("New port settings:") + "\n" + describeTermiosInfo(argp)));
 
 	if (tcsetattr(fd, TCSANOW, &argp))
 	{
 		emit error(path + " tcsetattr: " + QString(strerror(errno)));
 		::close(fd);
 		fd = -1;
-		unlockDevice(devicePath, err);
-		if (err != QString::null)
-			emit error(err);
 		return false;
 	}
 
 	notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
 	connect(notifier, SIGNAL(activated(int)), this, SLOT(fdActivated(int)));
 
-	devicePath = path;
+	writeNotifier = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+	writeNotifier->setEnabled(false);
+	connect(writeNotifier, SIGNAL(activated(int)), this, SLOT(flushOutput()));
+
+	buffer.truncate(0);
 
 	return true;
 }
 
-void ThermCam::doDisconnect()
+void ThermCam::closeDevice()
 {
-	sendCommand("moff!");
+	outQueue.clear();
+	writeTimer->stop();
 
 	disconnect(notifier, NULL, this, NULL);
 	delete notifier;
 	notifier = NULL;
+	delete writeNotifier;
+	writeNotifier = NULL;
 	::close(fd);
 	fd = -1;
+}
+
+void ThermCam::doDisconnect()
+{
+	reconnectTimer->stop();
+	devWatcher->removePath("/dev");
+	watchdog->stop();
+
+	if (fd != -1)
+	{
+		sendCommand("moff!");
+		// last chance, whatever does not fit into tty buffer is lost
+		flushOutput();
+		closeDevice();
+	}
 
 	QString err;
 	unlockDevice(devicePath, err);
@@ -128,14 +202,58 @@ void ThermCam::doDisconnect()
 
 bool ThermCam::sendCommand(const QByteArray &cmd)
 {
-	int r = write(fd, cmd.constData(), cmd.length());
-	if (r <= 0)
-		emit error(tr("Cannot send command"));
-	else if (r < 0)
+	if (fd == -1)
+	{
+		emit error(tr("Cannot send command: not connected"));
+		return false;
+	}
+
+	if (outQueue.size() > MAX_OUTPUT_QUEUE)
+	{
+		emit error(tr("Cannot send command '%1': device does not accept data").arg(cmd.constData()));
+		return false;
+	}
+
+	outQueue.append(cmd);
+	TC_LOG(CategorySerial, LevelDebug, emit debug(tr("Command '%1' queued").arg(cmd.constData())));
+
+	if (!writeNotifier->isEnabled() && !writeTimer->isActive())
+		writeTimer->start();
+	return true;
+}
+
+void ThermCam::flushOutput()
+{
+	writeTimer->stop();
+	if (outQueue.isEmpty() || fd == -1)
+	{
+		if (writeNotifier)
+			writeNotifier->setEnabled(false);
+		return;
+	}
+
+	int r = write(fd, outQueue.constData(), outQueue.length());
+	if (r < 0 && (errno == EIO || errno == ENXIO || errno == ENODEV))
+	{
+		linkLost(strerror(errno));
+		return;
+	}
+	if (r < 0 && errno != EAGAIN && errno != EINTR)
+	{
 		emit error(tr("write: %1").arg(strerror(errno)));
-	else
-		emit debug(tr("Command '%1' sent: %2").arg(cmd.constData()).arg(r));
-	return r > 0;
+		outQueue.clear();
+		writeNotifier->setEnabled(false);
+		return;
+	}
+
+	if (r > 0)
+	{
+		TC_LOG(CategorySerial, LevelDebug, emit debug(tr("Sent: '%1'").arg(outQueue.left(r).constData())));
+		outQueue.remove(0, r);
+	}
+
+	// wait until tty is able to accept more
+	writeNotifier->setEnabled(!outQueue.isEmpty());
 }
 
 bool ThermCam::sendCommand_readObjectTemp()
@@ -154,7 +272,7 @@ bool ThermCam::sendCommand_moveX(int newPos)
 		newPos = xmin;
 	if (newPos > xmax)
 		newPos = xmax;
-	return sendCommand(QString("px%1!").arg(newPos).toLatin1());
+	return sendCommand("px" + QByteArray::number(newPos) + "!");
 }
 
 bool ThermCam::sendCommand_moveY(int newPos)
@@ -163,34 +281,65 @@ bool ThermCam::sendCommand_moveY(int newPos)
 		newPos = ymin;
 	if (newPos > ymax)
 		newPos = ymax;
-	return sendCommand(QString("py%1!").arg(newPos).toLatin1());
+	return sendCommand("py" + QByteArray::number(newPos) + "!");
+}
+
+bool ThermCam::sendCommand_settleBenchmark(int from, int to)
+{
+	return sendCommand("fb" + QByteArray::number(from) + "," + QByteArray::number(to) + "!");
 }
 
 void ThermCam::fdActivated(int fd)
 {
-	char c;
-	int r = read(fd, &c, 1);
-	if (r != 1)
+	char buf[256];
+	int r = read(fd, buf, sizeof(buf));
+	if (r == 0 || (r < 0 && (errno == EIO || errno == ENXIO || errno == ENODEV)))
+	{
+		// device was unplugged or reset
+		linkLost(r == 0 ? tr("end of file") : QString(strerror(errno)));
 		return;
-
-	if (c == '\r')
+	}
+	if (r < 0)
 		return;
 
-	if (c != '\n')
+	for (int i = 0; i < r; ++i)
 	{
-		buffer.append(c);
-		return;
+		char c = buf[i];
+		if (c == '\r')
+			continue;
+
+		if (c != '\n')
+		{
+			buffer.append(c);
+			continue;
+		}
+
+		processLine(QString(buffer));
+		buffer.truncate(0);
 	}
+}
 
-	QString msg = QString(buffer);
-	if (msg.startsWith("E"))
+void ThermCam::processLine(const QString &msg)
+{
+	// sensor errors during scan are handled by rescanning
+	if (msg.startsWith("Et") && scan.inProgress)
+		TC_LOG(CategorySerial, LevelWarning, emit warning(tr("Line: %1").arg(msg)));
+	else if (msg.startsWith("E"))
 		emit error(tr("Line: %1").arg(msg));
+	else if (msg.startsWith("W"))
+		TC_LOG(CategorySerial, LevelWarning, emit warning(tr("Line: %1").arg(msg)));
+	else if (msg.startsWith("I"))
+		TC_LOG(CategorySerial, LevelInfo, emit info(tr("Line: %1").arg(msg)));
 	else
-		emit info(tr("Line: %1").arg(msg));
+		emit error(tr("Line with invalid format: %1").arg(msg));
 
-	if (!msg.startsWith("I") && !msg.startsWith("E"))
-		emit error(tr("Above message has invalid format!"));
-	else if (msg.startsWith("Idims:"))
+	if (msg.startsWith("Et4") && scan.inProgress && scan.awaiting && !scan.sweeping && x == scan.x && y == scan.y)
+		pointRead(false, 0);
+
+	if (!msg.startsWith("I"))
+		return;
+
+	if (msg.startsWith("Idims:"))
 	{
 		QStringList dims = msg.split(":").takeLast().split(",");
 		xmin = dims[0].toInt();
@@ -207,7 +356,9 @@ void ThermCam::fdActivated(int fd)
 		if (ok)
 		{
 			x = tmpx;
-			emit scannerMoved_X(x);
+			// during scan position is reported together with samples
+			if (!scan.inProgress)
+				emit scannerMoved_X(x);
 		}
 	}
 	else if (msg.startsWith("Iy: "))
@@ -220,38 +371,51 @@ void ThermCam::fdActivated(int fd)
 			emit scannerMoved_Y(y);
 		}
 	}
-	else if (msg.startsWith("Ito:") || msg.startsWith("Ita:"))
+	else if (msg.startsWith("Ito") || msg.startsWith("Ita"))
 	{
-		bool ok;
-		QString t = msg.mid(2);
-		QStringList tt = t.split(":");
+		// "o: 21.50"; r after sensor means raw reading, v - variance follows value
+		QStringList tt = msg.mid(2).split(":");
+		bool ok = tt.size() == 2;
+		QString tag = ok ? tt[0] : QString();
+		QStringList vals = ok ? tt[1].split(" ", QString::SkipEmptyParts) : QStringList();
+		bool raw = tag.contains('r'), withVariance = tag.contains('v');
+		if (vals.size() != (withVariance ? 2 : 1))
+			ok = false;
+
+		float temp = 0, variance = -1;
+		if (ok && raw)
+		{
+			uint r = vals[0].toUInt(&ok);
+			temp = tag[0] == 'o' ? calibration.toCelsius(r) : Calibration::rawToCelsius(r);
+		}
+		else if (ok)
+		{
+			temp = vals[0].toFloat(&ok);
+			if (tag[0] == 'o')
+				temp = calibration.correct(temp);
+		}
+		if (ok && withVariance)
+			variance = vals[1].toFloat(&ok);
 
-		float temp = tt[1].toFloat(&ok);
 		if (ok)
 		{
-			if (tt[0] == QString("o"))
-				emit objectTemperatureRead(x, y, temp);
-			else if (tt[0] == QString("a"))
+			if (tag[0] == 'a')
+			{
+				if (scan.inProgress)
+					emit rowAmbientRead(scan.y, temp);
 				emit ambientTemperatureRead(temp);
-
-			if (scan.inProgress)
+			}
+			else if (tag[0] == 'o')
 			{
-				if (x == scan.xmax)
+				if (!scan.inProgress)
+					emit objectTemperatureRead(x, y, temp);
+				else if (!scan.awaiting || scan.sweeping || x != scan.x || y != scan.y)
 				{
-					if (y == scan.ymax)
-						stopScanning();
-					else
-					{
-						sendCommand_moveY(y + 1);
-						sendCommand_moveX(scan.xmin);
-						sendCommand_readObjectTemp();
-					}
+					// reply to retransmitted command which was answered already
+					TC_LOG(CategoryScan, LevelDebug, emit debug(tr("Ignoring stale reply for %1 / %2").arg(x).arg(y)));
 				}
 				else
-				{
-					sendCommand_moveX(x + 1);
-					sendCommand_readObjectTemp();
-				}
+					pointRead(temp != -1000, temp, variance); // -1000 - calibration can't explain reading
 			}
 		}
 		else
@@ -259,29 +423,408 @@ void ThermCam::fdActivated(int fd)
 	}
 	else if (msg.startsWith("Isf"))
 	{
-		sendCommand("mon!px90!py90!to!ta!");
+		// device was reset in the middle of scan, continue where it stopped
+		if (scan.inProgress)
+		{
+			sendCommand(initCommands() + "jd!");
+			repeatStep();
+		}
+		else
+			sendCommand(initCommands() + "px90!py90!to!ta!");
 	}
-	buffer.truncate(0);
+	else if (msg.startsWith("Ifb "))
+	{
+		QStringList fb = msg.mid(4).split(" ");
+		if (fb.size() == 2)
+		{
+			float temp = rawMode ? calibration.toCelsius(fb[1].toUInt()) : calibration.correct(fb[1].toFloat());
+			emit settleMeasured(fb[0].toInt(), temp);
+		}
+	}
+	else if (msg.startsWith("Isws ") && scan.sweeping)
+	{
+		// sweep started, samples of previous (interrupted) attempt are useless
+		scan.samples.resize(0);
+	}
+	else if ((msg.startsWith("Isw: ") || msg.startsWith("Iswr: ")) && scan.sweeping)
+	{
+		bool raw = msg.startsWith("Iswr: ");
+		QStringList sw = msg.mid(raw ? 6 : 5).split(" ");
+		bool ok1 = false, ok2 = false, ok3 = false;
+		SweepSample s;
+		if (sw.size() == 3)
+		{
+			s.time = sw[0].toUInt(&ok1);
+			s.pos100 = sw[1].toInt(&ok2);
+			if (raw)
+				s.temp = calibration.toCelsius(sw[2].toUInt(&ok3));
+			else
+				s.temp = calibration.correct(sw[2].toFloat(&ok3));
+		}
+		if (ok1 && ok2 && ok3)
+		{
+			if (s.temp != -1000)
+				scan.samples.append(s);
+		}
+		else
+			TC_LOG(CategorySerial, LevelWarning, emit warning(tr("Invalid sweep sample: %1").arg(msg)));
+	}
+	else if (msg.startsWith("Iswe ") && scan.sweeping && scan.awaiting)
+	{
+		QStringList sw = msg.mid(5).split(" ");
+		if (sw.size() == 2 && sw[0].toInt() == scan.y)
+			sweepRead();
+	}
+}
+
+void ThermCam::queueSample(int x, int y, float temp, float variance)
+{
+	if (!pending.temps.isEmpty() && (y != pending.y || x != pending.x + pending.temps.size()))
+		flushSamples();
+
+	if (pending.temps.isEmpty())
+	{
+		pending.x = x;
+		pending.y = y;
+	}
+	pending.temps.append(temp);
+	pending.variances.append(variance);
+	if (variance >= 0)
+		pending.haveVariance = true;
+
+	if (!flushTimer->isActive())
+		flushTimer->start();
+}
+
+void ThermCam::flushSamples()
+{
+	flushTimer->stop();
+	if (pending.temps.isEmpty())
+		return;
+
+	emit samplesRead(pending.x, pending.y, pending.temps);
+	if (pending.haveVariance)
+		emit variancesRead(pending.x, pending.y, pending.variances);
+	emit scannerMoved_X(x);
+	pending.temps.resize(0);
+	pending.variances.resize(0);
+	pending.haveVariance = false;
 }
 
-void ThermCam::scanImage(int xmin, int xmax, int ymin, int ymax)
+void ThermCam::scanImage(int xmin, int xmax, int ymin, int ymax, int ystart)
 {
 	scan.xmin = xmin;
 	scan.xmax = xmax;
 	scan.ymin = ymin;
 	scan.ymax = ymax;
+	scan.row.fill(-1000, xmax - xmin + 1);
+	scan.rescan.clear();
+	scan.rescanning = false;
+	scan.lastValid = -1000;
+	scan.spikeX = -1;
+	if (ystart < ymin || ystart > ymax)
+		ystart = ymin;
 
 	scan.inProgress = true;
 	sendCommand("jd!"); // joystick disable
-	sendCommand_moveY(scan.ymin);
-	sendCommand_moveX(scan.xmin);
-	sendCommand_readObjectTemp();
+	startRow(ystart);
+}
+
+void ThermCam::setScanMode(ScanMode mode, int msPerDegree, int lagMs)
+{
+	// applies from the next row
+	scanMode = mode;
+	sweepRate = msPerDegree;
+	sweepLag = lagMs;
+}
+
+void ThermCam::setRawMode(bool raw)
+{
+	rawMode = raw;
+	if (fd != -1)
+		sendCommand(raw ? "cr!" : "cc!");
+}
+
+void ThermCam::setFilter(const FilterPreset &preset)
+{
+	filterIir = preset.iir;
+	filterFir = preset.fir;
+	settleMs = preset.settleMs;
+	if (fd != -1)
+		sendCommand(filterCommands());
+}
+
+void ThermCam::setSampling(int count, bool trimmed)
+{
+	samplesPerPoint = count;
+	trimmedMean = trimmed;
+	if (fd != -1)
+		sendCommand("n" + QByteArray::number(samplesPerPoint) + "," + QByteArray::number(trimmedMean ? 1 : 0) + "!");
+}
+
+QByteArray ThermCam::filterCommands()
+{
+	if (filterIir < 0)
+		return QByteArray();
+	return "fw" + QByteArray::number(filterIir) + "," + QByteArray::number(filterFir) + "!fs" +
+			QByteArray::number(settleMs) + "!";
+}
+
+QByteArray ThermCam::initCommands()
+{
+	QByteArray cmd = "mon!";
+	cmd += rawMode ? "cr!" : "cc!";
+	cmd += filterCommands();
+	cmd += "n" + QByteArray::number(samplesPerPoint) + "," + QByteArray::number(trimmedMean ? 1 : 0) + "!";
+	return cmd;
+}
+
+void ThermCam::startRow(int _y)
+{
+	// sensor body warms up during scan, see Drift
+	if (ambientInterval > 0 && (_y - scan.ymin) % ambientInterval == 0)
+		sendCommand("ta!");
+
+	if (scanMode == ScanSweep && scan.xmax > scan.xmin)
+		sendSweep(_y);
+	else
+		sendStep(scan.xmin, _y);
+}
+
+void ThermCam::rescanPoint(int x)
+{
+	scan.rescan.append(x);
+	TC_LOG(CategoryScan, LevelInfo, emit info(tr("Point %1 / %2 will be read again").arg(x).arg(scan.y)));
+	emit pointRescanned(x, scan.y);
+}
+
+/* Handles reply for the point being scanned and moves on. Points which
+ * failed or differ too much from both neighbours are read again at the end
+ * of the row, once. A point differing only from its left neighbour starts a
+ * real edge and becomes the new reference.
+ */
+void ThermCam::pointRead(bool ok, float temp, float variance)
+{
+	scan.awaiting = false;
+	watchdog->stop();
+
+	if (ok)
+	{
+		queueSample(scan.x, scan.y, temp, variance);
+		scan.row[scan.x - scan.xmin] = temp;
+	}
+
+	if (ok && !scan.rescanning)
+	{
+		if (scan.spikeX != -1)
+		{
+			if (qAbs(temp - scan.spikeTemp) <= SPIKE_THRESHOLD)
+				scan.lastValid = scan.spikeTemp;
+			else
+				rescanPoint(scan.spikeX);
+			scan.spikeX = -1;
+		}
+
+		if (scan.lastValid != -1000 && qAbs(temp - scan.lastValid) > SPIKE_THRESHOLD)
+		{
+			scan.spikeX = scan.x;
+			scan.spikeTemp = temp;
+		}
+		else
+			scan.lastValid = temp;
+	}
+	else if (!scan.rescanning)
+		rescanPoint(scan.x);
+
+	// last point has no right neighbour to judge it
+	if (!scan.rescanning && scan.x == scan.xmax && scan.spikeX != -1)
+	{
+		rescanPoint(scan.spikeX);
+		scan.spikeX = -1;
+	}
+
+	if (!scan.rescanning && scan.x < scan.xmax)
+	{
+		sendStep(scan.x + 1, scan.y);
+		return;
+	}
+
+	finishRow();
+}
+
+/* Turns samples of finished sweep into row. Points with no samples around
+ * them are read again one by one, like failed points in step mode.
+ */
+void ThermCam::sweepRead()
+{
+	scan.awaiting = false;
+	scan.sweeping = false;
+	watchdog->stop();
+
+	QVector<float> temps(scan.row.size());
+	Sweep::resample(scan.samples, scan.xmin, scan.xmax, sweepRate, sweepLag, scan.xmin, temps);
+	TC_LOG(CategoryScan, LevelDebug, emit debug(tr("Row %1: %2 samples").arg(scan.y).arg(scan.samples.size())));
+	scan.samples.resize(0);
+
+	for (int i = 0; i < temps.size(); ++i)
+	{
+		if (temps[i] != -1000)
+		{
+			queueSample(scan.xmin + i, scan.y, temps[i]);
+			scan.row[i] = temps[i];
+		}
+		else
+		{
+			scan.rescan.append(scan.xmin + i);
+			emit pointRescanned(scan.xmin + i, scan.y);
+		}
+	}
+	if (!scan.rescan.isEmpty())
+		TC_LOG(CategoryScan, LevelInfo, emit info(tr("%1 points of row %2 will be read again").arg(scan.rescan.size()).arg(scan.y)));
+
+	finishRow();
+}
+
+void ThermCam::finishRow()
+{
+	if (!scan.rescan.isEmpty())
+	{
+		scan.rescanning = true;
+		sendStep(scan.rescan.takeFirst(), scan.y);
+		return;
+	}
+
+	flushSamples();
+	emit rowScanned(scan.y, scan.row);
+	scan.row.fill(-1000);
+	scan.rescanning = false;
+	scan.lastValid = -1000;
+	scan.spikeX = -1;
+
+	if (scan.y == scan.ymax)
+		stopScanning();
+	else
+		startRow(scan.y + 1);
+}
+
+/* Moves to (x, y) and reads temperature there. All commands are idempotent,
+ * so they are just sent again if reply does not come in time.
+ */
+void ThermCam::sendStep(int _x, int _y)
+{
+	scan.x = _x;
+	scan.y = _y;
+	scan.awaiting = true;
+	scan.sweeping = false;
+	scan.retries = 0;
+
+	scan.step.truncate(0);
+	if (_y != y || _x == scan.xmin)
+		scan.step += "py" + QByteArray::number(_y) + "!";
+	scan.step += "px" + QByteArray::number(_x) + "!to!";
+
+	sendCommand(scan.step);
+	watchdog->start(COMMAND_TIMEOUT);
+}
+
+/* Reads whole row y with one command, the device replies with stream of
+ * samples taken while moving from xmin to xmax.
+ */
+void ThermCam::sendSweep(int _y)
+{
+	scan.x = scan.xmin;
+	scan.y = _y;
+	scan.awaiting = true;
+	scan.sweeping = true;
+	scan.retries = 0;
+	scan.samples.resize(0);
+
+	scan.step = "sw" + QByteArray::number(_y) + "," + QByteArray::number(scan.xmin) + "," +
+			QByteArray::number(scan.xmax) + "," + QByteArray::number(sweepRate) + "!";
+
+	sendCommand(scan.step);
+	// reply comes after the whole sweep
+	watchdog->start(COMMAND_TIMEOUT + (scan.xmax - scan.xmin) * sweepRate);
+}
+
+void ThermCam::repeatStep()
+{
+	if (scan.sweeping)
+		sendSweep(scan.y);
+	else
+		sendStep(scan.x, scan.y);
+}
+
+void ThermCam::watchdogTimeout()
+{
+	if (!scan.inProgress || !scan.awaiting || fd == -1)
+		return;
+
+	if (++scan.retries > MAX_RETRIES)
+	{
+		emit error(tr("Device does not respond, scan stopped at %1 / %2").arg(scan.x).arg(scan.y));
+		stopScanning();
+		return;
+	}
+
+	emit warning(tr("No reply to '%1', sending it again (%2 of %3)").arg(scan.step.constData())
+			.arg(scan.retries).arg(MAX_RETRIES));
+	// garbage left by a lost or damaged reply must not be glued to the next one
+	buffer.truncate(0);
+	sendCommand(scan.step);
+	watchdog->start();
+}
+
+void ThermCam::linkLost(const QString &reason)
+{
+	emit warning(tr("%1: connection lost (%2), waiting for the device").arg(devicePath).arg(reason));
+	watchdog->stop();
+	flushSamples();
+	closeDevice();
+	reconnectTimer->start();
+	devWatcher->addPath("/dev");
+	emit connectionLost();
+}
+
+void ThermCam::devChanged()
+{
+	QTimer::singleShot(HOTPLUG_DELAY, this, SLOT(tryReconnect()));
+}
+
+void ThermCam::tryReconnect()
+{
+	// hotplug and timer can both fire
+	if (fd != -1 || devicePath.isNull())
+		return;
+
+	if (!QFile::exists(devicePath))
+		return;
+
+	if (!openDevice(devicePath))
+		return;
+
+	reconnectTimer->stop();
+	devWatcher->removePath("/dev");
+	emit info(tr("%1: reconnected").arg(devicePath));
+	emit reconnected();
+
+	// if device was not reset, Isf won't come, watchdog takes care of it
+	if (scan.inProgress)
+	{
+		sendCommand("jd!");
+		repeatStep();
+	}
 }
 
 void ThermCam::stopScanning()
 {
+	watchdog->stop();
+	flushSamples();
 	scan.inProgress = false;
-	sendCommand("je!"); // joystick enable
+	scan.awaiting = false;
+	scan.sweeping = false;
+	if (fd != -1)
+		sendCommand("je!"); // joystick enable
 	emit scanningStopped();
 }
 
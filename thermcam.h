@@ -2,42 +2,154 @@
 #define THERMCAM_H_
 
 #include <qobject.h>
+#include <QList>
+#include <QVector>
 
+#include "calibration.h"
+#include "sweep.h"
+
+class QFileSystemWatcher;
 class QSocketNotifier;
+class QTimer;
 
 namespace QThermCam
 {
 
+/* MLX90614 IIR/FIR filter settings and time the sensor needs with them */
+struct FilterPreset
+{
+	const char *name;
+	int iir, fir;
+	int settleMs;
+};
+
+extern const FilterPreset filterPresets[];
+enum { FILTER_PRESET_COUNT = 4 };
+
 class ThermCam : public QObject
 {
 	Q_OBJECT
+	public:
+	enum ScanMode { ScanStep, ScanSweep };
+
 	private:
+	enum { MAX_OUTPUT_QUEUE = 4096 };
+	/* sensor read can be retried by the device, it takes 5s */
+	enum { COMMAND_TIMEOUT = 8000, MAX_RETRIES = 3, RECONNECT_INTERVAL = 1000 };
+	/* udev sets permissions of a new node a moment after it appears */
+	enum { HOTPLUG_DELAY = 200 };
+	/* difference from the previous point which makes reading suspicious */
+	enum { SPIKE_THRESHOLD = 10 };
+
 	QString devicePath;
 	int fd;
-	QSocketNotifier *notifier;
+	QSocketNotifier *notifier, *writeNotifier;
 	QByteArray buffer;
+	QByteArray outQueue;
+	QTimer *writeTimer;
 	int xmin, xmax, ymin, ymax;
 	int x, y;
+	ScanMode scanMode;
+	int sweepRate, sweepLag;
+	/* device sends raw readings, converted here */
+	bool rawMode;
+	Calibration calibration;
+	/* -1 - leave device filters alone */
+	int filterIir, filterFir, settleMs;
+	/* device takes that many readings per point and rejects outliers */
+	int samplesPerPoint;
+	bool trimmedMean;
+	/* ambient temperature is read every that many rows, 0 - never */
+	int ambientInterval;
 
 	struct
 	{
 		int xmin, xmax, ymin, ymax;
 		bool inProgress;
+		/* current row, -1000 for points not read yet */
+		QVector<float> row;
+		/* point being read and commands sent for it */
+		int x, y;
+		bool awaiting;
+		int retries;
+		QByteArray step;
+		/* points of current row to read again */
+		QList<int> rescan;
+		bool rescanning;
+		float lastValid;
+		/* point differing from lastValid, judged by its right neighbour;
+		 * -1 if none */
+		int spikeX;
+		float spikeTemp;
+		/* whole row is being read by one sweep command */
+		bool sweeping;
+		QVector<SweepSample> samples;
 	} scan;
+	QTimer *watchdog, *reconnectTimer;
+	/* notices device node coming back sooner than reconnectTimer */
+	QFileSystemWatcher *devWatcher;
 
+	/* consecutive samples from one row, not yet delivered */
+	struct
+	{
+		int x, y;
+		QVector<float> temps;
+		/* -1 where not known */
+		QVector<float> variances;
+		bool haveVariance;
+	} pending;
+	QTimer *flushTimer;
+
+	bool openDevice(const QString &path);
+	void closeDevice();
+	void linkLost(const QString &reason);
+	void sendStep(int x, int y);
+	void sendSweep(int y);
+	/* sends again whatever the device should be doing now */
+	void repeatStep();
+	void startRow(int y);
+	void finishRow();
+	void rescanPoint(int x);
+	void pointRead(bool ok, float temp, float variance = -1);
+	void sweepRead();
+	/* puts device into state this object expects */
+	QByteArray initCommands();
+	QByteArray filterCommands();
 	bool sendCommand(const QByteArray &cmd);
-
-	static bool lockDevice(const QString &devicePath, QString &err);
-	static void unlockDevice(const QString &devicePath, QString &err);
+	void processLine(const QString &msg);
+	void queueSample(int x, int y, float temp, float variance = -1);
 
 	public:
 	ThermCam(QObject *parent);
 
+	/* uucp-style lock files in /var/lock, shared with other serial tools */
+	static bool lockDevice(const QString &devicePath, QString &err);
+	static void unlockDevice(const QString &devicePath, QString &err);
+
 	bool doConnect(const QString &path);
 	void doDisconnect();
 	bool connected() { return fd != -1; }
+	/* device disappeared and is being waited for */
+	bool reconnecting() { return fd == -1 && !devicePath.isNull(); }
 	bool scanInProgress() { return scan.inProgress; }
 
+	/* sweep mode moves X servo continuously at msPerDegree and reads as fast
+	 * as possible; lagMs is the sensor response time compensated on the host */
+	void setScanMode(ScanMode mode, int msPerDegree, int lagMs);
+
+	void setRawMode(bool raw);
+	/* applies to temperatures read from now on */
+	void setCalibration(const Calibration &c) { calibration = c; }
+
+	/* writes sensor filter configuration, device keeps it in EEPROM */
+	void setFilter(const FilterPreset &preset);
+	bool sendCommand_settleBenchmark(int from, int to);
+
+	/* count readings per point, median or mean of the middle half of them */
+	void setSampling(int count, bool trimmed);
+
+	void setAmbientInterval(int rows) { ambientInterval = rows; }
+
 	bool sendCommand_readObjectTemp();
 	bool sendCommand_readAmbientTemp();
 	bool sendCommand_moveX(int newPos);
@@ -45,20 +157,46 @@ class ThermCam : public QObject
 
 	public slots:
 	void fdActivated(int fd);
+	/* writes as much of queued commands as tty accepts without blocking */
+	void flushOutput();
 
-	void scanImage(int xmin, int xmax, int ymin, int ymax);
+	/* ystart > ymin continues scan which was interrupted at row ystart */
+	void scanImage(int xmin, int xmax, int ymin, int ymax, int ystart = -1);
 	void stopScanning();
 
+	/* delivers samples queued during scan */
+	void flushSamples();
+
+	private slots:
+	void watchdogTimeout();
+	void devChanged();
+	void tryReconnect();
+
 	signals:
 	void scannerReady(int xmin, int xmax, int ymin, int ymax);
 
 	void objectTemperatureRead(int x, int y, float temp);
+	/* temps[i] was read at (x + i, y); used instead of objectTemperatureRead during scan */
+	void samplesRead(int x, int y, const QVector<float> &temps);
 	void ambientTemperatureRead(float temp);
+	/* ambient temperature read at the beginning of row y */
+	void rowAmbientRead(int y, float temp);
+	/* time in ms after which readings stopped changing, -1 if they didn't */
+	void settleMeasured(int ms, float temp);
+	/* whole row y was scanned, emitted after samplesRead */
+	void rowScanned(int y, const QVector<float> &temps);
+	/* variances (C^2) of samples from samplesRead, only with multiple readings per point */
+	void variancesRead(int x, int y, const QVector<float> &variances);
+	/* reading at (x, y) failed or looked wrong, it will be repeated */
+	void pointRescanned(int x, int y);
 	void scannerMoved_X(int x);
 	void scannerMoved_Y(int y);
 
 	void scanningStopped();
 
+	void connectionLost();
+	void reconnected();
+
 	void debug(const QString &msg);
 	void info(const QString &msg);
 	void warning(const QString &msg);
@@ -19,6 +19,7 @@
 
 #include <SPI.h>
 #include <SD.h>
+#include "temp.h"
 
 #define SD_CS_PIN 10
 #define SD_POWER_ENABLE_PIN 3
@@ -73,8 +74,6 @@ void sd_init()
   sd_off();
 }
 
-static int ymin_, ymax_, xmin_, xmax_;
-
 bool sd_open_new_file(int ymin, int ymax, int xmin, int xmax)
 {
   sd_on();
@@ -105,38 +104,68 @@ bool sd_open_new_file(int ymin, int ymax, int xmin, int xmax)
   file.print(ymax);
   file.print(_("\" xmax=\""));
   file.print(xmax);
-  file.print(_("\"/>\n <data>\n"));
-  ymin_ = ymin;
-  ymax_ = ymax;
-  xmin_ = xmin;
-  xmax_ = xmax;
-  
+  if (raw_mode)
+    file.print(_("\"/>\n <data units=\"raw\">\n"));
+  else
+    file.print(_("\"/>\n <data>\n"));
+
   return true;
 }
 
-void sd_dump_data(double *temps, int y, int x_start, int x_count)
+void sd_begin_row(int y)
 {
   if (!sd_ok || !file)
     return;
 
-  if (x_start == xmin_)
-  {
-    file.print(_("  <row y=\""));
-    file.print(y);
-    file.print(_("\">\n"));
-  }
+  file.print(_("  <row y=\""));
+  file.print(y);
+  file.print(_("\">\n"));
+}
+
+static void sd_print_temp(unsigned int raw)
+{
+  if (raw_mode)
+    file.print(raw);
+  else
+    file.print(raw_to_celsius(raw));
+}
+
+void sd_dump_data(unsigned int *raws, int x_start, int x_count)
+{
+  if (!sd_ok || !file)
+    return;
 
   for (int i = 0; i < x_count; ++i)
   {
     file.print(_("   <col x=\""));
     file.print(x_start + i);
     file.print(_("\" val=\""));
-    file.print(temps[i]);
+    sd_print_temp(raws[i]);
     file.print(_("\"/>\n"));
   }
+}
+
+/* point which failed or looked wrong; may be written twice, the later valid
+   value wins */
+void sd_dump_rescanned(int x, unsigned int raw, bool valid)
+{
+  if (!sd_ok || !file)
+    return;
+
+  file.print(_("   <col x=\""));
+  file.print(x);
+  file.print(_("\" val=\""));
+  if (valid)
+    sd_print_temp(raw);
+  file.print(_("\" rescan=\"1\"/>\n"));
+}
+
+void sd_end_row()
+{
+  if (!sd_ok || !file)
+    return;
 
-  if (x_start + x_count - 1 == xmax_)
-    file.print(_("  </row>\n"));
+  file.print(_("  </row>\n"));
 }
 
 void sd_remove_file()
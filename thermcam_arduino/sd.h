@@ -6,13 +6,19 @@
 #if SD_ENABLED == 1
 void sd_init();
 bool sd_open_new_file(int ymin, int ymax, int xmin, int xmax);
-void sd_dump_data(double *temps, int y, int x_start, int x_count);
+void sd_begin_row(int y);
+void sd_dump_data(unsigned int *raws, int x_start, int x_count);
+void sd_dump_rescanned(int x, unsigned int raw, bool valid);
+void sd_end_row();
 void sd_remove_file();
 void sd_close_file();
 #else
 static inline void sd_init(){}
 static inline bool sd_open_new_file(int ymin, int ymax, int xmin, int xmax){ return true; }
-static inline void sd_dump_data(double *temps, int y, int x_start, int x_count){}
+static inline void sd_begin_row(int y){}
+static inline void sd_dump_data(unsigned int *raws, int x_start, int x_count){}
+static inline void sd_dump_rescanned(int x, unsigned int raw, bool valid){}
+static inline void sd_end_row(){}
 static inline void sd_remove_file(){}
 static inline void sd_close_file(){}
 #endif
@@ -33,12 +33,16 @@ static Servo servo_y;
 
 int x = 90;
 int y = 90;
+unsigned long last_move_time;
 
 static int targetx, targety;
 static bool update;
 static unsigned long next_update_time;
+// smooth moves go by 1 degree every step_ms
+#define DEFAULT_STEP_MS 10
+static int step_ms = DEFAULT_STEP_MS;
 
-void servo_init()
+void servo_print_dims()
 {
   Serial.print(_("Idims:"));
   Serial.print(SERVO_X_MIN);
@@ -48,6 +52,11 @@ void servo_init()
   Serial.print(SERVO_Y_MIN);
   Serial.print(',');
   Serial.println(SERVO_Y_MAX);
+}
+
+void servo_init()
+{
+  servo_print_dims();
 
   update = false;
   targetx = x;
@@ -57,6 +66,7 @@ void servo_init()
   servo_y.attach(SERVO_Y_PIN);
   servo_x.write(x);
   servo_y.write(y);
+  last_move_time = millis();
 }
 
 bool move_x(int newpos, bool print_errors, bool smooth)
@@ -91,6 +101,7 @@ bool move_x(int newpos, bool print_errors, bool smooth)
   {
     targetx = newpos;
     update = true;
+    step_ms = DEFAULT_STEP_MS;
     next_update_time = millis();
   }
   else
@@ -98,6 +109,7 @@ bool move_x(int newpos, bool print_errors, bool smooth)
     x = newpos;
     targetx = x;
     servo_x.write(x);
+    last_move_time = millis();
   }
   print(_("Ix: "));
   println(x);
@@ -136,6 +148,7 @@ bool move_y(int newpos, bool print_errors, bool smooth)
   {
     targety = newpos;
     update = true;
+    step_ms = DEFAULT_STEP_MS;
     next_update_time = millis();
   }
   else
@@ -143,6 +156,7 @@ bool move_y(int newpos, bool print_errors, bool smooth)
     y = newpos;
     targety = y;
     servo_y.write(y);
+    last_move_time = millis();
   }
 
   print(_("Iy: "));
@@ -150,6 +164,22 @@ bool move_y(int newpos, bool print_errors, bool smooth)
   return true;
 }
 
+/* moves x servo at constant rate, maybe_update_servos has to be called
+   often; doesn't print new position */
+void sweep_x(int newpos, int ms_per_degree)
+{
+  if (newpos < SERVO_X_MIN)
+    newpos = SERVO_X_MIN;
+  if (newpos > SERVO_X_MAX)
+    newpos = SERVO_X_MAX;
+
+  targetx = newpos;
+  targety = y;
+  step_ms = ms_per_degree;
+  update = true;
+  next_update_time = millis() + ms_per_degree;
+}
+
 void maybe_update_servos()
 {
   if (!update)
@@ -157,7 +187,7 @@ void maybe_update_servos()
   if (millis() < next_update_time)
     return;
 
-  next_update_time += 10;
+  next_update_time += step_ms;
   update = false;
   if (targetx != x)
   {
@@ -167,6 +197,7 @@ void maybe_update_servos()
       x--;
 
     servo_x.write(x);
+    last_move_time = millis();
     update = true;
   }
 
@@ -178,6 +209,7 @@ void maybe_update_servos()
       y--;
 
     servo_y.write(y);
+    last_move_time = millis();
     update = true;
   }
 }
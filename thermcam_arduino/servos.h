@@ -2,10 +2,14 @@
 #define TC_SERVOS_H
 
 extern int x, y;
+/* millis() of the last servo step */
+extern unsigned long last_move_time;
 
 void servo_init();
+void servo_print_dims();
 bool move_x(int newpos, bool print_errors = 1, bool smooth = false);
 bool move_y(int newpos, bool print_errors = 1, bool smooth = false);
+void sweep_x(int newpos, int ms_per_degree);
 void maybe_update_servos();
 void servos_alloc_time(int us);
 
@@ -22,17 +22,38 @@
 
 #define SENSOR_SLAVE_ADDRESS 0x5A
 
+bool raw_mode = false;
+unsigned int settle_ms = 100;
+int samples_per_point = 1;
+bool trimmed_mean = false;
+
+#define CONFIG_REGISTER1 0x25 // EEPROM 0x05
+#define CONFIG_IIR_MASK 0x0007
+#define CONFIG_FIR_MASK 0x0700
+#define CONFIG_FIR_SHIFT 8
+// FIR settings below 100b are not recommended by the datasheet
+#define CONFIG_FIR_MIN 4
+
 void temp_init()
 {
   Wire.begin();
 }
 
-bool read_temp(enum sensor s, double *temp)
+/* SMBus packet error code, CRC-8 with polynomial x^8 + x^2 + x + 1 */
+static unsigned char crc8(unsigned char crc, unsigned char data)
+{
+  crc ^= data;
+  for (int i = 0; i < 8; ++i)
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  return crc;
+}
+
+static bool read_word(unsigned char cmd, unsigned int *value)
 {
   int r;
   
   Wire.beginTransmission(SENSOR_SLAVE_ADDRESS);
-  Wire.write(s);
+  Wire.write(cmd);
   servos_alloc_time(300);
   r = Wire.endTransmission(false);
   if (r)
@@ -60,16 +81,202 @@ bool read_temp(enum sensor s, double *temp)
       bytes[i] = c;
     i++;
   }
-    
-  if (bytes[1] & 0x80)
+
+  unsigned char pec = 0;
+  pec = crc8(pec, SENSOR_SLAVE_ADDRESS << 1);
+  pec = crc8(pec, cmd);
+  pec = crc8(pec, (SENSOR_SLAVE_ADDRESS << 1) | 1);
+  pec = crc8(pec, bytes[0]);
+  pec = crc8(pec, bytes[1]);
+  if (pec != bytes[2])
+  {
+    println(_("Et5")); // PEC mismatch, data damaged on the bus
+    return false;
+  }
+
+  *value = (bytes[1] << 8) | bytes[0];
+  return true;
+}
+
+static bool write_word(unsigned char cmd, unsigned int value)
+{
+  unsigned char lsb = value & 0xFF, msb = value >> 8;
+  unsigned char pec = 0;
+  pec = crc8(pec, SENSOR_SLAVE_ADDRESS << 1);
+  pec = crc8(pec, cmd);
+  pec = crc8(pec, lsb);
+  pec = crc8(pec, msb);
+
+  Wire.beginTransmission(SENSOR_SLAVE_ADDRESS);
+  Wire.write(cmd);
+  Wire.write(lsb);
+  Wire.write(msb);
+  Wire.write(pec);
+  servos_alloc_time(450);
+  int r = Wire.endTransmission();
+  if (r)
+  {
+    print(_("Et6 ")); // write failed
+    println(r);
+    return false;
+  }
+  return true;
+}
+
+bool read_raw(enum sensor s, unsigned int *raw)
+{
+  unsigned int value;
+  if (!read_word(s, &value))
+    return false;
+
+  if (value & 0x8000)
   {
     println(_("Et3")); // error bit set
     return false;
   }
 
-  *temp = ((bytes[1] & 0x7F) << 8) + bytes[0];
-  *temp = (*temp * 0.02) - 273.15;
-  
+  *raw = value;
+  return true;
+}
+
+bool read_raw_multi(enum sensor s, unsigned int *raw, double *variance)
+{
+  unsigned int v[MAX_SAMPLES_PER_POINT];
+  int n = 0;
+
+  *variance = 0;
+  if (samples_per_point <= 1)
+    return read_raw(s, raw);
+
+  // tight loop, servo move and settle are paid only once
+  for (int i = 0; i < samples_per_point; ++i)
+    if (read_raw(s, &v[n]))
+      n++;
+
+  // too many failures, can't tell what is an outlier
+  if (n < (samples_per_point + 1) / 2)
+    return false;
+
+  // insertion sort, n <= 16
+  for (int i = 1; i < n; ++i)
+  {
+    unsigned int t = v[i];
+    int j = i - 1;
+    for (; j >= 0 && v[j] > t; --j)
+      v[j + 1] = v[j];
+    v[j + 1] = t;
+  }
+
+  int lo = n / 4, hi = n - n / 4;
+  double sum = 0;
+  for (int i = lo; i < hi; ++i)
+    sum += v[i];
+  double mean = sum / (hi - lo);
+
+  double sq = 0;
+  for (int i = lo; i < hi; ++i)
+    sq += (v[i] - mean) * (v[i] - mean);
+  // 0.02 K per unit
+  *variance = sq / (hi - lo) * 0.0004;
+
+  if (trimmed_mean)
+    *raw = (unsigned int)(mean + 0.5);
+  else if (n % 2)
+    *raw = v[n / 2];
+  else
+    *raw = (v[n / 2 - 1] + v[n / 2] + 1) / 2;
+  return true;
+}
+
+bool read_filter_config(int *iir, int *fir)
+{
+  unsigned int cfg;
+  if (!read_word(CONFIG_REGISTER1, &cfg))
+    return false;
+
+  *iir = cfg & CONFIG_IIR_MASK;
+  *fir = (cfg & CONFIG_FIR_MASK) >> CONFIG_FIR_SHIFT;
+  return true;
+}
+
+#define CONFIG_WRITE_ATTEMPTS 3
+
+/* EEPROM cell has to be erased before write and both take 5ms. Once the
+   cell is erased it holds 0, so keep trying until the value reads back. */
+static bool write_config_word(unsigned int value)
+{
+  for (int t = 0; t < CONFIG_WRITE_ATTEMPTS; ++t)
+  {
+    unsigned int check;
+    bool ok = write_word(CONFIG_REGISTER1, 0);
+    delay(10);
+    ok = ok && write_word(CONFIG_REGISTER1, value);
+    delay(10);
+    if (ok && read_word(CONFIG_REGISTER1, &check) && check == value)
+      return true;
+  }
+
+  return false;
+}
+
+/* Changes only filter bits, the rest of ConfigRegister1 holds factory
+   settings (gain, sensor test, Kt2), which must survive a failed write. */
+enum filter_write_result write_filter_config(int iir, int fir)
+{
+  unsigned int cfg;
+  if (!read_word(CONFIG_REGISTER1, &cfg))
+    return FILTER_WRITE_FAILED;
+
+  if (fir < CONFIG_FIR_MIN)
+    fir = CONFIG_FIR_MIN;
+  unsigned int new_cfg = (cfg & ~(CONFIG_IIR_MASK | CONFIG_FIR_MASK)) | (iir & CONFIG_IIR_MASK) |
+      ((fir << CONFIG_FIR_SHIFT) & CONFIG_FIR_MASK);
+  // don't wear EEPROM out
+  if (new_cfg == cfg)
+    return FILTER_WRITE_OK;
+
+  if (write_config_word(new_cfg))
+    return FILTER_WRITE_OK;
+  if (write_config_word(cfg))
+    return FILTER_WRITE_FAILED;
+  return FILTER_WRITE_CORRUPTED;
+}
+
+void wait_for_settle()
+{
+  unsigned long since_move = millis() - last_move_time;
+  if (since_move < settle_ms)
+    delay(settle_ms - since_move);
+}
+
+double raw_to_celsius(unsigned int raw)
+{
+  return (raw * 0.02) - 273.15;
+}
+
+bool read_temp(enum sensor s, double *temp)
+{
+  unsigned int raw;
+  if (!read_raw(s, &raw))
+    return false;
+
+  *temp = raw_to_celsius(raw);
   return true;
 }
 
+void print_temp(unsigned int raw)
+{
+  if (raw_mode)
+    print((int)raw);
+  else
+    print(raw_to_celsius(raw));
+}
+
+void println_temp(unsigned int raw)
+{
+  if (raw_mode)
+    println((int)raw);
+  else
+    println(raw_to_celsius(raw));
+}
+
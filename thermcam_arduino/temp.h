@@ -5,6 +5,38 @@ void temp_init();
 
 enum sensor {ambient = 0x6, object = 0x7};
 bool read_temp(enum sensor s, double *temp);
+/* 15-bit reading, 0.02 K per unit */
+bool read_raw(enum sensor s, unsigned int *raw);
+double raw_to_celsius(unsigned int raw);
+
+/* Takes samples_per_point readings and rejects outliers - keeps median or
+   mean of the middle half. Variance (in C^2) is computed from the middle
+   half. */
+#define MAX_SAMPLES_PER_POINT 16
+extern int samples_per_point;
+extern bool trimmed_mean;
+bool read_raw_multi(enum sensor s, unsigned int *raw, double *variance);
+
+/* IIR (bits 2:0) and FIR (bits 10:8) filter settings of ConfigRegister1 */
+bool read_filter_config(int *iir, int *fir);
+enum filter_write_result
+{
+  FILTER_WRITE_OK,
+  /* new value did not stick, previous one is back */
+  FILTER_WRITE_FAILED,
+  /* previous value could not be restored, factory bits may be lost */
+  FILTER_WRITE_CORRUPTED
+};
+enum filter_write_result write_filter_config(int iir, int fir);
+
+/* time needed by the sensor after servo move, depends on filters */
+extern unsigned int settle_ms;
+void wait_for_settle();
+
+/* temperatures are sent and stored as raw readings, host converts them */
+extern bool raw_mode;
+void print_temp(unsigned int raw);
+void println_temp(unsigned int raw);
 
 #endif
 
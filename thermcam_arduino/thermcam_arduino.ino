@@ -141,12 +141,68 @@ static void signal_error(int num)
 }
 
 #define MAX_TEMPS 10
-double temps[MAX_TEMPS];
+unsigned int temps[MAX_TEMPS];
+
+// quick retries of a failed read, before the point is left for later
+#define READ_ATTEMPTS 3
+// retries of points left for later, at the end of row
+#define RESCAN_ATTEMPTS 10
+#define MAX_RESCANS 32
+// difference from the previous point which makes reading suspicious (10 C)
+#define SPIKE_THRESHOLD 500
+
+static bool read_object_raw(unsigned int *raw, int attempts, bool &aborted)
+{
+  double variance;
+  for (int t = 0; t < attempts && !aborted; ++t)
+  {
+    if (read_raw_multi(object, raw, &variance))
+      return true;
+
+    delay(100);
+    aborted = joystick_button_pressed() || infrared_stop_button_pressed();
+  }
+
+  return false;
+}
+
+static void print_point(unsigned int raw)
+{
+  print(_("IA "));
+  print(x);
+  print(' ');
+  print(y);
+  print(' ');
+  println_temp(raw);
+}
+
+/* Leaves point for the end of row; it's marked in SD file as rescanned only
+   if it really will be read again. */
+static void add_rescan(unsigned char *rescan, int &rescan_count, int x, int y, unsigned int temp, bool ok)
+{
+  if (rescan_count == MAX_RESCANS)
+  {
+    print(_("Wrs full ")); // too many points to rescan, this one stays as read
+    print(x);
+    print(' ');
+    println(y);
+    if (ok)
+      sd_dump_data(&temp, x, 1);
+    return;
+  }
+
+  rescan[rescan_count++] = x;
+  sd_dump_rescanned(x, temp, ok);
+  print(_("Wrs ")); // point will be rescanned
+  print(x);
+  print(' ');
+  println(y);
+}
 
 static void scan(int left, int top, int right, int bottom)
 {
   bool aborted = false;
-  int tmp, temp_count;
+  int tmp, temp_count, temp_start;
   print(_("Isc ")); // scanning
   print(left);
   print(_(", "));
@@ -175,11 +231,21 @@ static void scan(int left, int top, int right, int bottom)
 
   for (int i = top; i >= bottom && !aborted; i--)
   {
-    int k, t;
+    int k;
+    unsigned char rescan[MAX_RESCANS];
+    int rescan_count = 0;
+    unsigned int prev = 0;
+    bool have_prev = false;
+    // point differing from prev, judged by the next one
+    int spike_x = -1;
+    unsigned int spike_temp = 0;
+
     move_y(i);
     move_x(left);
-    
+    sd_begin_row(i);
+
     temp_count = 0;
+    temp_start = left;
     
     // wait for servos
     for (k = 0; k < 3 && !aborted; k++)
@@ -193,40 +259,73 @@ static void scan(int left, int top, int right, int bottom)
       move_x(j);
 
       // servo and sensor stabilisation
-      delay(100);
+      wait_for_settle();
 
-      double temp;
-      for (t = 0; t < 10 && !read_temp(object, &temp) && !aborted; ++t)
+      unsigned int temp = 0;
+      bool ok = read_object_raw(&temp, READ_ATTEMPTS, aborted);
+      if (aborted)
+        break;
+
+      // spike differs from both neighbours, otherwise it's an edge
+      if (ok && spike_x != -1)
       {
-        // wait 5000ms
-        for (k = 0; k < 50 && !aborted; k++)
+        if (abs((int)temp - (int)spike_temp) <= SPIKE_THRESHOLD)
         {
-          delay(100);
-          aborted = joystick_button_pressed() || infrared_stop_button_pressed();
+          sd_dump_data(&spike_temp, spike_x, 1);
+          prev = spike_temp;
         }
+        else
+          add_rescan(rescan, rescan_count, spike_x, i, spike_temp, true);
+        spike_x = -1;
       }
 
-      if (t == 10) // sensor is broken/disconnected
-        aborted = true; // don't bother reading more data
-      else
+      bool suspicious = ok && have_prev && abs((int)temp - (int)prev) > SPIKE_THRESHOLD;
+      if (ok && !suspicious)
       {
+        if (temp_count == 0)
+          temp_start = j;
         temps[temp_count++] = temp;
-        if (temp_count == MAX_TEMPS || j == right)
-        {
-          sd_dump_data(temps, i, j - temp_count + 1, temp_count);
-          temp_count = 0;
-        }
-        print(_("IA "));
-        print(x);
-        print(' ');
-        print(y);
-        print(' ');
+        prev = temp;
+        have_prev = true;
+      }
+
+      // sensor error or spike - don't lose the whole scan, read it again later
+      if ((!ok || suspicious || temp_count == MAX_TEMPS || j == right) && temp_count > 0)
+      {
+        sd_dump_data(temps, temp_start, temp_count);
+        temp_count = 0;
+      }
 
-        println(temp);
-        aborted = joystick_button_pressed() || infrared_stop_button_pressed();
+      if (!ok)
+        add_rescan(rescan, rescan_count, j, i, temp, false);
+      else if (suspicious)
+      {
+        spike_x = j;
+        spike_temp = temp;
       }
+
+      if (ok)
+        print_point(temp);
+      aborted = aborted || joystick_button_pressed() || infrared_stop_button_pressed();
     }
 
+    // last point has no right neighbour to judge it
+    if (spike_x != -1 && !aborted)
+      add_rescan(rescan, rescan_count, spike_x, i, spike_temp, true);
+
+    for (k = 0; k < rescan_count && !aborted; k++)
+    {
+      move_x(rescan[k]);
+      delay(300);
+
+      unsigned int temp = 0;
+      bool ok = read_object_raw(&temp, RESCAN_ATTEMPTS, aborted);
+      sd_dump_rescanned(rescan[k], temp, ok);
+      if (ok)
+        print_point(temp);
+    }
+
+    sd_end_row();
     maybe_turn_laser_off();
   }
 
@@ -243,6 +342,138 @@ static void scan(int left, int top, int right, int bottom)
   println(_("Isc f")); // scanning finished
 }
 
+#define SWEEP_MIN_MS_PER_DEGREE 5
+#define SWEEP_MAX_MS_PER_DEGREE 1000
+
+/* Reads row y while x servo moves from "from" to "to" at constant rate.
+   Every sample is reported with its time (middle of the read, in us) and
+   commanded position at that time (in 1/100 degree) - host builds the
+   regular grid from that. */
+static void sweep(int row, int from, int to, int ms_per_degree)
+{
+  move_y(row);
+  move_x(from);
+  // servos clamp positions
+  row = y;
+  from = x;
+  // wait for servos
+  delay(300);
+
+  int dir = to >= from ? 1 : -1;
+  unsigned long span = (unsigned long)abs(to - from) * ms_per_degree * 1000;
+  int count = 0;
+
+  print(_("Isws ")); // sweep start
+  print(row);
+  print(' ');
+  print(from);
+  print(' ');
+  println(to);
+
+  sweep_x(to, ms_per_degree);
+  unsigned long start = micros();
+
+  while (true)
+  {
+    maybe_update_servos();
+
+    unsigned int temp;
+    unsigned long t0 = micros();
+    bool ok = read_raw(object, &temp);
+    unsigned long t = t0 + (micros() - t0) / 2;
+    unsigned long elapsed = t - start;
+    if (elapsed > span)
+      elapsed = span;
+
+    if (ok)
+    {
+      int pos100 = from * 100 + dir * (int)(elapsed / (ms_per_degree * 10UL));
+      if (raw_mode)
+        print(_("Iswr: ")); // sweep sample, raw
+      else
+        print(_("Isw: ")); // sweep sample
+      print(t);
+      print(' ');
+      print(pos100);
+      print(' ');
+      println_temp(temp);
+      count++;
+    }
+
+    if (t - start >= span)
+      break;
+  }
+
+  // make sure position is exact and known to the host
+  move_x(to);
+
+  print(_("Iswe ")); // sweep end
+  print(row);
+  print(' ');
+  println(count);
+}
+
+// readings within 0.1 C for 200ms mean the sensor settled
+#define SETTLE_TOLERANCE 5
+#define SETTLE_WINDOW_MS 200
+#define SETTLE_TIMEOUT_MS 5000
+
+/* Measures how long the sensor needs to show new value after moving from
+   "from" to "to" with current filter settings. */
+static void settle_benchmark(int from, int to)
+{
+  move_x(from);
+  delay(2000);
+  move_x(to);
+
+  unsigned long start = millis();
+  unsigned long run_start = start;
+  unsigned int run_raw = 0, raw = 0;
+  bool have_run = false;
+  long settle = -1;
+
+  while (millis() - start < SETTLE_TIMEOUT_MS)
+  {
+    if (!read_raw(object, &raw))
+      continue;
+
+    unsigned long now = millis();
+    if (!have_run || abs((int)raw - (int)run_raw) > SETTLE_TOLERANCE)
+    {
+      run_raw = raw;
+      run_start = now;
+      have_run = true;
+    }
+    else if (now - run_start >= SETTLE_WINDOW_MS)
+    {
+      settle = run_start - start;
+      break;
+    }
+  }
+
+  print(_("Ifb ")); // filter benchmark
+  print((int)settle);
+  print(' ');
+  println_temp(raw);
+}
+
+static void print_filter_config()
+{
+  int iir, fir;
+  if (!read_filter_config(&iir, &fir))
+  {
+    println(_("Ef1")); // can't read filter config
+    return;
+  }
+
+  print(_("Icf: ")); // filter config
+  print(iir);
+  print(' ');
+  print(fir);
+  print(' ');
+  println((int)settle_ms);
+}
+
 #define MAX_COMMAND_LENGTH 50
 static char command[MAX_COMMAND_LENGTH];
 
@@ -457,7 +688,8 @@ void loop()
     case 't':
     {
       enum sensor s;
-      double temp;
+      unsigned int temp;
+      double variance;
       int i;
 
       if (len < 2)
@@ -476,21 +708,116 @@ void loop()
         return;
       }
 
-//      delay(50);
-      for (i = 0; i < 10 && !read_temp(s, &temp); ++i) 
-          delay(5000);
-      if (i == 10)
+      wait_for_settle();
+      for (i = 0; i < READ_ATTEMPTS && !read_raw_multi(s, &temp, &variance); ++i)
+        delay(100);
+      if (i == READ_ATTEMPTS)
+      {
+        println(_("Et4")); // reading failed, host can try again later
         return;
+      }
 
-      if (command[1] == 'o')
-        print(_("Ito: ")); // temp object
-      else if (command[1] == 'a')
-        print(_("Ita: ")); // temp ambient
-
-      println(temp);
+      // Ito: <temp>, r - raw, v - followed by variance
+      print(_("It"));
+      print(command[1]);
+      if (raw_mode)
+        print('r');
+      if (samples_per_point > 1)
+      {
+        print(_("v: "));
+        print_temp(temp);
+        print(' ');
+        println(variance);
+      }
+      else
+      {
+        print(_(": "));
+        println_temp(temp);
+      }
  
       break;
     }
+    case 'c': // temperature units: cr - raw readings, cc - Celsius
+      if (len == 2 && command[1] == 'r')
+        raw_mode = true;
+      else if (len == 2 && command[1] == 'c')
+        raw_mode = false;
+      else
+      {
+        println(_("E17")); // invalid c command
+        return;
+      }
+
+      print(_("Irm ")); // raw mode
+      println(raw_mode ? 1 : 0);
+      break;
+    case 'f': // sensor filters: fr, fw<iir>,<fir>, fs<settle ms>, fb<from>,<to>
+    {
+      int a, b;
+
+      if (len == 2 && command[1] == 'r')
+        print_filter_config();
+      else if (command[1] == 'w' && sscanf(command + 2, "%d,%d", &a, &b) == 2)
+      {
+        enum filter_write_result r = write_filter_config(a, b);
+        if (r == FILTER_WRITE_OK)
+          print_filter_config();
+        else if (r == FILTER_WRITE_FAILED)
+          println(_("Ef2")); // filter config write failed, old one is kept
+        else
+          println(_("Ef3")); // filter config write failed, ConfigRegister1 is damaged
+      }
+      else if (command[1] == 's' && sscanf(command + 2, "%d", &a) == 1 && a >= 0 && a <= 5000)
+      {
+        settle_ms = a;
+        print_filter_config();
+      }
+      else if (command[1] == 'b' && sscanf(command + 2, "%d,%d", &a, &b) == 2)
+        settle_benchmark(a, b);
+      else
+      {
+        println(_("E18")); // invalid f command
+        return;
+      }
+      break;
+    }
+    case 'n': // readings per point: n<count>,<0 - median, 1 - trimmed mean>
+    {
+      int count, mode;
+
+      if (sscanf(command + 1, "%d,%d", &count, &mode) != 2 || count < 1 || count > MAX_SAMPLES_PER_POINT)
+      {
+        println(_("E19")); // invalid n command
+        return;
+      }
+
+      samples_per_point = count;
+      trimmed_mean = mode == 1;
+      print(_("In ")); // readings per point
+      print(samples_per_point);
+      print(' ');
+      println(trimmed_mean ? 1 : 0);
+      break;
+    }
+    case 's':
+    {
+      int row, from, to, rate;
+
+      if (command[1] != 'w' || sscanf(command + 2, "%d,%d,%d,%d", &row, &from, &to, &rate) != 4)
+      {
+        println(_("E15")); // invalid sw command
+        return;
+      }
+
+      if (rate < SWEEP_MIN_MS_PER_DEGREE || rate > SWEEP_MAX_MS_PER_DEGREE)
+      {
+        println(_("E16")); // invalid sweep rate
+        return;
+      }
+
+      sweep(row, from, to, rate);
+      break;
+    }
     case 'j':
       if (len < 2)
       {
@@ -505,6 +832,12 @@ void loop()
       else
         println(_("E12")); // invalid j command
       
+      break;
+    case 'i': // identify - host opened the port without resetting the board
+      // board may be in AUTO mode, where println() is silent; host sends
+      // "mon!" only after it gets Isf
+      servo_print_dims();
+      Serial.println(_("Isf"));
       break;
     case 'm':
       if (strcmp(command, _("mon")) == 0) // "manual on"
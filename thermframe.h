@@ -0,0 +1,59 @@
+#ifndef THERMFRAME_H_
+#define THERMFRAME_H_
+
+#include <QList>
+#include <QMap>
+#include <QPoint>
+#include <QString>
+#include <QVector>
+
+namespace QThermCam
+{
+
+/* Scanned image with everything that is saved along with it. Copies are
+ * cheap - data is shared until one of the copies is modified.
+ */
+struct ThermFrame
+{
+	int xmin, xmax, ymin, ymax;
+	int xhighlight, yhighlight;
+	/* row-major, first row is ymin, -1000 means "not measured" */
+	QVector<float> data;
+	/* variance (C^2) of readings taken at each point, layout as data, -1 if
+	 * not known; empty if no point has it */
+	QVector<float> variance;
+	QList<QPoint> labels;
+	/* points which failed or looked wrong during scan and were read again */
+	QList<QPoint> rescanned;
+	QMap<QString, QString> metadata;
+
+	ThermFrame() : xmin(0), xmax(-1), ymin(0), ymax(-1), xhighlight(-1), yhighlight(-1)
+	{
+	}
+
+	void reset(int _xmin, int _xmax, int _ymin, int _ymax)
+	{
+		xmin = _xmin;
+		xmax = _xmax;
+		ymin = _ymin;
+		ymax = _ymax;
+		xhighlight = yhighlight = -1;
+		data = QVector<float>(width() * height(), -1000);
+		variance.clear();
+		labels.clear();
+		rescanned.clear();
+		metadata.clear();
+	}
+
+	int width() const { return xmax - xmin + 1; }
+
+	int height() const { return ymax - ymin + 1; }
+
+	bool isEmpty() const { return data.isEmpty(); }
+
+	float at(int x, int y) const { return data.at((y - ymin) * width() + x - xmin); }
+};
+
+}
+
+#endif /* THERMFRAME_H_ */
@@ -0,0 +1,66 @@
+/*
+    Copyright 2013 Marcin Slusarz <marcin.slusarz@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "updatescheduler.h"
+
+#include <QTimer>
+
+using namespace QThermCam;
+
+UpdateScheduler::UpdateScheduler(QObject *parent, int rate) : QObject(parent), dirty(0)
+{
+	timer = new QTimer(this);
+	timer->setSingleShot(true);
+	connect(timer, SIGNAL(timeout()), this, SLOT(timeout()));
+	setRate(rate);
+}
+
+void UpdateScheduler::setRate(int rate)
+{
+	if (rate < 1)
+		rate = 1;
+	if (rate > 200)
+		rate = 200;
+	timer->setInterval(1000 / rate);
+}
+
+int UpdateScheduler::rate()
+{
+	return 1000 / timer->interval();
+}
+
+void UpdateScheduler::markDirty(uint parts)
+{
+	dirty |= parts;
+	if (!timer->isActive())
+		timer->start();
+}
+
+void UpdateScheduler::flush()
+{
+	timer->stop();
+	timeout();
+}
+
+void UpdateScheduler::timeout()
+{
+	if (!dirty)
+		return;
+
+	uint parts = dirty;
+	dirty = 0;
+	emit update(parts);
+}
@@ -0,0 +1,50 @@
+#ifndef UPDATESCHEDULER_H_
+#define UPDATESCHEDULER_H_
+
+#include <QObject>
+
+class QTimer;
+
+namespace QThermCam
+{
+
+/* Collects "something changed" notifications and turns them into at most
+ * one update per frame, so UI cost does not depend on the rate of incoming
+ * data.
+ */
+class UpdateScheduler : public QObject
+{
+	Q_OBJECT
+	QTimer *timer;
+	uint dirty;
+
+public:
+	enum Part
+	{
+		View = 1,
+		StatusBar = 2,
+		Legend = 4,
+		Log = 8
+	};
+
+	UpdateScheduler(QObject *parent, int rate = 30);
+
+	void setRate(int rate);
+
+	int rate();
+
+	void markDirty(uint parts);
+
+	/* delivers pending updates immediately */
+	void flush();
+
+private slots:
+	void timeout();
+
+signals:
+	void update(uint parts);
+};
+
+}
+
+#endif /* UPDATESCHEDULER_H_ */